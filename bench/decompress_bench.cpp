@@ -0,0 +1,117 @@
+#include "engine/io/Decompress.hpp"
+
+#include <chrono>
+#include <vector>
+
+extern "C" {
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+}
+
+/*
+ * Block decompression throughput per thread count
+ *
+ * usage: decompress_bench [size in MiB] [block size in KiB]
+ *
+ * The payload mimics a mesh: a grid of float positions and colours followed by its indices,
+ * which compresses about as well as real vertex data.
+ */
+
+static std::vector<uint8_t> make_payload(size_t size) {
+	std::vector<uint8_t> payload(size);
+
+	size_t vertex_bytes = size / 2;
+	float* vertices = (float*) payload.data();
+	size_t float_count = vertex_bytes / sizeof(float);
+
+	for (size_t i = 0; i + 5 < float_count; i += 5) {
+		size_t v = i / 5;
+		vertices[i + 0] = (float) (v % 1024) * 0.01f;
+		vertices[i + 1] = (float) (v / 1024) * 0.01f;
+		vertices[i + 2] = (float) ((v * 7) % 3) * 0.5f;
+		vertices[i + 3] = (float) ((v * 13) % 5) * 0.25f;
+		vertices[i + 4] = 1.0f;
+	}
+
+	uint32_t* indices = (uint32_t*) (payload.data() + vertex_bytes);
+	size_t index_count = (size - vertex_bytes) / sizeof(uint32_t);
+
+	for (size_t i = 0; i + 5 < index_count; i += 6) {
+		uint32_t quad = (uint32_t) (i / 6);
+		uint32_t base = quad + quad / 1023;
+		uint32_t quad_indices[6] = {base, base + 1, base + 1025, base + 1025, base + 1024, base};
+		memcpy(&indices[i], quad_indices, sizeof(quad_indices));
+	}
+
+	return payload;
+}
+
+int main(int argc, char** argv) {
+	size_t size_mib = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+	uint32_t block_kib = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : COMPRESSED_DEFAULT_BLOCK_SIZE / 1024;
+
+	size_t size = size_mib * 1024 * 1024;
+	std::vector<uint8_t> payload = make_payload(size);
+
+	size_t compressed_size;
+	void* compressed = compressed_asset_create(payload.data(), size, block_kib * 1024, &compressed_size);
+	if (compressed == NULL) {
+		return 1;
+	}
+
+	compressed_asset asset;
+	if (!compressed_asset_parse(compressed, compressed_size, &asset)) {
+		return 1;
+	}
+
+	printf("payload %zu MiB, %u blocks of %u KiB, ratio %.2f\n",
+		size_mib, asset.header->block_count, block_kib, (double) size / (double) compressed_size);
+	printf("%8s %12s %10s\n", "threads", "MB/s", "speedup");
+
+	std::vector<uint8_t> output(size);
+	double single_thread = 0.0;
+
+	// Powers of two, then every hardware thread
+	uint32_t max_threads = std::thread::hardware_concurrency();
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads > 0 ? max_threads : 1);
+
+	for (uint32_t threads : thread_counts) {
+		Core::ThreadPool pool(threads);
+
+		// Warm up, also faults the output pages in
+		IO::decompress_parallel(asset, output.data(), pool);
+
+		const int runs = 5;
+		double best = 1e30;
+
+		for (int run = 0; run < runs; run++) {
+			auto start = std::chrono::steady_clock::now();
+			bool ok = IO::decompress_parallel(asset, output.data(), pool);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (!ok || memcmp(output.data(), payload.data(), size) != 0) {
+				fprintf(stderr, "Decompression mismatch with %u threads\n", threads);
+				return 1;
+			}
+
+			if (seconds < best) {
+				best = seconds;
+			}
+		}
+
+		double throughput = (double) size / best / 1e6;
+		if (threads == 1) {
+			single_thread = throughput;
+		}
+
+		printf("%8u %12.1f %9.2fx\n", threads, throughput, throughput / single_thread);
+	}
+
+	free(compressed);
+	return 0;
+}
@@ -0,0 +1,511 @@
+#include "engine/graphics/RenderGraph.hpp"
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+}
+
+/*
+ * Render graph scheduling and transient aliasing check
+ *
+ * usage: graph_check
+ *
+ * Compiles a small frame graph on a graphics and a compute queue: two passes rendering to
+ * transients, a compute pass reading one of them, passes reusing the memory of a transient whose
+ * lifetime is over, and a pass nothing needs. Checks the culling, the runs and their waits, where
+ * the transients were placed and the barriers ahead of the passes, then submits the graph twice
+ * and reads back what its last pass copied. Needs a Vulkan device but no window. Without a second
+ * queue the compute pass folds onto graphics, the same graph is checked on one queue.
+ */
+
+using namespace VK;
+
+#define CHECK_EXTENT 256
+#define CHECK_FILL_VALUE 0x5EEDu
+
+struct CheckDevice {
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t graphics_family = 0;
+	uint32_t compute_family = 0;
+	bool has_compute_queue = false;     // its own VkQueue, in its own family or the graphics one
+	PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2 = nullptr;
+
+	QueueTimeline graphics_timeline;
+	QueueTimeline compute_timeline;
+
+	// Imported, host visible to read the result back
+	VkBuffer output = VK_NULL_HANDLE;
+	VkDeviceMemory output_memory = VK_NULL_HANDLE;
+};
+
+static bool create_device(CheckDevice& check) {
+	VkApplicationInfo app_info = VkTypeWrapper<VkApplicationInfo>{};
+	app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app_info.pApplicationName = "graph_check";
+	app_info.apiVersion = VK_API_VERSION_1_3;
+
+	VkInstanceCreateInfo instance_info = VkTypeWrapper<VkInstanceCreateInfo>{};
+	instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instance_info.pApplicationInfo = &app_info;
+
+	if (vkCreateInstance(&instance_info, host_allocation_callbacks(), &check.instance) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create instance!\n");
+		return false;
+	}
+
+	uint32_t device_count = 0;
+	vkEnumeratePhysicalDevices(check.instance, &device_count, NULL);
+	std::vector<VkPhysicalDevice> devices(device_count);
+	vkEnumeratePhysicalDevices(check.instance, &device_count, devices.data());
+
+	// The graph's queues signal timeline semaphores
+	VkPhysicalDeviceProperties properties = VkTypeWrapper<VkPhysicalDeviceProperties>{};
+	std::vector<VkQueueFamilyProperties> families;
+
+	for (VkPhysicalDevice candidate : devices) {
+		vkGetPhysicalDeviceProperties(candidate, &properties);
+		if (properties.apiVersion < VK_API_VERSION_1_2) {
+			continue;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12_features = VkTypeWrapper<VkPhysicalDeviceVulkan12Features>{};
+		vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features = VkTypeWrapper<VkPhysicalDeviceFeatures2>{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &vulkan12_features;
+		vkGetPhysicalDeviceFeatures2(candidate, &features);
+		if (!vulkan12_features.timelineSemaphore) {
+			continue;
+		}
+
+		uint32_t family_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(candidate, &family_count, NULL);
+		families.resize(family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(candidate, &family_count, families.data());
+
+		for (uint32_t i = 0; i < family_count; i++) {
+			if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				check.physical_device = candidate;
+				check.graphics_family = i;
+				break;
+			}
+		}
+		if (check.physical_device != VK_NULL_HANDLE) {
+			break;
+		}
+	}
+
+	if (check.physical_device == VK_NULL_HANDLE) {
+		fprintf(stderr, "no Vulkan 1.2 device with timeline semaphores and a graphics queue!\n");
+		return false;
+	}
+	printf("device %s\n", properties.deviceName);
+
+	// A compute only family, else a second queue of the graphics one
+	for (uint32_t i = 0; i < (uint32_t) families.size(); i++) {
+		if ((families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			check.compute_family = i;
+			check.has_compute_queue = true;
+			break;
+		}
+	}
+	if (!check.has_compute_queue && families[check.graphics_family].queueCount > 1) {
+		check.compute_family = check.graphics_family;
+		check.has_compute_queue = true;
+	}
+
+	float priorities[2] = {1.0f, 1.0f};
+	VkDeviceQueueCreateInfo queue_infos[2] = {VkTypeWrapper<VkDeviceQueueCreateInfo>{}, VkTypeWrapper<VkDeviceQueueCreateInfo>{}};
+	uint32_t queue_info_count = 1;
+	queue_infos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queue_infos[0].queueFamilyIndex = check.graphics_family;
+	queue_infos[0].queueCount = check.has_compute_queue && check.compute_family == check.graphics_family ? 2 : 1;
+	queue_infos[0].pQueuePriorities = priorities;
+
+	if (check.has_compute_queue && check.compute_family != check.graphics_family) {
+		queue_infos[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queue_infos[1].queueFamilyIndex = check.compute_family;
+		queue_infos[1].queueCount = 1;
+		queue_infos[1].pQueuePriorities = priorities;
+		queue_info_count = 2;
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan12_features = VkTypeWrapper<VkPhysicalDeviceVulkan12Features>{};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12_features.timelineSemaphore = VK_TRUE;
+
+	// Barriers through synchronization2 where it is core, the legacy path otherwise
+	VkPhysicalDeviceVulkan13Features vulkan13_features = VkTypeWrapper<VkPhysicalDeviceVulkan13Features>{};
+	vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	if (properties.apiVersion >= VK_API_VERSION_1_3) {
+		VkPhysicalDeviceFeatures2 features = VkTypeWrapper<VkPhysicalDeviceFeatures2>{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &vulkan13_features;
+		vkGetPhysicalDeviceFeatures2(check.physical_device, &features);
+
+		if (vulkan13_features.synchronization2) {
+			vulkan13_features = VkTypeWrapper<VkPhysicalDeviceVulkan13Features>{};
+			vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+			vulkan13_features.synchronization2 = VK_TRUE;
+			vulkan12_features.pNext = &vulkan13_features;
+		}
+	}
+	bool has_synchronization2 = vulkan13_features.synchronization2 == VK_TRUE;
+
+	VkDeviceCreateInfo device_info = VkTypeWrapper<VkDeviceCreateInfo>{};
+	device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	device_info.pNext = &vulkan12_features;
+	device_info.queueCreateInfoCount = queue_info_count;
+	device_info.pQueueCreateInfos = queue_infos;
+
+	if (vkCreateDevice(check.physical_device, &device_info, host_allocation_callbacks(), &check.device) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create logical device!\n");
+		return false;
+	}
+
+	if (has_synchronization2) {
+		check.cmd_pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(check.device, "vkCmdPipelineBarrier2");
+	}
+
+	VkQueue graphics_queue;
+	vkGetDeviceQueue(check.device, check.graphics_family, 0, &graphics_queue);
+	if (!check.graphics_timeline.init(check.device, graphics_queue)) {
+		return false;
+	}
+
+	if (check.has_compute_queue) {
+		VkQueue compute_queue;
+		vkGetDeviceQueue(check.device, check.compute_family, check.compute_family == check.graphics_family ? 1 : 0, &compute_queue);
+		if (!check.compute_timeline.init(check.device, compute_queue)) {
+			return false;
+		}
+		printf("compute on queue family %u\n", check.compute_family);
+	} else {
+		printf("no second queue, compute runs on graphics\n");
+	}
+	printf("barriers %s\n", has_synchronization2 ? "through synchronization2" : "through vkCmdPipelineBarrier");
+
+	return true;
+}
+
+static bool create_output(CheckDevice& check) {
+	VkBufferCreateInfo buffer_info = VkTypeWrapper<VkBufferCreateInfo>{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = CHECK_EXTENT * sizeof(uint32_t);
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(check.device, &buffer_info, host_allocation_callbacks(), &check.output) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create output buffer!\n");
+		return false;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(check.device, check.output, &requirements);
+
+	VkPhysicalDeviceMemoryProperties mem_properties = VkTypeWrapper<VkPhysicalDeviceMemoryProperties>{};
+	vkGetPhysicalDeviceMemoryProperties(check.physical_device, &mem_properties);
+
+	VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	uint32_t memory_type = 0;
+	while (memory_type < mem_properties.memoryTypeCount && !((requirements.memoryTypeBits & (1u << memory_type))
+			&& (mem_properties.memoryTypes[memory_type].propertyFlags & wanted) == wanted)) {
+		memory_type++;
+	}
+
+	VkMemoryAllocateInfo alloc_info = VkTypeWrapper<VkMemoryAllocateInfo>{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = requirements.size;
+	alloc_info.memoryTypeIndex = memory_type;
+
+	if (memory_type == mem_properties.memoryTypeCount
+			|| vkAllocateMemory(check.device, &alloc_info, host_allocation_callbacks(), &check.output_memory) != VK_SUCCESS
+			|| vkBindBufferMemory(check.device, check.output, check.output_memory, 0) != VK_SUCCESS) {
+		fprintf(stderr, "failed to allocate output buffer memory!\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void destroy_device(CheckDevice& check) {
+	if (check.device != VK_NULL_HANDLE) {
+		vkDestroyBuffer(check.device, check.output, host_allocation_callbacks());
+		vkFreeMemory(check.device, check.output_memory, host_allocation_callbacks());
+		check.compute_timeline.destroy();
+		check.graphics_timeline.destroy();
+		vkDestroyDevice(check.device, host_allocation_callbacks());
+	}
+	if (check.instance != VK_NULL_HANDLE) {
+		vkDestroyInstance(check.instance, host_allocation_callbacks());
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////  Graph  //////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Added in this order, pass indices are the order of addPass()
+enum CheckPass : uint32_t {
+	PASS_GBUFFER,       // writes gbuffer
+	PASS_SHADE,         // gbuffer -> lit
+	PASS_HISTOGRAM,     // compute, lit -> histogram
+	PASS_BLOOM,         // lit -> bloom, whose memory is gbuffer's
+	PASS_TONEMAP,       // bloom and histogram -> output
+	PASS_OVERLAY,       // writes overlay, read by nothing
+};
+
+struct CheckResources {
+	RenderResource gbuffer;
+	RenderResource lit;
+	RenderResource bloom;
+	RenderResource overlay;
+	RenderResource histogram;
+	RenderResource output;
+};
+
+static CheckResources build_graph(RenderGraph& graph, VkBuffer output) {
+	CheckResources r;
+
+	RenderImageDesc image_desc;
+	image_desc.format = VK_FORMAT_R8G8B8A8_UNORM;
+	image_desc.extent = {CHECK_EXTENT, CHECK_EXTENT};
+
+	RenderBufferDesc histogram_desc;
+	histogram_desc.size = CHECK_EXTENT * sizeof(uint32_t);
+
+	r.gbuffer = graph.createImage("gbuffer", image_desc);
+	r.lit = graph.createImage("lit", image_desc);
+	r.bloom = graph.createImage("bloom", image_desc);
+	r.overlay = graph.createImage("overlay", image_desc);
+	r.histogram = graph.createBuffer("histogram", histogram_desc);
+	r.output = graph.importBuffer("output", output, ResourceState{});
+
+	// Only the layouts and the order matter, the image passes record nothing
+	graph.addPass("gbuffer")
+		.write(r.gbuffer, ResourceAccess::ColorAttachment);
+	graph.addPass("shade")
+		.read(r.gbuffer, ResourceAccess::Sampled)
+		.write(r.lit, ResourceAccess::ColorAttachment);
+
+	RenderResource histogram = r.histogram;
+	graph.addPass("histogram", RenderQueue::Compute)
+		.read(r.lit, ResourceAccess::Sampled)
+		.write(r.histogram, ResourceAccess::TransferDst)
+		.execute([histogram](VkCommandBuffer command_buffer, const RenderGraph& compiled) {
+			vkCmdFillBuffer(command_buffer, compiled.buffer(histogram), 0, VK_WHOLE_SIZE, CHECK_FILL_VALUE);
+		});
+
+	graph.addPass("bloom")
+		.read(r.lit, ResourceAccess::Sampled)
+		.write(r.bloom, ResourceAccess::ColorAttachment);
+
+	RenderResource output_resource = r.output;
+	graph.addPass("tonemap")
+		.read(r.bloom, ResourceAccess::Sampled)
+		.read(r.histogram, ResourceAccess::TransferSrc)
+		.write(r.output, ResourceAccess::TransferDst)
+		.execute([histogram, output_resource](VkCommandBuffer command_buffer, const RenderGraph& compiled) {
+			VkBufferCopy region = {0, 0, CHECK_EXTENT * sizeof(uint32_t)};
+			vkCmdCopyBuffer(command_buffer, compiled.buffer(histogram), compiled.buffer(output_resource), 1, &region);
+
+			// Read back once the graphics timeline reaches the frame, the graph knows nothing of the host
+			VkMemoryBarrier host_barrier = VkTypeWrapper<VkMemoryBarrier>{};
+			host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, NULL, 0, NULL);
+		});
+
+	graph.addPass("overlay")
+		.write(r.overlay, ResourceAccess::ColorAttachment);
+
+	return r;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////  Checks  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t failures = 0;
+
+static void check(bool condition, const char* what) {
+	printf("  %-6s %s\n", condition ? "ok" : "FAILED", what);
+	if (!condition) {
+		failures++;
+	}
+}
+
+static const VkImageMemoryBarrier2* find_image_barrier(const BarrierBatch* batch, VkImage image) {
+	if (batch == nullptr) {
+		return nullptr;
+	}
+	for (const VkImageMemoryBarrier2& barrier : batch->images) {
+		if (barrier.image == image) {
+			return &barrier;
+		}
+	}
+	return nullptr;
+}
+
+static bool transitions(const VkImageMemoryBarrier2* barrier, VkImageLayout from, VkImageLayout to) {
+	return barrier != nullptr && barrier->oldLayout == from && barrier->newLayout == to;
+}
+
+static bool shares_memory(const RenderGraph& graph, RenderResource a, RenderResource b) {
+	uint32_t heap_a, heap_b;
+	VkDeviceSize offset_a, offset_b, size_a, size_b;
+	if (!graph.transientPlacement(a, heap_a, offset_a, size_a) || !graph.transientPlacement(b, heap_b, offset_b, size_b)) {
+		return false;
+	}
+	return heap_a == heap_b && offset_a < offset_b + size_b && offset_b < offset_a + size_a;
+}
+
+static void check_graph(const RenderGraph& graph, const CheckResources& r, bool multi_queue) {
+	uint32_t heap;
+	VkDeviceSize offset, size;
+
+	printf("culling\n");
+	check(graph.culledPassCount() == 1, "one pass culled");
+	check(graph.passBarriers(PASS_OVERLAY) == nullptr, "overlay culled");
+	check(!graph.transientPlacement(r.overlay, heap, offset, size), "overlay never created");
+
+	printf("runs\n");
+	if (multi_queue) {
+		check(graph.runCount() == 3, "graphics, compute, graphics");
+		if (graph.runCount() == 3) {
+			check(graph.runQueue(0) == RenderQueue::Graphics && graph.runQueue(1) == RenderQueue::Compute
+				&& graph.runQueue(2) == RenderQueue::Graphics, "run queues");
+			check(graph.runWaits(1).size() == 1 && graph.runWaits(1)[0] == 0, "compute waits on the first graphics run");
+			const std::vector<uint32_t>& waits = graph.runWaits(2);
+			check(std::find(waits.begin(), waits.end(), 1) != waits.end(), "last graphics run waits on compute");
+		}
+	} else {
+		check(graph.runCount() == 1 && graph.runQueue(0) == RenderQueue::Graphics, "compute folded onto graphics");
+	}
+
+	printf("placement\n");
+	uint32_t gbuffer_heap, bloom_heap;
+	VkDeviceSize gbuffer_offset, bloom_offset;
+	bool placed = graph.transientPlacement(r.gbuffer, gbuffer_heap, gbuffer_offset, size)
+		&& graph.transientPlacement(r.bloom, bloom_heap, bloom_offset, size);
+	check(placed && gbuffer_heap == bloom_heap && gbuffer_offset == bloom_offset, "bloom reuses gbuffer's memory");
+	check(!shares_memory(graph, r.lit, r.gbuffer) && !shares_memory(graph, r.lit, r.bloom), "lit overlaps neither");
+	check(graph.transientPlacement(r.histogram, heap, offset, size) && !shares_memory(graph, r.histogram, r.gbuffer)
+		&& !shares_memory(graph, r.histogram, r.lit), "histogram apart from the images");
+	check(graph.transientBytes() < graph.unaliasedTransientBytes(), "aliasing saves memory");
+	printf("  %llu KiB of transients, %llu KiB unaliased\n", (unsigned long long) graph.transientBytes() / 1024,
+		(unsigned long long) graph.unaliasedTransientBytes() / 1024);
+
+	printf("barriers\n");
+	VkImage gbuffer = graph.image(r.gbuffer);
+	VkImage lit = graph.image(r.lit);
+	VkImage bloom = graph.image(r.bloom);
+
+	// Last frame's reads of gbuffer and of bloom, which shares its memory, finish first
+	const VkImageMemoryBarrier2* barrier = find_image_barrier(graph.passBarriers(PASS_GBUFFER), gbuffer);
+	check(transitions(barrier, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+		&& (barrier->srcStageMask & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT), "gbuffer waits on last frame's reads");
+
+	barrier = find_image_barrier(graph.passBarriers(PASS_SHADE), gbuffer);
+	check(transitions(barrier, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		&& (barrier->srcAccessMask & VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT), "shade reads gbuffer once written");
+
+	barrier = find_image_barrier(graph.passBarriers(PASS_HISTOGRAM), lit);
+	if (multi_queue) {
+		// After the semaphore wait, on a queue without graphics stages
+		check(transitions(barrier, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			&& barrier->srcStageMask == VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+			&& barrier->dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, "histogram acquires lit on compute");
+		check(find_image_barrier(graph.passBarriers(PASS_BLOOM), lit) == nullptr, "bloom reads lit without a barrier");
+	} else {
+		check(transitions(barrier, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			&& (barrier->srcStageMask & VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT), "histogram reads lit once written");
+	}
+
+	// The first use of bloom waits on shade's reads of gbuffer, the memory is the same
+	barrier = find_image_barrier(graph.passBarriers(PASS_BLOOM), bloom);
+	check(transitions(barrier, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+		&& (barrier->srcStageMask & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT), "bloom waits on gbuffer's last reads");
+
+	barrier = find_image_barrier(graph.passBarriers(PASS_TONEMAP), bloom);
+	check(transitions(barrier, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), "tonemap reads bloom once written");
+}
+
+int main() {
+	CheckDevice check_device;
+	if (!create_device(check_device) || !create_output(check_device)) {
+		destroy_device(check_device);
+		return 1;
+	}
+
+	VkAllocator allocator;
+	allocator.init(check_device.physical_device, check_device.device, NULL);
+	DeletionQueue deletion_queue;
+
+	RenderGraph graph;
+	graph.init(check_device.physical_device, check_device.device, &allocator, &deletion_queue, check_device.cmd_pipeline_barrier2);
+
+	QueueTimeline* timelines[(uint32_t) RenderQueue::Count] = {&check_device.graphics_timeline, nullptr, nullptr};
+	uint32_t families[(uint32_t) RenderQueue::Count] = {check_device.graphics_family, check_device.graphics_family, check_device.graphics_family};
+	if (check_device.has_compute_queue) {
+		timelines[(uint32_t) RenderQueue::Compute] = &check_device.compute_timeline;
+		families[(uint32_t) RenderQueue::Compute] = check_device.compute_family;
+	}
+
+	const uint32_t frame_count = 2;
+	if (!graph.setQueues(timelines, families, frame_count)) {
+		graph.destroy();
+		allocator.destroy();
+		destroy_device(check_device);
+		return 1;
+	}
+
+	// Rebuilt every frame like the engine's, the second compilation keeps the transients
+	for (uint64_t frame = 1; frame <= frame_count; frame++) {
+		printf("frame %llu\n", (unsigned long long) frame);
+
+		graph.reset();
+		CheckResources resources = build_graph(graph, check_device.output);
+		if (!graph.compile(frame)) {
+			failures++;
+			break;
+		}
+
+		check(graph.transientGeneration() == 1, "transients created once");
+		check_graph(graph, resources, check_device.has_compute_queue);
+
+		void* mapped = NULL;
+		vkMapMemory(check_device.device, check_device.output_memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		memset(mapped, 0, CHECK_EXTENT * sizeof(uint32_t));
+
+		uint64_t value = graph.submit(VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+		check_device.graphics_timeline.wait(value);
+
+		const uint32_t* result = (const uint32_t*) mapped;
+		check(result[0] == CHECK_FILL_VALUE && result[CHECK_EXTENT - 1] == CHECK_FILL_VALUE, "tonemap copied what histogram wrote");
+		vkUnmapMemory(check_device.device, check_device.output_memory);
+
+		deletion_queue.collect(frame);
+	}
+
+	vkDeviceWaitIdle(check_device.device);
+	graph.destroy();
+	deletion_queue.flush();
+	allocator.destroy();
+	destroy_device(check_device);
+
+	if (failures > 0) {
+		printf("%u checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include "engine/io/MeshImporter.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" {
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+}
+
+/*
+ * Mesh import time per thread count
+ *
+ * usage: import_bench [grid size] [output directory] [max threads]
+ *
+ * Writes a grid of grid size x grid size quads (2 triangles each) as an OBJ and as a GLB, then
+ * imports both with 1, 2, 4 ... threads. The default grid is 2.25 M vertices and 4.5 M triangles.
+ */
+
+static bool write_obj(const char* path, uint32_t grid) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open file %s\n", path);
+		return false;
+	}
+
+	uint32_t side = grid + 1;
+	for (uint32_t y = 0; y < side; y++) {
+		for (uint32_t x = 0; x < side; x++) {
+			float height = (float) ((x * 7 + y * 13) % 17) * 0.01f;
+			fprintf(file, "v %.5f %.5f %.5f\n", (float) x / grid, (float) y / grid, height);
+		}
+	}
+
+	// Every other row uses relative indices with uv/normal slots, which exercises the stitching
+	// between line ranges
+	uint32_t vertex_count = side * side;
+	for (uint32_t y = 0; y < grid; y++) {
+		for (uint32_t x = 0; x < grid; x++) {
+			uint32_t a = y * side + x + 1;
+			if (y % 2 == 0) {
+				fprintf(file, "f %u %u %u %u\n", a, a + 1, a + side + 1, a + side);
+			} else {
+				// -1 is the last vertex
+				int r = (int) a - (int) vertex_count - 1;
+				fprintf(file, "f %d/1 %d/1 %d/1\n", r, r + 1, r + (int) side + 1);
+				fprintf(file, "f %d//1 %d//1 %d//1\n", r + (int) side + 1, r + (int) side, r);
+			}
+		}
+	}
+
+	return fclose(file) == 0;
+}
+
+static bool write_glb(const char* path, uint32_t grid) {
+	uint32_t side = grid + 1;
+	uint32_t vertex_count = side * side;
+	uint32_t index_count = grid * grid * 6;
+
+	std::vector<float> positions((size_t) vertex_count * 3);
+	for (uint32_t y = 0; y < side; y++) {
+		for (uint32_t x = 0; x < side; x++) {
+			float* p = &positions[((size_t) y * side + x) * 3];
+			p[0] = (float) x / grid;
+			p[1] = (float) y / grid;
+			p[2] = (float) ((x * 7 + y * 13) % 17) * 0.01f;
+		}
+	}
+
+	std::vector<uint32_t> indices;
+	indices.reserve(index_count);
+	for (uint32_t y = 0; y < grid; y++) {
+		for (uint32_t x = 0; x < grid; x++) {
+			uint32_t a = y * side + x;
+			uint32_t quad[6] = {a, a + 1, a + side + 1, a + side + 1, a + side, a};
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	size_t positions_size = positions.size() * sizeof(float);
+	size_t indices_size = indices.size() * sizeof(uint32_t);
+
+	char json[1024];
+	int json_length = snprintf(json, sizeof(json),
+		"{\"asset\":{\"version\":\"2.0\"},"
+		"\"buffers\":[{\"byteLength\":%zu}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+		"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},"
+		"{\"bufferView\":1,\"componentType\":5125,\"count\":%u,\"type\":\"SCALAR\"}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}]}",
+		positions_size + indices_size, positions_size, positions_size, indices_size, vertex_count, index_count);
+
+	// Chunks are padded to 4 bytes, JSON with spaces
+	uint32_t json_chunk = (uint32_t) ((json_length + 3) & ~3);
+	uint32_t bin_chunk = (uint32_t) (positions_size + indices_size);
+	memset(json + json_length, ' ', json_chunk - json_length);
+
+	uint32_t header[3] = {0x46546C67u, 2, 12 + 8 + json_chunk + 8 + bin_chunk};
+	uint32_t json_header[2] = {json_chunk, 0x4E4F534Au};
+	uint32_t bin_header[2] = {bin_chunk, 0x004E4942u};
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open file %s\n", path);
+		return false;
+	}
+
+	fwrite(header, sizeof(header), 1, file);
+	fwrite(json_header, sizeof(json_header), 1, file);
+	fwrite(json, 1, json_chunk, file);
+	fwrite(bin_header, sizeof(bin_header), 1, file);
+	fwrite(positions.data(), 1, positions_size, file);
+	fwrite(indices.data(), 1, indices_size, file);
+
+	return fclose(file) == 0;
+}
+
+static bool bench(const char* label, const char* path, size_t expected_triangles, uint32_t max_threads) {
+	file_view view;
+	if (!map_file_view(path, FILE_VIEW_HINT_NONE, &view)) {
+		return false;
+	}
+
+	printf("%s: %.1f MiB, %zu triangles\n", label, (double) view.size / (1024.0 * 1024.0), expected_triangles);
+	printf("%8s %10s %10s\n", "threads", "ms", "speedup");
+
+	// Powers of two, then the maximum
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads > 0 ? max_threads : 1);
+
+	double single_thread = 0.0;
+
+	for (uint32_t threads : thread_counts) {
+		Core::ThreadPool pool(threads);
+		double best = 1e30;
+
+		for (int run = 0; run < 3; run++) {
+			VK::MeshData mesh;
+
+			auto start = std::chrono::steady_clock::now();
+			bool ok = strstr(path, ".obj")
+				? IO::import_obj((const char*) view.data, view.size, mesh, pool)
+				: IO::import_gltf(view.data, view.size, "", mesh, pool);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (!ok || mesh.indices.size() != expected_triangles * 3) {
+				fprintf(stderr, "Import of %s failed with %u threads\n", path, threads);
+				release_file_view(&view);
+				return false;
+			}
+
+			if (seconds < best) {
+				best = seconds;
+			}
+		}
+
+		if (threads == 1) {
+			single_thread = best;
+		}
+		printf("%8u %10.1f %9.2fx\n", threads, best * 1000.0, single_thread / best);
+	}
+
+	release_file_view(&view);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	uint32_t grid = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 1500;
+	std::string directory = argc > 2 ? argv[2] : ".";
+	uint32_t max_threads = argc > 3 ? (uint32_t) strtoul(argv[3], NULL, 10) : std::thread::hardware_concurrency();
+
+	std::string obj_path = directory + "/import_bench.obj";
+	std::string glb_path = directory + "/import_bench.glb";
+
+	size_t triangles = (size_t) grid * grid * 2;
+	bool ok = write_obj(obj_path.c_str(), grid) && write_glb(glb_path.c_str(), grid)
+		&& bench("OBJ", obj_path.c_str(), triangles, max_threads)
+		&& bench("GLB", glb_path.c_str(), triangles, max_threads);
+
+	remove(obj_path.c_str());
+	remove(glb_path.c_str());
+
+	return ok ? 0 : 1;
+}
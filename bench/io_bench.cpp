@@ -0,0 +1,461 @@
+#include "engine/io/AsyncLoader.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" {
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+
+	#include "io.h"
+	#include "archive.h"
+
+#ifdef __linux__
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/resource.h>
+#endif
+}
+
+/*
+ * File loading throughput of every load path, no GPU needed
+ *
+ * usage: io_bench [work directory] [max size in KiB] [json output]
+ *
+ * Writes files of 1 KiB, 16 KiB ... up to the max size (1 GiB by default) and packs them into an
+ * archive, then loads each one with:
+ *   read_entire_binary_file   the original stdio path
+ *   mmap                      map_file_view, every page touched
+ *   async                     one IO::AsyncLoader request, waited on
+ *   archive                   archive_open + archive_find, every page of the blob touched
+ *
+ * Every path opens the file again on each iteration so the cold runs measure the whole load. Warm
+ * runs follow an untimed load, cold runs drop the file from the page cache with
+ * posix_fadvise(DONTNEED) first; that only works on file systems with a page cache (not tmpfs),
+ * the bench checks with mincore and leaves the cold runs out when the pages stayed resident.
+ *
+ * Per run it reports MB/s (10^6 bytes), read syscalls (/proc/self/io syscr), page faults and the
+ * peak RSS (VmHWM, reset through /proc/self/clear_refs before the run). The JSON goes to a file
+ * because read_entire_binary_file logs on stdout.
+ */
+
+#define IO_BENCH_MIN_SIZE 1024ull
+#define IO_BENCH_SIZE_STEP 16ull
+#define IO_BENCH_DEFAULT_MAX_KIB (1024ull * 1024ull)
+
+// Bytes loaded per run, small files are read many times to get a stable number
+#define IO_BENCH_BYTES_PER_RUN (256ull * 1024ull * 1024ull)
+#define IO_BENCH_MAX_ITERATIONS 200
+
+enum class LoadMethod {
+	ReadEntireFile,
+	Mmap,
+	Async,
+	Archive,
+};
+
+static const char* method_names[] = {"read_entire_binary_file", "mmap", "async", "archive"};
+
+struct BenchFile {
+	std::string path;
+	std::string name;   // in the archive
+	uint64_t size;
+};
+
+struct ProcessStats {
+	int64_t read_syscalls = -1;
+	int64_t minor_faults = -1;
+	int64_t major_faults = -1;
+};
+
+struct RunResult {
+	LoadMethod method;
+	uint64_t size;
+	bool cold;
+	uint32_t iterations;
+	double mean_ms;
+	double best_ms;
+	double mb_per_s;
+	double read_syscalls;
+	double minor_faults;
+	double major_faults;
+	int64_t baseline_rss_kib;
+	int64_t peak_rss_kib;
+};
+
+// Keeps the page touching from being optimised away
+static volatile uint64_t sink;
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////  Process stats  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+// "Key: value" line of a /proc file, -1 when it is not there
+static int64_t read_proc_value(const char* path, const char* key) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		return -1;
+	}
+
+	char line[256];
+	size_t key_length = strlen(key);
+	int64_t value = -1;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, key, key_length) == 0 && line[key_length] == ':') {
+			value = strtoll(line + key_length + 1, NULL, 10);
+			break;
+		}
+	}
+
+	fclose(file);
+	return value;
+}
+
+static ProcessStats process_stats() {
+	ProcessStats stats;
+
+#ifdef __linux__
+	// Summed over every thread of the process, so the async workers are included
+	stats.read_syscalls = read_proc_value("/proc/self/io", "syscr");
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		stats.minor_faults = usage.ru_minflt;
+		stats.major_faults = usage.ru_majflt;
+	}
+#endif
+
+	return stats;
+}
+
+static void reset_peak_rss() {
+#ifdef __linux__
+	// "5" resets VmHWM to the current RSS (Linux 4.0+)
+	FILE* file = fopen("/proc/self/clear_refs", "w");
+	if (file) {
+		fputs("5", file);
+		fclose(file);
+	}
+#endif
+}
+
+static int64_t rss_kib(const char* key) {
+	return read_proc_value("/proc/self/status", key);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////  Page cache  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static bool drop_page_cache(const char* path) {
+#ifdef __linux__
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return ok;
+#else
+	(void) path;
+	return false;
+#endif
+}
+
+// Fraction of the file's pages in the page cache, 1 when it cannot be told
+static double resident_fraction(const char* path) {
+#ifdef __linux__
+	struct file_view view;
+	if (!map_file_view(path, FILE_VIEW_HINT_NONE, &view) || view.size == 0) {
+		return 1.0;
+	}
+
+	size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	size_t page_count = (view.size + page_size - 1) / page_size;
+	std::vector<unsigned char> pages(page_count);
+
+	size_t resident = page_count;
+	if (mincore((void*) view.data, view.size, pages.data()) == 0) {
+		resident = 0;
+		for (unsigned char page : pages) {
+			resident += page & 1;
+		}
+	}
+
+	release_file_view(&view);
+	return (double) resident / (double) page_count;
+#else
+	(void) path;
+	return 1.0;
+#endif
+}
+
+static bool write_bench_file(const BenchFile& file) {
+	FILE* out = fopen(file.path.c_str(), "wb");
+	if (!out) {
+		fprintf(stderr, "Failed to open file %s\n", file.path.c_str());
+		return false;
+	}
+
+	// Not zeros, some file systems would store those sparse
+	std::vector<uint64_t> chunk(64 * 1024);
+	for (size_t i = 0; i < chunk.size(); i++) {
+		chunk[i] = (i + 1) * 0x9E3779B97F4A7C15ull;
+	}
+
+	uint64_t written = 0;
+	while (written < file.size) {
+		size_t count = (size_t) SDL_min(file.size - written, (uint64_t) (chunk.size() * sizeof(uint64_t)));
+		if (fwrite(chunk.data(), 1, count, out) != count) {
+			fprintf(stderr, "Failed to write file %s\n", file.path.c_str());
+			fclose(out);
+			return false;
+		}
+		written += count;
+	}
+
+	// Dirty pages cannot be dropped from the cache, get them on disk
+	fflush(out);
+#ifdef __linux__
+	fsync(fileno(out));
+#endif
+
+	return fclose(out) == 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////  Load paths  ////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+// One read per cache line, enough to fault in every page of a mapping
+static void touch(const void* data, size_t size) {
+	const uint8_t* bytes = (const uint8_t*) data;
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i + sizeof(uint64_t) <= size; i += 64) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		sum += word;
+	}
+
+	sink = sink + sum;
+}
+
+static bool load(LoadMethod method, const BenchFile& file, const char* archive_path) {
+	switch (method) {
+	case LoadMethod::ReadEntireFile: {
+		size_t size = 0;
+		char* data = read_entire_binary_file(file.path.c_str(), &size);
+		if (data == NULL || size != file.size) {
+			free(data);
+			return false;
+		}
+
+		touch(data, size);
+		free(data);
+		return true;
+	}
+	case LoadMethod::Mmap: {
+		struct file_view view;
+		if (!map_file_view(file.path.c_str(), FILE_VIEW_HINT_SEQUENTIAL, &view)) {
+			return false;
+		}
+
+		touch(view.data, view.size);
+		release_file_view(&view);
+		return true;
+	}
+	case LoadMethod::Async: {
+		IO::ReadRequest request;
+		request.path = file.path.c_str();
+
+		IO::AsyncLoader& loader = IO::AsyncLoader::instance();
+		IO::ReadResult result;
+		bool ok = loader.wait(loader.submit(request), &result) && result.size == file.size;
+
+		if (ok) {
+			touch(result.data, (size_t) result.size);
+		}
+		loader.release(result);
+		return ok;
+	}
+	case LoadMethod::Archive: {
+		struct archive archive;
+		if (!archive_open(archive_path, &archive)) {
+			return false;
+		}
+
+		struct archive_blob blob;
+		bool ok = archive_find(&archive, file.name.c_str(), &blob) && blob.size == file.size;
+
+		if (ok) {
+			touch(blob.data, blob.size);
+		}
+		archive_close(&archive);
+		return ok;
+	}
+	}
+
+	return false;
+}
+
+static bool run(LoadMethod method, const BenchFile& file, const char* archive_path, bool cold, RunResult& result) {
+	// The archive path drops the whole archive, the others just their file
+	const char* cached_path = method == LoadMethod::Archive ? archive_path : file.path.c_str();
+
+	uint32_t iterations = (uint32_t) SDL_clamp(IO_BENCH_BYTES_PER_RUN / file.size, 1ull, (uint64_t) IO_BENCH_MAX_ITERATIONS);
+
+	if (!cold && !load(method, file, archive_path)) {
+		return false;
+	}
+
+	result = RunResult{method, file.size, cold, iterations, 0.0, 1e30, 0.0, -1.0, -1.0, -1.0, -1, -1};
+
+	reset_peak_rss();
+	result.baseline_rss_kib = rss_kib("VmRSS");
+	ProcessStats before = process_stats();
+	double total = 0.0;
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		if (cold) {
+			drop_page_cache(cached_path);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bool ok = load(method, file, archive_path);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (!ok) {
+			fprintf(stderr, "Loading %s with %s failed\n", file.path.c_str(), method_names[(int) method]);
+			return false;
+		}
+
+		total += seconds;
+		result.best_ms = SDL_min(result.best_ms, seconds * 1000.0);
+	}
+
+	ProcessStats after = process_stats();
+	result.peak_rss_kib = rss_kib("VmHWM");
+
+	result.mean_ms = total * 1000.0 / iterations;
+	result.mb_per_s = (double) file.size * iterations / total / 1e6;
+
+	// The page cache drop does not count, it happens between the timed loads
+	if (before.read_syscalls >= 0 && after.read_syscalls >= 0) {
+		result.read_syscalls = (double) (after.read_syscalls - before.read_syscalls) / iterations;
+	}
+	if (before.minor_faults >= 0) {
+		result.minor_faults = (double) (after.minor_faults - before.minor_faults) / iterations;
+		result.major_faults = (double) (after.major_faults - before.major_faults) / iterations;
+	}
+
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////  Main  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static bool write_json(const char* path, const std::vector<RunResult>& results, bool cold_supported) {
+	FILE* out = fopen(path, "w");
+	if (!out) {
+		fprintf(stderr, "Failed to open file %s\n", path);
+		return false;
+	}
+
+	fprintf(out, "{\n  \"benchmark\": \"io_bench\",\n  \"cold_cache_supported\": %s,\n  \"results\": [\n",
+		cold_supported ? "true" : "false");
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const RunResult& r = results[i];
+		fprintf(out,
+			"    {\"method\": \"%s\", \"size\": %llu, \"cache\": \"%s\", \"iterations\": %u, "
+			"\"mean_ms\": %.4f, \"best_ms\": %.4f, \"mb_per_s\": %.2f, \"read_syscalls\": %.1f, "
+			"\"minor_faults\": %.1f, \"major_faults\": %.1f, \"baseline_rss_kib\": %lld, \"peak_rss_kib\": %lld}%s\n",
+			method_names[(int) r.method], (unsigned long long) r.size, r.cold ? "cold" : "warm", r.iterations,
+			r.mean_ms, r.best_ms, r.mb_per_s, r.read_syscalls, r.minor_faults, r.major_faults,
+			(long long) r.baseline_rss_kib, (long long) r.peak_rss_kib, i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(out, "  ]\n}\n");
+	return fclose(out) == 0;
+}
+
+int main(int argc, char** argv) {
+	std::string directory = argc > 1 ? argv[1] : ".";
+	uint64_t max_size = (argc > 2 ? strtoull(argv[2], NULL, 10) : IO_BENCH_DEFAULT_MAX_KIB) * 1024ull;
+	const char* json_path = argc > 3 ? argv[3] : "io_bench.json";
+
+	// ----- Test files and the archive holding all of them -----
+	std::vector<BenchFile> files;
+	for (uint64_t size = IO_BENCH_MIN_SIZE; size <= max_size; size *= IO_BENCH_SIZE_STEP) {
+		std::string name = "io_bench_" + std::to_string(size) + ".bin";
+		files.push_back(BenchFile{directory + "/" + name, name, size});
+	}
+
+	std::string archive_path = directory + "/io_bench.pak";
+	struct archive_builder* builder = archive_builder_create();
+	bool ok = builder != NULL && !files.empty();
+
+	for (const BenchFile& file : files) {
+		ok = ok && write_bench_file(file) && archive_builder_add_file(builder, file.name.c_str(), file.path.c_str());
+	}
+	ok = ok && archive_builder_write(builder, archive_path.c_str());
+	if (builder) {
+		archive_builder_destroy(builder);
+	}
+
+	// tmpfs and some overlay file systems keep the pages whatever we ask for
+	bool cold_supported = ok && drop_page_cache(files.back().path.c_str())
+		&& resident_fraction(files.back().path.c_str()) < 0.1;
+	if (ok && !cold_supported) {
+		fprintf(stderr, "The page cache cannot be dropped in %s, only warm runs are measured\n", directory.c_str());
+	}
+
+	IO::AsyncLoader::Init();
+
+	// ----- Runs -----
+	std::vector<RunResult> results;
+	LoadMethod methods[] = {LoadMethod::ReadEntireFile, LoadMethod::Mmap, LoadMethod::Async, LoadMethod::Archive};
+
+	for (size_t f = 0; ok && f < files.size(); f++) {
+		for (int cold = 0; ok && cold <= (cold_supported ? 1 : 0); cold++) {
+			for (LoadMethod method : methods) {
+				RunResult result;
+				ok = run(method, files[f], archive_path.c_str(), cold != 0, result);
+				if (!ok) {
+					break;
+				}
+
+				results.push_back(result);
+				fprintf(stderr, "%-24s %12llu %s %10.1f MB/s %10.1f syscr %10lld KiB peak\n", method_names[(int) method],
+					(unsigned long long) files[f].size, cold ? "cold" : "warm", result.mb_per_s, result.read_syscalls,
+					(long long) result.peak_rss_kib);
+			}
+		}
+	}
+
+	IO::AsyncLoader::Quit();
+
+	ok = ok && write_json(json_path, results, cold_supported);
+
+	for (const BenchFile& file : files) {
+		remove(file.path.c_str());
+	}
+	remove(archive_path.c_str());
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,457 @@
+#include "engine/graphics/CommandRecorder.hpp"
+#include "engine/graphics/EmbeddedShaders.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern "C" {
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+}
+
+/*
+ * Draw recording throughput per thread count
+ *
+ * usage: record_bench [draw count]
+ *
+ * Records the engine's draw loop (pipeline, vertex and index buffers, dynamic state, descriptor
+ * set, then one indexed draw per item) into secondary command buffers through CommandRecorder.
+ * Needs a Vulkan device but no window: nothing is submitted, only the CPU side is measured.
+ */
+
+using namespace VK;
+
+struct BenchDevice {
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t graphics_family = 0;
+
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+};
+
+static bool create_device(BenchDevice& bench) {
+	VkApplicationInfo app_info = VkTypeWrapper<VkApplicationInfo>{};
+	app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app_info.pApplicationName = "record_bench";
+	app_info.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo instance_info = VkTypeWrapper<VkInstanceCreateInfo>{};
+	instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instance_info.pApplicationInfo = &app_info;
+
+	if (vkCreateInstance(&instance_info, host_allocation_callbacks(), &bench.instance) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create instance!\n");
+		return false;
+	}
+
+	uint32_t device_count = 0;
+	vkEnumeratePhysicalDevices(bench.instance, &device_count, NULL);
+	std::vector<VkPhysicalDevice> devices(device_count);
+	vkEnumeratePhysicalDevices(bench.instance, &device_count, devices.data());
+
+	for (VkPhysicalDevice candidate : devices) {
+		uint32_t family_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(candidate, &family_count, NULL);
+		std::vector<VkQueueFamilyProperties> families(family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(candidate, &family_count, families.data());
+
+		for (uint32_t i = 0; i < family_count; i++) {
+			if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				bench.physical_device = candidate;
+				bench.graphics_family = i;
+				break;
+			}
+		}
+		if (bench.physical_device != VK_NULL_HANDLE) {
+			break;
+		}
+	}
+
+	if (bench.physical_device == VK_NULL_HANDLE) {
+		fprintf(stderr, "no device with a graphics queue!\n");
+		return false;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(bench.physical_device, &properties);
+	printf("device %s\n", properties.deviceName);
+
+	float priority = 1.0f;
+	VkDeviceQueueCreateInfo queue_info = VkTypeWrapper<VkDeviceQueueCreateInfo>{};
+	queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queue_info.queueFamilyIndex = bench.graphics_family;
+	queue_info.queueCount = 1;
+	queue_info.pQueuePriorities = &priority;
+
+	VkDeviceCreateInfo device_info = VkTypeWrapper<VkDeviceCreateInfo>{};
+	device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	device_info.queueCreateInfoCount = 1;
+	device_info.pQueueCreateInfos = &queue_info;
+
+	if (vkCreateDevice(bench.physical_device, &device_info, host_allocation_callbacks(), &bench.device) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create logical device!\n");
+		return false;
+	}
+
+	return true;
+}
+
+static VkShaderModule create_shader_module(VkDevice device, ShaderId id, uint32_t key) {
+	const EmbeddedShader* variant = get_shader_variant(id, key);
+	if (variant == NULL) {
+		return VK_NULL_HANDLE;
+	}
+
+	VkShaderModuleCreateInfo create_info = VkTypeWrapper<VkShaderModuleCreateInfo>{};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = variant->size;
+	create_info.pCode = variant->code;
+
+	VkShaderModule shader_module = VK_NULL_HANDLE;
+	vkCreateShaderModule(device, &create_info, host_allocation_callbacks(), &shader_module);
+	return shader_module;
+}
+
+// Same layout, vertex format and pipeline state as the engine's, into an offscreen render pass
+static bool create_pipeline(BenchDevice& bench) {
+	VkAttachmentDescription color_attachment = VkTypeWrapper<VkAttachmentDescription>{};
+	color_attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference color_attachment_ref = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+	VkSubpassDescription subpass = VkTypeWrapper<VkSubpassDescription>{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_attachment_ref;
+
+	VkRenderPassCreateInfo render_pass_info = VkTypeWrapper<VkRenderPassCreateInfo>{};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = 1;
+	render_pass_info.pAttachments = &color_attachment;
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+
+	if (vkCreateRenderPass(bench.device, &render_pass_info, host_allocation_callbacks(), &bench.render_pass) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create render pass!\n");
+		return false;
+	}
+
+	VkDescriptorSetLayoutBinding ubo_binding = VkTypeWrapper<VkDescriptorSetLayoutBinding>{};
+	ubo_binding.binding = 0;
+	ubo_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	ubo_binding.descriptorCount = 1;
+	ubo_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layout_info = VkTypeWrapper<VkDescriptorSetLayoutCreateInfo>{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = 1;
+	layout_info.pBindings = &ubo_binding;
+
+	if (vkCreateDescriptorSetLayout(bench.device, &layout_info, host_allocation_callbacks(), &bench.descriptor_set_layout) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create descriptor set layout!\n");
+		return false;
+	}
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info = VkTypeWrapper<VkPipelineLayoutCreateInfo>{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &bench.descriptor_set_layout;
+
+	if (vkCreatePipelineLayout(bench.device, &pipeline_layout_info, host_allocation_callbacks(), &bench.pipeline_layout) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create pipeline layout!\n");
+		return false;
+	}
+
+	VkShaderModule vert_shader_module = create_shader_module(bench.device, ShaderId::shader_vert, shader_vert_axes::VERTEX_COLOR);
+	VkShaderModule frag_shader_module = create_shader_module(bench.device, ShaderId::shader_frag, shader_frag_axes::VERTEX_COLOR);
+	if (vert_shader_module == VK_NULL_HANDLE || frag_shader_module == VK_NULL_HANDLE) {
+		fprintf(stderr, "failed to create shader module!\n");
+		return false;
+	}
+
+	VkPipelineShaderStageCreateInfo shader_stages[2] = {VkTypeWrapper<VkPipelineShaderStageCreateInfo>{}, VkTypeWrapper<VkPipelineShaderStageCreateInfo>{}};
+	shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shader_stages[0].module = vert_shader_module;
+	shader_stages[0].pName = "main";
+	shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shader_stages[1].module = frag_shader_module;
+	shader_stages[1].pName = "main";
+
+	// vec3 position, vec3 colour
+	VkVertexInputBindingDescription binding_description = {0, 6 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX};
+	VkVertexInputAttributeDescription attribute_descriptions[2] = {
+		{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+		{1, 0, VK_FORMAT_R32G32B32_SFLOAT, 3 * sizeof(float)},
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = VkTypeWrapper<VkPipelineVertexInputStateCreateInfo>{};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_info.vertexBindingDescriptionCount = 1;
+	vertex_input_info.pVertexBindingDescriptions = &binding_description;
+	vertex_input_info.vertexAttributeDescriptionCount = 2;
+	vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = VkTypeWrapper<VkPipelineInputAssemblyStateCreateInfo>{};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewport_state = VkTypeWrapper<VkPipelineViewportStateCreateInfo>{};
+	viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state.viewportCount = 1;
+	viewport_state.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = VkTypeWrapper<VkPipelineRasterizationStateCreateInfo>{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = VkTypeWrapper<VkPipelineMultisampleStateCreateInfo>{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState color_blend_attachment = VkTypeWrapper<VkPipelineColorBlendAttachmentState>{};
+	color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo color_blending = VkTypeWrapper<VkPipelineColorBlendStateCreateInfo>{};
+	color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	color_blending.attachmentCount = 1;
+	color_blending.pAttachments = &color_blend_attachment;
+
+	VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	VkPipelineDynamicStateCreateInfo dynamic_state = VkTypeWrapper<VkPipelineDynamicStateCreateInfo>{};
+	dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state.dynamicStateCount = 2;
+	dynamic_state.pDynamicStates = dynamic_states;
+
+	VkGraphicsPipelineCreateInfo pipeline_info = VkTypeWrapper<VkGraphicsPipelineCreateInfo>{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeline_info.stageCount = 2;
+	pipeline_info.pStages = shader_stages;
+	pipeline_info.pVertexInputState = &vertex_input_info;
+	pipeline_info.pInputAssemblyState = &input_assembly;
+	pipeline_info.pViewportState = &viewport_state;
+	pipeline_info.pRasterizationState = &rasterizer;
+	pipeline_info.pMultisampleState = &multisampling;
+	pipeline_info.pColorBlendState = &color_blending;
+	pipeline_info.pDynamicState = &dynamic_state;
+	pipeline_info.layout = bench.pipeline_layout;
+	pipeline_info.renderPass = bench.render_pass;
+	pipeline_info.subpass = 0;
+
+	VkResult result = vkCreateGraphicsPipelines(bench.device, VK_NULL_HANDLE, 1, &pipeline_info, host_allocation_callbacks(), &bench.pipeline);
+
+	vkDestroyShaderModule(bench.device, frag_shader_module, host_allocation_callbacks());
+	vkDestroyShaderModule(bench.device, vert_shader_module, host_allocation_callbacks());
+
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "failed to create graphics pipeline!\n");
+		return false;
+	}
+
+	return true;
+}
+
+// One buffer bound as vertices, indices and uniforms, never read since nothing is submitted
+static bool create_resources(BenchDevice& bench) {
+	VkBufferCreateInfo buffer_info = VkTypeWrapper<VkBufferCreateInfo>{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = 64 * 1024;
+	buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(bench.device, &buffer_info, host_allocation_callbacks(), &bench.buffer) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create buffer!\n");
+		return false;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(bench.device, bench.buffer, &requirements);
+
+	uint32_t memory_type = 0;
+	while (memory_type < 32 && !(requirements.memoryTypeBits & (1u << memory_type))) {
+		memory_type++;
+	}
+
+	VkMemoryAllocateInfo alloc_info = VkTypeWrapper<VkMemoryAllocateInfo>{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = requirements.size;
+	alloc_info.memoryTypeIndex = memory_type;
+
+	if (vkAllocateMemory(bench.device, &alloc_info, host_allocation_callbacks(), &bench.memory) != VK_SUCCESS ||
+			vkBindBufferMemory(bench.device, bench.buffer, bench.memory, 0) != VK_SUCCESS) {
+		fprintf(stderr, "failed to allocate buffer memory!\n");
+		return false;
+	}
+
+	VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1};
+
+	VkDescriptorPoolCreateInfo pool_info = VkTypeWrapper<VkDescriptorPoolCreateInfo>{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	pool_info.maxSets = 1;
+
+	if (vkCreateDescriptorPool(bench.device, &pool_info, host_allocation_callbacks(), &bench.descriptor_pool) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create descriptor pool!\n");
+		return false;
+	}
+
+	VkDescriptorSetAllocateInfo set_info = VkTypeWrapper<VkDescriptorSetAllocateInfo>{};
+	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_info.descriptorPool = bench.descriptor_pool;
+	set_info.descriptorSetCount = 1;
+	set_info.pSetLayouts = &bench.descriptor_set_layout;
+
+	if (vkAllocateDescriptorSets(bench.device, &set_info, &bench.descriptor_set) != VK_SUCCESS) {
+		fprintf(stderr, "failed to allocate descriptor set!\n");
+		return false;
+	}
+
+	VkDescriptorBufferInfo descriptor_buffer = {bench.buffer, 0, 3 * 16 * sizeof(float)};
+
+	VkWriteDescriptorSet descriptor_write = VkTypeWrapper<VkWriteDescriptorSet>{};
+	descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_write.dstSet = bench.descriptor_set;
+	descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	descriptor_write.descriptorCount = 1;
+	descriptor_write.pBufferInfo = &descriptor_buffer;
+
+	vkUpdateDescriptorSets(bench.device, 1, &descriptor_write, 0, NULL);
+	return true;
+}
+
+static void destroy_device(BenchDevice& bench) {
+	if (bench.device != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(bench.device, bench.descriptor_pool, host_allocation_callbacks());
+		vkDestroyBuffer(bench.device, bench.buffer, host_allocation_callbacks());
+		vkFreeMemory(bench.device, bench.memory, host_allocation_callbacks());
+		vkDestroyPipeline(bench.device, bench.pipeline, host_allocation_callbacks());
+		vkDestroyPipelineLayout(bench.device, bench.pipeline_layout, host_allocation_callbacks());
+		vkDestroyDescriptorSetLayout(bench.device, bench.descriptor_set_layout, host_allocation_callbacks());
+		vkDestroyRenderPass(bench.device, bench.render_pass, host_allocation_callbacks());
+		vkDestroyDevice(bench.device, host_allocation_callbacks());
+	}
+	if (bench.instance != VK_NULL_HANDLE) {
+		vkDestroyInstance(bench.instance, host_allocation_callbacks());
+	}
+}
+
+int main(int argc, char** argv) {
+	uint32_t draw_count = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 200000;
+
+	BenchDevice bench;
+	if (!create_device(bench) || !create_pipeline(bench) || !create_resources(bench)) {
+		destroy_device(bench);
+		return 1;
+	}
+
+	VkCommandBufferInheritanceInfo inheritance = VkTypeWrapper<VkCommandBufferInheritanceInfo>{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = bench.render_pass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = VK_NULL_HANDLE;
+
+	VkViewport viewport = {0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f};
+	VkRect2D scissor = {{0, 0}, {1920, 1080}};
+
+	// What record_command_buffer does for every partition of the draw list
+	CommandRecorder::RecordFn record_draws = [&](VkCommandBuffer command_buffer, uint32_t first, uint32_t count) {
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bench.pipeline);
+
+		VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, &bench.buffer, offsets);
+		vkCmdBindIndexBuffer(command_buffer, bench.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+		uint32_t uniform_offset = 0;
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bench.pipeline_layout, 0, 1, &bench.descriptor_set, 1, &uniform_offset);
+
+		for (uint32_t i = first; i < first + count; i++) {
+			vkCmdDrawIndexed(command_buffer, 6, 1, (i % 1024) * 6, 0, 0);
+		}
+	};
+
+	printf("%u draws\n", draw_count);
+	printf("%8s %10s %12s %10s %10s\n", "threads", "buffers", "ms", "Mdraws/s", "speedup");
+
+	double single_thread = 0.0;
+
+	// Powers of two, then every hardware thread
+	uint32_t max_threads = std::thread::hardware_concurrency();
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads > 0 ? max_threads : 1);
+
+	for (uint32_t threads : thread_counts) {
+		Core::ThreadPool pool(threads);
+
+		// A single frame slot, nothing is ever submitted so the pools can be reset straight away
+		CommandRecorder recorder;
+		if (!recorder.init(bench.device, bench.graphics_family, 1, pool)) {
+			destroy_device(bench);
+			return 1;
+		}
+
+		std::vector<VkCommandBuffer> command_buffers;
+		const int runs = 5;
+		double best = 1e30;
+
+		// The first run is a warm up, it allocates the command buffers and grows their memory
+		for (int run = 0; run <= runs; run++) {
+			recorder.beginFrame(0);
+			command_buffers.clear();
+
+			auto start = std::chrono::steady_clock::now();
+			bool ok = recorder.record(inheritance, draw_count, record_draws, command_buffers);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (!ok) {
+				recorder.destroy();
+				destroy_device(bench);
+				return 1;
+			}
+
+			if (run > 0 && seconds < best) {
+				best = seconds;
+			}
+		}
+
+		double throughput = (double) draw_count / best / 1e6;
+		if (threads == 1) {
+			single_thread = throughput;
+		}
+
+		printf("%8u %10zu %12.3f %10.2f %9.2fx\n", threads, command_buffers.size(), best * 1e3, throughput, throughput / single_thread);
+
+		recorder.destroy();
+	}
+
+	destroy_device(bench);
+	return 0;
+}
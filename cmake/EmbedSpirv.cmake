@@ -0,0 +1,41 @@
+# Turns a SPIR-V binary into a header holding it as a constexpr uint32_t array
+#
+# usage: cmake -DINPUT=<file.spv> -DOUTPUT=<file.h> -DSYMBOL=<array name> -P EmbedSpirv.cmake
+
+if(NOT INPUT OR NOT OUTPUT OR NOT SYMBOL)
+	message(FATAL_ERROR "EmbedSpirv.cmake needs INPUT, OUTPUT and SYMBOL")
+endif()
+
+file(READ "${INPUT}" spirv HEX)
+string(LENGTH "${spirv}" hex_length)
+math(EXPR remainder "${hex_length} % 8")
+
+if(hex_length EQUAL 0 OR NOT remainder EQUAL 0)
+	message(FATAL_ERROR "${INPUT} is not a whole number of SPIR-V words")
+endif()
+
+# SPIR-V is little endian, swap every group of 4 bytes into a word
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${spirv}")
+
+# 8 words per line
+set(word "0x[0-9a-f]+, ")
+string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n        " words "${words}")
+
+get_filename_component(input_name "${INPUT}" NAME)
+
+file(WRITE "${OUTPUT}.tmp"
+"// Generated from ${input_name} by EmbedSpirv.cmake, do not edit
+#pragma once
+
+#include <stdint.h>
+
+namespace VK {
+    alignas(16) inline constexpr uint32_t ${SYMBOL}[] = {
+        ${words}
+    };
+}
+")
+
+# Only touch the header when the SPIR-V actually changed
+file(COPY_FILE "${OUTPUT}.tmp" "${OUTPUT}" ONLY_IF_DIFFERENT)
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,152 @@
+# Shader permutations
+#
+# A shader declares its #define axes and the combinations that can never happen in comments:
+#
+#   // @permutation VERTEX_COLOR
+#   // @permutation DEPTH_ONLY
+#   // @exclusive VERTEX_COLOR DEPTH_ONLY
+#
+# Axis i is bit i of the variant key. Every reachable key gets its own glslc command (the build tool
+# runs them in parallel) and is embedded into the target, and a generated table indexed by
+# [shader][key] lets the runtime pick a variant in O(1).
+#
+# Key 0 is the shader compiled without any define, it is the <shader>.spv already produced by
+# compile_shader().
+
+function(embed_shader_variants target)
+	cmake_parse_arguments(PARSE_ARGV 1 arg "" "OUTPUT_DIR" "SOURCES")
+
+	set(headers "")
+	set(includes "")
+	set(ids "")
+	set(axes "")
+	set(variant_arrays "")
+	set(tables "")
+	set(variant_total 0)
+
+	foreach(shader ${arg_SOURCES})
+		# ----- Axes declared by the shader -----
+		file(STRINGS "${CMAKE_CURRENT_SOURCE_DIR}/${shader}" permutation_lines REGEX "^//[ \t]*@permutation[ \t]+")
+		file(STRINGS "${CMAKE_CURRENT_SOURCE_DIR}/${shader}" exclusive_lines REGEX "^//[ \t]*@exclusive[ \t]+")
+		set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${CMAKE_CURRENT_SOURCE_DIR}/${shader}")
+
+		set(axis_names "")
+		foreach(line ${permutation_lines})
+			string(REGEX REPLACE "^//[ \t]*@permutation[ \t]+([A-Za-z0-9_]+).*$" "\\1" axis "${line}")
+			list(APPEND axis_names ${axis})
+		endforeach()
+
+		list(LENGTH axis_names axis_count)
+		if(axis_count GREATER 8)
+			message(FATAL_ERROR "${shader} declares ${axis_count} permutation axes, at most 8 are supported")
+		endif()
+
+		# Each @exclusive line becomes a mask, a key with two or more of its bits set is unreachable
+		set(exclusive_masks "")
+		foreach(line ${exclusive_lines})
+			string(REGEX REPLACE "^//[ \t]*@exclusive[ \t]+" "" names "${line}")
+			string(REGEX MATCHALL "[A-Za-z0-9_]+" names "${names}")
+
+			set(mask 0)
+			foreach(name ${names})
+				list(FIND axis_names ${name} bit)
+				if(bit EQUAL -1)
+					message(FATAL_ERROR "${shader}: @exclusive names ${name} which is not a @permutation axis")
+				endif()
+				math(EXPR mask "${mask} | (1 << ${bit})")
+			endforeach()
+			list(APPEND exclusive_masks ${mask})
+		endforeach()
+
+		# shaders/shader.vert -> shader_vert
+		get_filename_component(shader_file "${shader}" NAME)
+		string(MAKE_C_IDENTIFIER "${shader_file}" id)
+		string(APPEND ids "        ${id},\n")
+
+		string(APPEND axes "    namespace ${id}_axes {\n")
+		set(bit 0)
+		foreach(axis ${axis_names})
+			string(APPEND axes "        constexpr uint32_t ${axis} = 1u << ${bit};\n")
+			math(EXPR bit "${bit} + 1")
+		endforeach()
+		string(APPEND axes "    }\n")
+
+		# ----- One glslc command and one embedded array per reachable key -----
+		math(EXPR key_count "1 << ${axis_count}")
+		math(EXPR last_key "${key_count} - 1")
+		string(APPEND variant_arrays "    inline constexpr EmbeddedShader ${id}_variants[] = {\n")
+
+		foreach(key RANGE ${last_key})
+			set(reachable TRUE)
+			foreach(mask ${exclusive_masks})
+				math(EXPR set_bits "${key} & ${mask}")
+				math(EXPR lowest "${set_bits} & (-${set_bits})")
+				if(NOT set_bits EQUAL lowest)
+					set(reachable FALSE)
+				endif()
+			endforeach()
+
+			if(NOT reachable)
+				string(APPEND variant_arrays "        {nullptr, nullptr, 0},\n")
+				continue()
+			endif()
+
+			if(key EQUAL 0)
+				set(spirv "${shader}.spv")
+			else()
+				set(spirv "${shader}.${key}.spv")
+
+				set(defines "")
+				set(bit 0)
+				foreach(axis ${axis_names})
+					math(EXPR on "${key} & (1 << ${bit})")
+					if(NOT on EQUAL 0)
+						list(APPEND defines "-D${axis}=1")
+					endif()
+					math(EXPR bit "${bit} + 1")
+				endforeach()
+
+				add_custom_command(
+					OUTPUT ${spirv}
+					DEPENDS ${shader}
+					COMMAND
+						${glslc_executable}
+						${defines}
+						-o ${spirv}
+						${CMAKE_CURRENT_SOURCE_DIR}/${shader}
+				)
+			endif()
+
+			string(MAKE_C_IDENTIFIER "${spirv}" symbol)
+			set(header "${arg_OUTPUT_DIR}/${spirv}.h")
+
+			add_custom_command(
+				OUTPUT ${header}
+				DEPENDS "${CMAKE_CURRENT_BINARY_DIR}/${spirv}" "${PROJECT_SOURCE_DIR}/cmake/EmbedSpirv.cmake"
+				COMMAND ${CMAKE_COMMAND}
+					"-DINPUT=${CMAKE_CURRENT_BINARY_DIR}/${spirv}"
+					"-DOUTPUT=${header}"
+					"-DSYMBOL=${symbol}"
+					-P "${PROJECT_SOURCE_DIR}/cmake/EmbedSpirv.cmake"
+			)
+
+			list(APPEND headers ${header})
+			string(APPEND includes "#include \"${spirv}.h\"\n")
+			string(APPEND variant_arrays "        {\"${spirv}\", ${symbol}, sizeof(${symbol})},\n")
+			math(EXPR variant_total "${variant_total} + 1")
+		endforeach()
+
+		string(APPEND variant_arrays "    };\n\n")
+		string(APPEND tables "        {\"${shader}.spv\", ${axis_count}, ${id}_variants},\n")
+	endforeach()
+
+	message(STATUS "Embedding ${variant_total} shader variants")
+
+	file(CONFIGURE
+		OUTPUT "${arg_OUTPUT_DIR}/EmbeddedShaderTable.inc"
+		CONTENT "// Generated by ShaderVariants.cmake, do not edit\n\n${includes}\nnamespace VK {\n    enum class ShaderId : uint32_t {\n${ids}    };\n\n${axes}\n${variant_arrays}    inline constexpr ShaderVariants shader_variant_tables[] = {\n${tables}    };\n}\n"
+	)
+
+	target_sources(${target} PRIVATE ${headers})
+	target_include_directories(${target} PRIVATE "${arg_OUTPUT_DIR}")
+endfunction()
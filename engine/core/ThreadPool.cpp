@@ -0,0 +1,98 @@
+#include "ThreadPool.hpp"
+
+namespace Core {
+
+
+ThreadPool::ThreadPool(uint32_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::thread::hardware_concurrency();
+	}
+
+	this->thread_count = thread_count > 0 ? thread_count : 1;
+
+	// The calling thread is worker 0
+	for (uint32_t i = 1; i < this->thread_count; i++) {
+		threads.emplace_back(&ThreadPool::worker_loop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake_cv.notify_all();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::run_indices(uint32_t worker) {
+	for (;;) {
+		uint32_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+		if (index >= task_count) {
+			return;
+		}
+		(*task)(index, worker);
+	}
+}
+
+void ThreadPool::worker_loop(uint32_t worker) {
+	uint64_t seen_generation = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake_cv.wait(lock, [&] { return stopping || generation != seen_generation; });
+
+			if (stopping) {
+				return;
+			}
+
+			seen_generation = generation;
+		}
+
+		run_indices(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy_workers--;
+		}
+		done_cv.notify_one();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t count, const Task& task) {
+	if (count == 0) {
+		return;
+	}
+
+	// Not worth waking anybody up
+	if (count == 1 || threads.empty()) {
+		for (uint32_t i = 0; i < count; i++) {
+			task(i, 0);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> call_lock(call_mutex);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		task_count = count;
+		next_index.store(0, std::memory_order_relaxed);
+		busy_workers = (uint32_t) threads.size();
+		generation++;
+	}
+	wake_cv.notify_all();
+
+	run_indices(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_cv.wait(lock, [this] { return busy_workers == 0; });
+	this->task = nullptr;
+}
+
+}
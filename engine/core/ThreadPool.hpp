@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+namespace Core {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Thread pool  //////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Fixed set of workers for data-parallel loops.
+ *
+ * parallelFor() splits an index range over the workers and the calling thread and returns once
+ * every index has been processed. Each call sees worker ids in [0, threadCount()), the calling
+ * thread always being 0, so callers can keep per-worker scratch memory without locking.
+ */
+class ThreadPool {
+public:
+    typedef std::function<void(uint32_t index, uint32_t worker)> Task;
+
+    // 0 uses every hardware thread
+    explicit ThreadPool(uint32_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    void operator=(const ThreadPool&) = delete;
+
+    uint32_t threadCount() const { return thread_count; }
+
+    void parallelFor(uint32_t count, const Task& task);
+
+    // Engine wide pool, sized to the machine
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    void worker_loop(uint32_t worker);
+    void run_indices(uint32_t worker);
+
+    uint32_t thread_count;
+    std::vector<std::thread> threads;
+
+    std::mutex call_mutex;      // one loop at a time
+
+    std::mutex mutex;
+    std::condition_variable wake_cv;
+    std::condition_variable done_cv;
+    uint64_t generation = 0;
+    uint32_t busy_workers = 0;
+    bool stopping = false;
+
+    const Task* task = nullptr;
+    uint32_t task_count = 0;
+    std::atomic<uint32_t> next_index{0};
+};
+
+}
@@ -0,0 +1,461 @@
+#include "BarrierRecorder.hpp"
+
+namespace VK {
+
+#define SHADER_STAGES (VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT)
+#define DEPTH_STAGES (VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT)
+
+// Only writes need to be made available, reads never go in a barrier's source access mask
+#define WRITE_ACCESS (VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT \
+	| VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT)
+
+// Indexed by ResourceAccess
+static const AccessInfo access_infos[(uint32_t) ResourceAccess::Count] = {
+	// ColorAttachment
+	{VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0},
+	// DepthAttachment
+	{DEPTH_STAGES, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0},
+	// DepthRead
+	{DEPTH_STAGES, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0},
+	// Sampled
+	{SHADER_STAGES, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0},
+	// StorageRead
+	{SHADER_STAGES, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+	// StorageWrite
+	{SHADER_STAGES, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
+	// TransferSrc
+	{VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT},
+	// TransferDst
+	{VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT},
+	// VertexBuffer
+	{VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT},
+	// IndexBuffer
+	{VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT},
+	// UniformBuffer
+	{SHADER_STAGES, VK_ACCESS_2_UNIFORM_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT},
+	// IndirectBuffer
+	{VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT},
+	// Present, nothing after the barrier touches the image, the semaphore signal orders the rest
+	{VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, 0},
+};
+
+const AccessInfo& access_info(ResourceAccess access) {
+	return access_infos[(uint32_t) access];
+}
+
+ResourceState access_state(ResourceAccess access) {
+	const AccessInfo& info = access_info(access);
+
+	ResourceState state;
+	state.layout = info.layout;
+	state.stages = info.stages;
+	state.access = info.access;
+	return state;
+}
+
+// The synchronization2 only bits widened to the legacy ones covering them
+static VkPipelineStageFlags legacy_stages(VkPipelineStageFlags2 stages) {
+	VkPipelineStageFlags legacy = (VkPipelineStageFlags) (stages & 0xFFFFFFFFull);
+
+	if (stages & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT)) {
+		legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	if (stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT)) {
+		legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	}
+	if (stages & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT) {
+		legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT
+			| VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+	}
+
+	return legacy;
+}
+
+static VkAccessFlags legacy_access(VkAccessFlags2 access) {
+	VkAccessFlags legacy = (VkAccessFlags) (access & 0xFFFFFFFFull);
+
+	if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT)) {
+		legacy |= VK_ACCESS_SHADER_READ_BIT;
+	}
+	if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) {
+		legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+	}
+
+	return legacy;
+}
+
+void BarrierRecorder::init(PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2) {
+	this->cmd_pipeline_barrier2 = cmd_pipeline_barrier2;
+	clear();
+}
+
+void BarrierRecorder::clear() {
+	images.clear();
+	buffers.clear();
+	pending_images.clear();
+	pending_buffers.clear();
+	queue_stages = ~(VkPipelineStageFlags2) 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Resource states  //////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+void BarrierRecorder::setImageState(VkImage image, VkImageAspectFlags aspect, const ResourceState& state) {
+	Tracked tracked;
+	tracked.aspect = aspect;
+	tracked.layout = state.layout;
+	tracked.write_stages = state.stages;
+	tracked.write_access = state.access & WRITE_ACCESS;
+	images[image] = tracked;
+}
+
+void BarrierRecorder::setBufferState(VkBuffer buffer, const ResourceState& state) {
+	Tracked tracked;
+	tracked.write_stages = state.stages;
+	tracked.write_access = state.access & WRITE_ACCESS;
+	buffers[buffer] = tracked;
+}
+
+void BarrierRecorder::acquiredImage(VkImage image) {
+	images[image].acquired = true;
+}
+
+void BarrierRecorder::acquiredBuffer(VkBuffer buffer) {
+	buffers[buffer].acquired = true;
+}
+
+void BarrierRecorder::releaseBuffer(VkBuffer buffer, uint32_t src_family, uint32_t dst_family) {
+	Tracked& tracked = buffers[buffer];
+	tracked.releasing = true;
+	tracked.src_family = src_family;
+	tracked.dst_family = dst_family;
+
+	if (!tracked.pending) {
+		tracked.pending = true;
+		tracked.use_stages = 0;
+		tracked.use_access = 0;
+		tracked.use_write = false;
+		pending_buffers.push_back(buffer);
+	}
+}
+
+void BarrierRecorder::acquireBuffer(VkBuffer buffer, uint32_t src_family, uint32_t dst_family) {
+	Tracked& tracked = buffers[buffer];
+	tracked.acquired = true;
+	tracked.src_family = src_family;
+	tracked.dst_family = dst_family;
+}
+
+void BarrierRecorder::forgetImage(VkImage image) {
+	images.erase(image);
+}
+
+void BarrierRecorder::forgetBuffer(VkBuffer buffer) {
+	buffers.erase(buffer);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////  Declared uses  //////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+bool BarrierRecorder::useImage(VkImage image, VkImageAspectFlags aspect, ResourceAccess access, bool write) {
+	return useImage(image, aspect, access_state(access), write);
+}
+
+bool BarrierRecorder::useImage(VkImage image, VkImageAspectFlags aspect, const ResourceState& state, bool write) {
+	Tracked& tracked = images[image];
+	tracked.aspect = aspect;
+
+	bool first = !tracked.pending;
+	if (!declare(tracked, state.stages & queue_stages, state.access, state.layout, write)) {
+		return false;
+	}
+	if (first) {
+		pending_images.push_back(image);
+	}
+	return true;
+}
+
+void BarrierRecorder::useBuffer(VkBuffer buffer, ResourceAccess access, bool write) {
+	const AccessInfo& info = access_info(access);
+	Tracked& tracked = buffers[buffer];
+
+	bool first = !tracked.pending;
+	declare(tracked, info.stages & queue_stages, info.access, VK_IMAGE_LAYOUT_UNDEFINED, write);
+	if (first) {
+		pending_buffers.push_back(buffer);
+	}
+}
+
+void BarrierRecorder::useBufferReads(VkBuffer buffer, VkBufferUsageFlags usage) {
+	static const ResourceAccess reads[] = {
+		ResourceAccess::VertexBuffer, ResourceAccess::IndexBuffer, ResourceAccess::UniformBuffer,
+		ResourceAccess::IndirectBuffer, ResourceAccess::StorageRead, ResourceAccess::TransferSrc,
+	};
+
+	for (ResourceAccess access : reads) {
+		if (access_info(access).buffer_usage & usage) {
+			useBuffer(buffer, access, false);
+		}
+	}
+}
+
+bool BarrierRecorder::declare(Tracked& tracked, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write) {
+	if (!tracked.pending) {
+		tracked.pending = true;
+		tracked.use_stages = stages;
+		tracked.use_access = access;
+		tracked.use_layout = layout;
+		tracked.use_write = write;
+		return true;
+	}
+
+	// An image is in one layout at a time, uses of the same sync point have to agree on it
+	if (layout != tracked.use_layout) {
+		return false;
+	}
+
+	tracked.use_stages |= stages;
+	tracked.use_access |= access;
+	tracked.use_write |= write;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////  Batches  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+void BarrierRecorder::resolve(Tracked& tracked, VkImage image, BarrierBatch& batch) {
+	VkPipelineStageFlags2 stages = tracked.use_stages;
+	VkAccessFlags2 access = tracked.use_access;
+	bool write = tracked.use_write;
+	tracked.pending = false;
+
+	if (tracked.acquired) {
+		// The semaphore wait covers execution and memory, what the other queue did is done and visible
+		tracked.write_stages = 0;
+		tracked.write_access = 0;
+		tracked.read_stages = 0;
+		tracked.visible_stages = 0;
+		tracked.visible_access = 0;
+	}
+
+	VkPipelineStageFlags2 src_stages = (tracked.write_stages | tracked.read_stages) & queue_stages;
+
+	if (image != VK_NULL_HANDLE && tracked.use_layout != tracked.layout) {
+		VkImageMemoryBarrier2 barrier = VkTypeWrapper<VkImageMemoryBarrier2>{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		// After a semaphore wait the transition chains to it through its stage mask, every command
+		barrier.srcStageMask = tracked.acquired ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : src_stages;
+		barrier.srcAccessMask = tracked.write_access;
+		barrier.dstStageMask = stages;
+		barrier.dstAccessMask = access;
+		barrier.oldLayout = tracked.layout;
+		barrier.newLayout = tracked.use_layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = tracked.aspect;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		batch.images.push_back(barrier);
+
+		// The transition is a write, later uses at other stages wait for it
+		tracked.layout = tracked.use_layout;
+		tracked.write_stages = stages;
+		tracked.write_access = write ? access & WRITE_ACCESS : 0;
+		tracked.read_stages = write ? 0 : stages;
+		tracked.visible_stages = stages;
+		tracked.visible_access = access;
+		tracked.acquired = false;
+		return;
+	}
+	tracked.acquired = false;
+
+	if (write) {
+		// Write after write or after read, the earlier uses finish first and earlier writes are made available
+		if (src_stages != 0) {
+			batch.memory.srcStageMask |= src_stages;
+			batch.memory.dstStageMask |= stages;
+			if (tracked.write_access != 0) {
+				batch.memory.srcAccessMask |= tracked.write_access;
+				batch.memory.dstAccessMask |= access;
+			}
+		}
+
+		tracked.write_stages = stages;
+		tracked.write_access = access & WRITE_ACCESS;
+		tracked.read_stages = 0;
+		tracked.visible_stages = stages;
+		tracked.visible_access = access;
+		return;
+	}
+
+	// Read after write, once for every stage and access the write is not visible to yet
+	VkPipelineStageFlags2 write_stages = tracked.write_stages & queue_stages;
+	bool stages_missing = (stages & ~tracked.visible_stages) != 0;
+	bool access_missing = tracked.write_access != 0 && (access & ~tracked.visible_access) != 0;
+
+	if (write_stages != 0 && (stages_missing || access_missing)) {
+		batch.memory.srcStageMask |= write_stages;
+		batch.memory.dstStageMask |= stages;
+		if (tracked.write_access != 0) {
+			batch.memory.srcAccessMask |= tracked.write_access;
+			batch.memory.dstAccessMask |= access;
+		}
+		tracked.visible_stages |= stages;
+		tracked.visible_access |= access;
+	}
+
+	tracked.read_stages |= stages;
+}
+
+void BarrierRecorder::resolve_transfer(Tracked& tracked, VkBuffer buffer, BarrierBatch& batch) {
+	VkBufferMemoryBarrier2 barrier = VkTypeWrapper<VkBufferMemoryBarrier2>{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	barrier.srcQueueFamilyIndex = tracked.src_family;
+	barrier.dstQueueFamilyIndex = tracked.dst_family;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	if (tracked.releasing) {
+		// Everything done on this queue finishes and its writes are made available, nothing here comes after
+		barrier.srcStageMask = (tracked.write_stages | tracked.read_stages) & queue_stages;
+		barrier.srcAccessMask = tracked.write_access;
+		batch.buffers.push_back(barrier);
+		return;
+	}
+
+	// The semaphore wait made the release visible, the acquire only has to come before the use
+	barrier.srcStageMask = tracked.use_stages;
+	barrier.dstStageMask = tracked.use_stages;
+	barrier.dstAccessMask = tracked.use_access;
+	batch.buffers.push_back(barrier);
+
+	tracked.pending = false;
+	tracked.acquired = false;
+	tracked.src_family = VK_QUEUE_FAMILY_IGNORED;
+	tracked.dst_family = VK_QUEUE_FAMILY_IGNORED;
+	tracked.write_stages = tracked.use_write ? tracked.use_stages : 0;
+	tracked.write_access = tracked.use_write ? tracked.use_access & WRITE_ACCESS : 0;
+	tracked.read_stages = tracked.use_write ? 0 : tracked.use_stages;
+	tracked.visible_stages = tracked.use_stages;
+	tracked.visible_access = tracked.use_access;
+}
+
+BarrierBatch BarrierRecorder::take() {
+	BarrierBatch batch;
+
+	for (VkImage image : pending_images) {
+		resolve(images[image], image, batch);
+	}
+	for (VkBuffer buffer : pending_buffers) {
+		Tracked& tracked = buffers[buffer];
+		if (tracked.releasing) {
+			// Owned by the other queue from here on
+			resolve_transfer(tracked, buffer, batch);
+			buffers.erase(buffer);
+		} else if (tracked.src_family != VK_QUEUE_FAMILY_IGNORED) {
+			resolve_transfer(tracked, buffer, batch);
+		} else {
+			resolve(tracked, VK_NULL_HANDLE, batch);
+		}
+	}
+
+	pending_images.clear();
+	pending_buffers.clear();
+	return batch;
+}
+
+void BarrierRecorder::emit(VkCommandBuffer command_buffer, const BarrierBatch& batch) const {
+	if (batch.empty()) {
+		return;
+	}
+
+	bool has_memory_barrier = (batch.memory.srcAccessMask | batch.memory.dstAccessMask) != 0
+		|| (batch.memory.srcStageMask | batch.memory.dstStageMask) != 0;
+
+	if (cmd_pipeline_barrier2 != nullptr) {
+		VkDependencyInfo dependency = VkTypeWrapper<VkDependencyInfo>{};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependency.memoryBarrierCount = has_memory_barrier ? 1 : 0;
+		dependency.pMemoryBarriers = &batch.memory;
+		dependency.bufferMemoryBarrierCount = (uint32_t) batch.buffers.size();
+		dependency.pBufferMemoryBarriers = batch.buffers.data();
+		dependency.imageMemoryBarrierCount = (uint32_t) batch.images.size();
+		dependency.pImageMemoryBarriers = batch.images.data();
+
+		cmd_pipeline_barrier2(command_buffer, &dependency);
+		return;
+	}
+
+	// Legacy barriers have one pair of stage masks for the whole command
+	VkPipelineStageFlags src_stages = legacy_stages(batch.memory.srcStageMask);
+	VkPipelineStageFlags dst_stages = legacy_stages(batch.memory.dstStageMask);
+
+	VkMemoryBarrier memory_barrier = VkTypeWrapper<VkMemoryBarrier>{};
+	memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memory_barrier.srcAccessMask = legacy_access(batch.memory.srcAccessMask);
+	memory_barrier.dstAccessMask = legacy_access(batch.memory.dstAccessMask);
+	uint32_t memory_barrier_count = (memory_barrier.srcAccessMask | memory_barrier.dstAccessMask) != 0 ? 1 : 0;
+
+	std::vector<VkImageMemoryBarrier> image_barriers(batch.images.size());
+	for (size_t i = 0; i < batch.images.size(); i++) {
+		const VkImageMemoryBarrier2& barrier2 = batch.images[i];
+		src_stages |= legacy_stages(barrier2.srcStageMask);
+		dst_stages |= legacy_stages(barrier2.dstStageMask);
+
+		VkImageMemoryBarrier& barrier = image_barriers[i];
+		barrier = VkTypeWrapper<VkImageMemoryBarrier>{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = legacy_access(barrier2.srcAccessMask);
+		barrier.dstAccessMask = legacy_access(barrier2.dstAccessMask);
+		barrier.oldLayout = barrier2.oldLayout;
+		barrier.newLayout = barrier2.newLayout;
+		barrier.srcQueueFamilyIndex = barrier2.srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = barrier2.dstQueueFamilyIndex;
+		barrier.image = barrier2.image;
+		barrier.subresourceRange = barrier2.subresourceRange;
+	}
+
+	std::vector<VkBufferMemoryBarrier> buffer_barriers(batch.buffers.size());
+	for (size_t i = 0; i < batch.buffers.size(); i++) {
+		const VkBufferMemoryBarrier2& barrier2 = batch.buffers[i];
+		src_stages |= legacy_stages(barrier2.srcStageMask);
+		dst_stages |= legacy_stages(barrier2.dstStageMask);
+
+		VkBufferMemoryBarrier& barrier = buffer_barriers[i];
+		barrier = VkTypeWrapper<VkBufferMemoryBarrier>{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = legacy_access(barrier2.srcAccessMask);
+		barrier.dstAccessMask = legacy_access(barrier2.dstAccessMask);
+		barrier.srcQueueFamilyIndex = barrier2.srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = barrier2.dstQueueFamilyIndex;
+		barrier.buffer = barrier2.buffer;
+		barrier.offset = barrier2.offset;
+		barrier.size = barrier2.size;
+	}
+
+	vkCmdPipelineBarrier(command_buffer,
+		src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		dst_stages != 0 ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, memory_barrier_count, &memory_barrier, (uint32_t) buffer_barriers.size(), buffer_barriers.data(),
+		(uint32_t) image_barriers.size(), image_barriers.data());
+}
+
+}
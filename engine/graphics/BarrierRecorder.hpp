@@ -0,0 +1,170 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "VkCommon.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Barrier recorder  //////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// How a command uses a resource, the stages, access masks and image layout follow from it
+enum class ResourceAccess : uint32_t {
+    ColorAttachment,
+    DepthAttachment,
+    DepthRead,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+    VertexBuffer,
+    IndexBuffer,
+    UniformBuffer,
+    IndirectBuffer,
+    Present,
+    Count
+};
+
+struct AccessInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkImageLayout layout;               // images only
+    VkImageUsageFlags image_usage;      // the resource needs for it
+    VkBufferUsageFlags buffer_usage;
+};
+
+const AccessInfo& access_info(ResourceAccess access);
+
+// State a resource is in outside the recorder's knowledge: before its first use, or after its last
+struct ResourceState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags2 stages = 0;   // of the work outside to wait for, or to make it visible to
+    VkAccessFlags2 access = 0;
+};
+
+// What a use leaves behind, for commands recorded without declaring it first
+ResourceState access_state(ResourceAccess access);
+
+// One barrier command
+struct BarrierBatch {
+    // Buffers, and images staying in their layout, all merged into one
+    VkMemoryBarrier2 memory = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    // Layout transitions, one per image
+    std::vector<VkImageMemoryBarrier2> images;
+    // Queue family ownership transfers, one per buffer
+    std::vector<VkBufferMemoryBarrier2> buffers;
+
+    bool empty() const {
+        return memory.srcStageMask == 0 && memory.dstStageMask == 0 && memory.srcAccessMask == 0 && memory.dstAccessMask == 0
+            && images.empty() && buffers.empty();
+    }
+};
+
+/*
+ * Batches pipeline barriers from declared uses of buffers and images.
+ *
+ * Callers say how the next commands use a resource (useImage(), useBuffer()) instead of writing
+ * stage and access masks. The recorder keeps each resource's layout, last writer, readers since
+ * and the stages the last write was made visible to; take() then turns every use declared since
+ * the previous one into a single batch, holding only what those uses need:
+ *  - a layout transition per image changing layout, from whatever last touched it;
+ *  - write after write and write after read hazards, execution only for the latter;
+ *  - read after write hazards, once per stage and access the write is not visible to yet.
+ * A read following reads in the same layout needs nothing. Several uses of one resource before
+ * the same take() are merged, they are all ordered after the batch. Everything not changing an
+ * image's layout goes in one global memory barrier.
+ *
+ * An exclusive buffer changing queue family is released on one queue and acquired on the other,
+ * after a semaphore wait: releaseBuffer() once its last use there was taken, acquireBuffer() ahead
+ * of its first use on the new queue. Each gives a buffer barrier naming both families.
+ *
+ * With synchronization2 (core in Vulkan 1.3, or VK_KHR_synchronization2) a batch is one
+ * vkCmdPipelineBarrier2 with the precise stages and access of each barrier: index and vertex
+ * attribute input, copies, sampled and storage reads apart from the rest. Without it the same
+ * batch goes through vkCmdPipelineBarrier, with masks widened to their legacy equivalents.
+ *
+ * Resources are tracked by handle from their first use. A destroyed one has to be forgotten, or a
+ * new object reusing its handle inherits its state. Not thread safe, one recorder per thread.
+ */
+class BarrierRecorder {
+public:
+    // cmd_pipeline_barrier2 null without synchronization2
+    void init(PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2);
+
+    // Forgets every resource and whatever was declared since the last take()
+    void clear();
+
+    // Stages of the queue the commands go to, the barriers are limited to them
+    void setQueueStages(VkPipelineStageFlags2 stages) { queue_stages = stages; }
+
+    // What happened to the resource before the recorder saw it
+    void setImageState(VkImage image, VkImageAspectFlags aspect, const ResourceState& state);
+    void setBufferState(VkBuffer buffer, const ResourceState& state);
+
+    // A semaphore wait ordered and made visible everything done to it so far, on another queue
+    void acquiredImage(VkImage image);
+    void acquiredBuffer(VkBuffer buffer);
+
+    // Queue family ownership transfer. The released buffer is forgotten once taken, the acquire
+    // happens with the next use declared and its source stages are that use's, for the semaphore
+    // wait on them to chain to it
+    void releaseBuffer(VkBuffer buffer, uint32_t src_family, uint32_t dst_family);
+    void acquireBuffer(VkBuffer buffer, uint32_t src_family, uint32_t dst_family);
+
+    void forgetImage(VkImage image);
+    void forgetBuffer(VkBuffer buffer);
+
+    // False when the image was already declared in another layout since the last take()
+    bool useImage(VkImage image, VkImageAspectFlags aspect, ResourceAccess access, bool write);
+    bool useImage(VkImage image, VkImageAspectFlags aspect, const ResourceState& state, bool write);
+    void useBuffer(VkBuffer buffer, ResourceAccess access, bool write);
+    // Every read its usage allows, for a buffer handed over to whatever comes next
+    void useBufferReads(VkBuffer buffer, VkBufferUsageFlags usage);
+
+    // Barriers for every use declared since the last take()
+    BarrierBatch take();
+    void emit(VkCommandBuffer command_buffer, const BarrierBatch& batch) const;
+    void flush(VkCommandBuffer command_buffer) { emit(command_buffer, take()); }
+
+    bool usesSynchronization2() const { return cmd_pipeline_barrier2 != nullptr; }
+
+private:
+    struct Tracked {
+        VkImageAspectFlags aspect = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 write_stages = 0;
+        VkAccessFlags2 write_access = 0;
+        VkPipelineStageFlags2 read_stages = 0;      // since the last write
+        VkPipelineStageFlags2 visible_stages = 0;   // the last write was made visible to
+        VkAccessFlags2 visible_access = 0;
+        bool acquired = false;
+        bool releasing = false;
+        uint32_t src_family = VK_QUEUE_FAMILY_IGNORED;  // of the ownership transfer being declared
+        uint32_t dst_family = VK_QUEUE_FAMILY_IGNORED;
+
+        // Uses declared since the last take(), merged
+        bool pending = false;
+        VkPipelineStageFlags2 use_stages = 0;
+        VkAccessFlags2 use_access = 0;
+        VkImageLayout use_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool use_write = false;
+    };
+
+    bool declare(Tracked& tracked, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write);
+    void resolve(Tracked& tracked, VkImage image, BarrierBatch& batch);
+    void resolve_transfer(Tracked& tracked, VkBuffer buffer, BarrierBatch& batch);
+
+    PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2 = nullptr;
+    VkPipelineStageFlags2 queue_stages = ~(VkPipelineStageFlags2) 0;
+
+    std::unordered_map<VkImage, Tracked> images;
+    std::unordered_map<VkBuffer, Tracked> buffers;
+    std::vector<VkImage> pending_images;
+    std::vector<VkBuffer> pending_buffers;
+};
+
+}
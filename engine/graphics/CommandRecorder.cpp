@@ -0,0 +1,139 @@
+#include "CommandRecorder.hpp"
+
+#include <atomic>
+
+namespace VK {
+
+bool CommandRecorder::init(VkDevice device, uint32_t queue_family, uint32_t frame_count, Core::ThreadPool& pool) {
+	this->device = device;
+	this->thread_pool = &pool;
+	this->worker_count = pool.threadCount();
+	this->frame_count = frame_count;
+	frame = 0;
+
+	VkCommandPoolCreateInfo pool_info = VkTypeWrapper<VkCommandPoolCreateInfo>{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	// Reset as a whole every frame, never per buffer
+	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_info.queueFamilyIndex = queue_family;
+
+	pools.resize((size_t) frame_count * worker_count);
+	for (WorkerPool& worker : pools) {
+		if (vkCreateCommandPool(device, &pool_info, host_allocation_callbacks(), &worker.pool) != VK_SUCCESS) {
+			fprintf(stderr, "failed to create a recording command pool!\n");
+			destroy();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CommandRecorder::destroy() {
+	// Destroying a pool frees its command buffers
+	for (WorkerPool& worker : pools) {
+		if (worker.pool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(device, worker.pool, host_allocation_callbacks());
+		}
+	}
+	pools.clear();
+}
+
+void CommandRecorder::beginFrame(uint32_t frame) {
+	this->frame = frame % frame_count;
+
+	for (uint32_t w = 0; w < worker_count; w++) {
+		WorkerPool& worker = pools[(size_t) this->frame * worker_count + w];
+		if (worker.used == 0) {
+			continue;
+		}
+
+		// Keeps the buffers' memory for next time, recording then allocates nothing
+		vkResetCommandPool(device, worker.pool, 0);
+		worker.used = 0;
+	}
+}
+
+VkCommandBuffer CommandRecorder::acquire(WorkerPool& worker) {
+	if (worker.used == worker.command_buffers.size()) {
+		VkCommandBufferAllocateInfo alloc_info = VkTypeWrapper<VkCommandBufferAllocateInfo>{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.commandPool = worker.pool;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		alloc_info.commandBufferCount = 1;
+
+		VkCommandBuffer command_buffer;
+		if (vkAllocateCommandBuffers(device, &alloc_info, &command_buffer) != VK_SUCCESS) {
+			fprintf(stderr, "failed to allocate a secondary command buffer!\n");
+			return VK_NULL_HANDLE;
+		}
+		worker.command_buffers.push_back(command_buffer);
+	}
+
+	return worker.command_buffers[worker.used++];
+}
+
+bool CommandRecorder::record(const VkCommandBufferInheritanceInfo& inheritance, uint32_t item_count, const RecordFn& fn,
+		std::vector<VkCommandBuffer>& command_buffers) {
+	if (item_count == 0) {
+		return true;
+	}
+
+	// Enough partitions to keep every worker busy, none too small to pay for its own buffer
+	uint32_t partition_count = (item_count + RECORD_MIN_DRAWS_PER_PARTITION - 1) / RECORD_MIN_DRAWS_PER_PARTITION;
+	if (partition_count > worker_count) {
+		partition_count = worker_count;
+	}
+
+	size_t first_output = command_buffers.size();
+	command_buffers.resize(first_output + partition_count, VK_NULL_HANDLE);
+	VkCommandBuffer* output = command_buffers.data() + first_output;
+
+	WorkerPool* frame_pools = &pools[(size_t) frame * worker_count];
+	std::atomic<bool> failed{false};
+
+	thread_pool->parallelFor(partition_count, [&](uint32_t partition, uint32_t worker) {
+		VkCommandBuffer command_buffer = acquire(frame_pools[worker]);
+		if (command_buffer == VK_NULL_HANDLE) {
+			failed.store(true, std::memory_order_relaxed);
+			return;
+		}
+
+		VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		// Not one time submit, the primary executing them may be replayed frame after frame
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		begin_info.pInheritanceInfo = &inheritance;
+
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+			fprintf(stderr, "failed to begin recording a secondary command buffer!\n");
+			failed.store(true, std::memory_order_relaxed);
+			return;
+		}
+
+		// Contiguous ranges, the first item_count % partition_count partitions take one more item
+		uint32_t base = item_count / partition_count;
+		uint32_t extra = item_count % partition_count;
+		uint32_t first = partition * base + (partition < extra ? partition : extra);
+		uint32_t count = base + (partition < extra ? 1 : 0);
+
+		fn(command_buffer, first, count);
+
+		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+			fprintf(stderr, "failed to record a secondary command buffer!\n");
+			failed.store(true, std::memory_order_relaxed);
+			return;
+		}
+
+		output[partition] = command_buffer;
+	});
+
+	if (failed.load(std::memory_order_relaxed)) {
+		command_buffers.resize(first_output);
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "VkCommon.hpp"
+#include "engine/core/ThreadPool.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Command recorder  //////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Smallest share of a draw list worth handing to another thread
+#define RECORD_MIN_DRAWS_PER_PARTITION 64
+
+/*
+ * Records a draw list into secondary command buffers on every worker of a thread pool.
+ *
+ * Each worker owns one command pool per frame in flight, so recording never locks: a pool is only
+ * touched by the thread with its worker id. beginFrame() resets every pool of a frame at once with
+ * vkResetCommandPool, once the frame that last used them has completed on the GPU, and the
+ * buffers are reused from there instead of being freed. record() splits the list into contiguous
+ * partitions and hands back one secondary per partition, in list order, ready for
+ * vkCmdExecuteCommands inside the render pass they continue.
+ *
+ * A "frame" is any set of pools whose buffers retire together. The secondaries stay valid until
+ * their set is next reset, so a primary keeping its own set can be submitted again without
+ * re-recording them.
+ */
+class CommandRecorder {
+public:
+    // Records items [first, first + count) into command_buffer, called concurrently for disjoint ranges
+    typedef std::function<void(VkCommandBuffer command_buffer, uint32_t first, uint32_t count)> RecordFn;
+
+    bool init(VkDevice device, uint32_t queue_family, uint32_t frame_count, Core::ThreadPool& pool);
+    void destroy();
+
+    void beginFrame(uint32_t frame);
+
+    // Appends the secondaries to command_buffers, the pool is busy until every partition is recorded
+    bool record(const VkCommandBufferInheritanceInfo& inheritance, uint32_t item_count, const RecordFn& fn,
+        std::vector<VkCommandBuffer>& command_buffers);
+
+    uint32_t workerCount() const { return worker_count; }
+
+private:
+    struct WorkerPool {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> command_buffers;   // grows to the most any frame needed
+        uint32_t used = 0;                              // handed out since the last reset
+    };
+
+    VkCommandBuffer acquire(WorkerPool& worker);
+
+    VkDevice device = VK_NULL_HANDLE;
+    Core::ThreadPool* thread_pool = nullptr;
+    uint32_t worker_count = 0;
+    uint32_t frame_count = 0;
+    uint32_t frame = 0;
+
+    // frame_count * worker_count, indexed frame * worker_count + worker
+    std::vector<WorkerPool> pools;
+};
+
+}
@@ -0,0 +1,249 @@
+#include "Defragmenter.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace VK {
+
+static void print_fragmentation(const char* label, const FragmentationStats& stats) {
+	printf("  %s: %u blocks (%.1f MiB), %.1f MiB free, largest free range %.1f MiB, fragmentation %.0f%%\n", label,
+		stats.block_count, stats.block_bytes / (1024.0 * 1024.0), stats.free_bytes / (1024.0 * 1024.0),
+		stats.largest_free / (1024.0 * 1024.0), stats.fragmentation * 100.0f);
+}
+
+void Defragmenter::init(VkDevice device, VkAllocator* allocator, DeletionQueue* deletion_queue, ResourceTable* resources,
+		PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2) {
+	this->device = device;
+	this->allocator = allocator;
+	this->deletion_queue = deletion_queue;
+	this->resources = resources;
+	barriers.init(cmd_pipeline_barrier2);
+}
+
+void Defragmenter::track(ResourceHandle handle, VkBufferUsageFlags usage) {
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back(Entry{handle, usage});
+}
+
+void Defragmenter::untrack(ResourceHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].handle == handle) {
+			entries[i] = entries.back();
+			entries.pop_back();
+			return;
+		}
+	}
+}
+
+bool Defragmenter::begin_pass(uint64_t frame) {
+	std::vector<BlockInfo> blocks = allocator->blocks();
+
+	// A block can only be emptied when everything in it can be moved
+	std::unordered_map<MemoryBlock*, VkDeviceSize> movable;
+	for (const Entry& entry : entries) {
+		// Released without being untracked, get() only catches those in validating builds
+		if (!resources->isValid(entry.handle)) {
+			continue;
+		}
+		DeviceResource* resource = resources->get(entry.handle);
+		if (resource->allocation.block) {
+			movable[resource->allocation.block] += resource->allocation.size;
+		}
+	}
+
+	// Per pool, sparsest first
+	std::sort(blocks.begin(), blocks.end(), [](const BlockInfo& a, const BlockInfo& b) {
+		if (a.memory_type != b.memory_type) {
+			return a.memory_type < b.memory_type;
+		}
+		if (a.optimal_tiling != b.optimal_tiling) {
+			return a.optimal_tiling < b.optimal_tiling;
+		}
+		return a.used < b.used;
+	});
+
+	FragmentationStats before = allocator->fragmentation();
+	uint32_t sources = 0;
+
+	for (size_t first = 0; first < blocks.size();) {
+		size_t last = first;
+		VkDeviceSize free_bytes = 0;
+		while (last < blocks.size() && blocks[last].memory_type == blocks[first].memory_type
+			&& blocks[last].optimal_tiling == blocks[first].optimal_tiling) {
+			free_bytes += blocks[last].size - blocks[last].used;
+			last++;
+		}
+
+		// At least one block of the pool stays to receive the moves
+		size_t selected = 0;
+		for (size_t i = first; i < last && selected + 1 < last - first; i++) {
+			const BlockInfo& block = blocks[i];
+			if (block.used == 0) {
+				continue;
+			}
+			if (block.used > block.size * DEFRAG_MAX_OCCUPANCY) {
+				break;
+			}
+			if (movable[block.block] != block.used) {
+				continue;
+			}
+
+			// Its contents have to fit in the free space of the blocks staying
+			VkDeviceSize free_elsewhere = free_bytes - (block.size - block.used);
+			if (block.used > free_elsewhere) {
+				break;
+			}
+			free_bytes = free_elsewhere - block.used;
+
+			allocator->setDraining(block.block, true);
+			selected++;
+		}
+
+		sources += (uint32_t) selected;
+		first = last;
+	}
+
+	if (sources == 0) {
+		return false;
+	}
+
+	pass = DefragmentationPass{};
+	pass.before = before;
+	pass.source_blocks = sources;
+	pass.first_frame = frame;
+	pass.last_frame = frame;
+	return true;
+}
+
+void Defragmenter::stop_draining() {
+	// Blocks that could not be emptied go back to normal use
+	for (const BlockInfo& block : allocator->blocks()) {
+		if (block.draining) {
+			allocator->setDraining(block.block, false);
+		}
+	}
+}
+
+void Defragmenter::end_pass() {
+	stop_draining();
+
+	active = false;
+	pass.after = allocator->fragmentation();
+
+	printf("Defragmentation released %u of %u blocks: %u buffers (%.1f MiB) moved over %llu frames\n",
+		pass.before.block_count > pass.after.block_count ? pass.before.block_count - pass.after.block_count : 0,
+		pass.source_blocks, pass.moved, pass.moved_bytes / (1024.0 * 1024.0),
+		(unsigned long long) (pass.last_frame - pass.first_frame + 1));
+	print_fragmentation("before", pass.before);
+	print_fragmentation("after", pass.after);
+}
+
+bool Defragmenter::move(DeviceResource& resource, VkBufferUsageFlags usage, VkCommandBuffer command_buffer, uint64_t frame) {
+	VkBufferCreateInfo buffer_info = VkTypeWrapper<VkBufferCreateInfo>{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = resource.size;
+	buffer_info.usage = usage;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(device, &buffer_info, host_allocation_callbacks(), &buffer) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create buffer to defragment into\n");
+		return false;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+	// Same memory type, draining blocks are skipped by the allocator
+	MemoryAllocation allocation;
+	if (!allocator->allocate(requirements, resource.allocation.memory_type, false, allocation)) {
+		vkDestroyBuffer(device, buffer, host_allocation_callbacks());
+		return false;
+	}
+	vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+
+	VkBufferCopy region = VkTypeWrapper<VkBufferCopy>{};
+	region.size = resource.size;
+	vkCmdCopyBuffer(command_buffer, resource.buffer, buffer, 1, &region);
+
+	// The draws after record() read it as whatever it was created for
+	barriers.setBufferState(buffer, access_state(ResourceAccess::TransferDst));
+	barriers.useBufferReads(buffer, usage);
+
+	// Earlier frames may still read the old buffer, this one copies out of it
+	VkBuffer old_buffer = resource.buffer;
+	MemoryAllocation old_allocation = resource.allocation;
+	VkDevice device = this->device;
+	VkAllocator* allocator = this->allocator;
+	deletion_queue->push(frame, [device, allocator, old_buffer, old_allocation]() mutable {
+		vkDestroyBuffer(device, old_buffer, host_allocation_callbacks());
+		allocator->free(old_allocation);
+	});
+
+	resource.buffer = buffer;
+	resource.allocation = allocation;
+
+	pass.moved++;
+	pass.moved_bytes += resource.size;
+	return true;
+}
+
+VkDeviceSize Defragmenter::record(VkCommandBuffer command_buffer, uint64_t frame, uint64_t completed_frame) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!active) {
+		if (frame < next_check) {
+			return 0;
+		}
+		next_check = frame + DEFRAG_CHECK_INTERVAL;
+
+		active = begin_pass(frame);
+		if (!active) {
+			return 0;
+		}
+	}
+
+	VkDeviceSize moved = 0;
+	bool remaining = false;
+
+	for (Entry& entry : entries) {
+		if (!resources->isValid(entry.handle)) {
+			continue;
+		}
+		DeviceResource* resource = resources->get(entry.handle);
+		if (!allocator->isDraining(resource->allocation)) {
+			continue;
+		}
+
+		if (moved > 0 && moved + resource->size > frame_budget) {
+			remaining = true;
+			break;
+		}
+
+		if (!move(*resource, entry.usage, command_buffer, frame)) {
+			// Out of memory elsewhere, what was moved so far stays moved
+			stop_draining();
+			remaining = false;
+			break;
+		}
+		moved += resource->size;
+	}
+
+	if (moved > 0) {
+		// One barrier after every copy, the recorder starts from scratch next frame
+		barriers.flush(command_buffer);
+		barriers.clear();
+
+		pass.last_frame = frame;
+	}
+
+	// The stats are taken once the old buffers are gone and the emptied blocks released
+	if (!remaining && completed_frame >= pass.last_frame) {
+		end_pass();
+	}
+
+	return moved;
+}
+
+}
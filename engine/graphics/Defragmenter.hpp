@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "VkCommon.hpp"
+#include "DeletionQueue.hpp"
+#include "ResourceTable.hpp"
+#include "BarrierRecorder.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Defragmenter  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Bytes copied per frame, a single bigger buffer still moves on its own
+#define DEFRAG_FRAME_BUDGET (8ull * 1024 * 1024)
+// Blocks at most this full are candidates for emptying
+#define DEFRAG_MAX_OCCUPANCY 0.5f
+// Frames between two looks for sparse blocks while no pass is running
+#define DEFRAG_CHECK_INTERVAL 64
+
+struct DefragmentationPass {
+    FragmentationStats before;
+    FragmentationStats after;
+    uint32_t source_blocks = 0;     // blocks picked for emptying
+    uint32_t moved = 0;             // buffers moved
+    VkDeviceSize moved_bytes = 0;
+    uint64_t first_frame = 0;
+    uint64_t last_frame = 0;
+};
+
+/*
+ * Incremental compaction of the allocator's blocks.
+ *
+ * Every so often the sparsest blocks of each pool are marked as draining, as long as the other
+ * blocks of the pool have room for their contents and every range in them belongs to a tracked
+ * buffer. Frame after frame, a budget's worth of the buffers still in draining blocks get a new
+ * buffer elsewhere; the copy is recorded ahead of the frame's draws, the record behind the handle is
+ * pointed at the new buffer and the old one goes through the deletion queue. An emptied block is
+ * released by the allocator as soon as its last range is freed.
+ *
+ * Only buffers looked up through their handle whenever used are tracked: the VkBuffer and memory
+ * change under the caller, so neither may be cached anywhere else (descriptor sets, mapped
+ * pointers).
+ */
+class Defragmenter {
+public:
+    // cmd_pipeline_barrier2 null without synchronization2, see BarrierRecorder
+    void init(VkDevice device, VkAllocator* allocator, DeletionQueue* deletion_queue, ResourceTable* resources,
+        PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2);
+
+    // usage is the one the buffer was created with, TRANSFER_SRC and TRANSFER_DST included
+    void track(ResourceHandle handle, VkBufferUsageFlags usage);
+    void untrack(ResourceHandle handle);
+
+    void setFrameBudget(VkDeviceSize budget) { frame_budget = budget; }
+
+    // Records this frame's moves, before any command reading the tracked buffers. completed_frame is
+    // the last frame completed on the GPU. Returns the bytes moved.
+    VkDeviceSize record(VkCommandBuffer command_buffer, uint64_t frame, uint64_t completed_frame);
+
+    bool isActive() const { return active; }
+    const DefragmentationPass& lastPass() const { return pass; }
+
+private:
+    struct Entry {
+        ResourceHandle handle;
+        VkBufferUsageFlags usage;
+    };
+
+    bool begin_pass(uint64_t frame);
+    void stop_draining();
+    void end_pass();
+    bool move(DeviceResource& resource, VkBufferUsageFlags usage, VkCommandBuffer command_buffer, uint64_t frame);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkAllocator* allocator = nullptr;
+    DeletionQueue* deletion_queue = nullptr;
+    ResourceTable* resources = nullptr;
+    VkDeviceSize frame_budget = DEFRAG_FRAME_BUDGET;
+    // Moves of the frame being recorded
+    BarrierRecorder barriers;
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+
+    bool active = false;
+    uint64_t next_check = 0;
+    DefragmentationPass pass;
+};
+
+}
@@ -0,0 +1,46 @@
+#include "DeletionQueue.hpp"
+
+namespace VK {
+
+void DeletionQueue::push(uint64_t frame, Deleter deleter) {
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back(Entry{frame, std::move(deleter)});
+}
+
+uint32_t DeletionQueue::collect(uint64_t completed_frame) {
+	// The deleters run outside the lock, they may release further objects
+	std::deque<Entry> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!entries.empty() && entries.front().frame <= completed_frame) {
+			ready.push_back(std::move(entries.front()));
+			entries.pop_front();
+		}
+	}
+
+	for (Entry& entry : ready) {
+		entry.deleter();
+	}
+
+	return (uint32_t) ready.size();
+}
+
+uint32_t DeletionQueue::flush() {
+	uint32_t count = 0;
+
+	// Deleters pushing new entries get drained too
+	for (;;) {
+		uint32_t ran = collect(UINT64_MAX);
+		if (ran == 0) {
+			return count;
+		}
+		count += ran;
+	}
+}
+
+size_t DeletionQueue::size() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include <stdint.h>
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Deletion queue  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * GPU objects released while frames may still be using them.
+ *
+ * Each entry is tagged with the number of the frame being built when it was released; it is
+ * destroyed by collect() once the graphics timeline has passed the value that frame signalled.
+ * Frames retire in order on the graphics queue, and uploads are flushed ahead of the frame they
+ * belong to, so by then nothing submitted before the release can still reference the object.
+ */
+class DeletionQueue {
+public:
+    typedef std::function<void()> Deleter;
+
+    // Frames are numbered from 1 and pushed in non decreasing order
+    void push(uint64_t frame, Deleter deleter);
+
+    // Runs the deleters of every frame up to completed_frame, returns how many ran
+    uint32_t collect(uint64_t completed_frame);
+
+    // Shutdown, only once the device is idle: runs everything in release order
+    uint32_t flush();
+
+    size_t size();
+
+private:
+    struct Entry {
+        uint64_t frame;
+        Deleter deleter;
+    };
+
+    std::mutex mutex;
+    std::deque<Entry> entries;
+};
+
+}
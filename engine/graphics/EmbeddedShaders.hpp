@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace VK {
+    // SPIR-V compiled and linked into the binary at build time
+    struct EmbeddedShader {
+        const char* name;       // same name as the loose .spv file, e.g. "shaders/shader.vert.1.spv"
+        const uint32_t* code;   // null for keys made unreachable by an @exclusive declaration
+        size_t size;            // in bytes
+    };
+
+    // Every permutation of a shader, indexed by its variant key (one bit per @permutation axis)
+    struct ShaderVariants {
+        const char* name;
+        uint32_t axis_count;
+        const EmbeddedShader* variants;     // 1 << axis_count entries
+    };
+}
+
+// Generated by cmake/ShaderVariants.cmake, defines VK::ShaderId, the <shader>_axes bits and VK::shader_variant_tables[]
+#include "EmbeddedShaderTable.inc"
+
+namespace VK {
+    inline const EmbeddedShader* get_shader_variant(ShaderId id, uint32_t key) {
+        const ShaderVariants& table = shader_variant_tables[(uint32_t) id];
+        if (key >= (1u << table.axis_count) || table.variants[key].code == nullptr) {
+            return nullptr;
+        }
+        return &table.variants[key];
+    }
+
+    inline const EmbeddedShader* find_embedded_shader(const char* name) {
+        for (const ShaderVariants& table : shader_variant_tables) {
+            for (uint32_t key = 0; key < (1u << table.axis_count); key++) {
+                if (table.variants[key].code != nullptr && strcmp(table.variants[key].name, name) == 0) {
+                    return &table.variants[key];
+                }
+            }
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,49 @@
+#include "FrameAllocator.hpp"
+
+namespace VK {
+
+void FrameAllocator::init(const DeviceResource& buffer, uint32_t frame_count, VkDeviceSize region_size, VkDeviceSize uniform_alignment) {
+	this->buffer = buffer.buffer;
+	this->mapped = (char*) buffer.allocation.mapped;
+	this->frame_count = frame_count;
+	this->region_size = region_size;
+	this->uniform_alignment = uniform_alignment > 0 ? uniform_alignment : 1;
+
+	frame = 0;
+	head.store(0, std::memory_order_relaxed);
+	peak = 0;
+}
+
+void FrameAllocator::beginFrame(uint32_t frame) {
+	VkDeviceSize used = head.exchange(0, std::memory_order_relaxed);
+	if (used > peak) {
+		peak = used;
+	}
+
+	this->frame = frame % frame_count;
+}
+
+bool FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, TransientAllocation& allocation) {
+	VkDeviceSize offset = head.load(std::memory_order_relaxed);
+	VkDeviceSize aligned;
+
+	// Alignments are powers of two (Vulkan guarantees it for the device limits)
+	do {
+		aligned = (offset + alignment - 1) & ~(alignment - 1);
+		if (aligned + size > region_size) {
+			fprintf(stderr, "Frame allocator out of space (%llu bytes requested, %llu used of %llu)\n",
+				(unsigned long long) size, (unsigned long long) offset, (unsigned long long) region_size);
+			return false;
+		}
+	} while (!head.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed));
+
+	VkDeviceSize region_offset = (VkDeviceSize) frame * region_size + aligned;
+
+	allocation.data = mapped + region_offset;
+	allocation.buffer = buffer;
+	allocation.offset = region_offset;
+	allocation.size = size;
+	return true;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+
+#include "VkCommon.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Frame allocator  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Bytes of transient data each frame in flight can allocate
+#define FRAME_ALLOCATOR_SIZE (4ull * 1024 * 1024)
+
+// Slice of the current frame's region, valid until the frame completes on the GPU
+struct TransientAllocation {
+    void* data = nullptr;           // CPU pointer, host coherent
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;        // in buffer, a dynamic uniform offset or a vertex / index buffer offset
+    VkDeviceSize size = 0;
+};
+
+/*
+ * Bump allocator for data that only lives for one frame (uniforms, dynamic vertices and indices).
+ *
+ * One persistently mapped host visible buffer is split into a region per frame in flight.
+ * Allocating is an atomic bump of the current region's head, so any thread can allocate while a
+ * frame is being built. beginFrame() rewinds a region once the frame that last used it has
+ * completed on the GPU; nothing is ever freed individually.
+ */
+class FrameAllocator {
+public:
+    // buffer holds frame_count regions of region_size bytes, usable as uniform, vertex and index data
+    void init(const DeviceResource& buffer, uint32_t frame_count, VkDeviceSize region_size, VkDeviceSize uniform_alignment);
+
+    void beginFrame(uint32_t frame);
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, TransientAllocation& allocation);
+
+    // Aligned to minUniformBufferOffsetAlignment, the offset can be passed as a dynamic offset
+    bool allocateUniform(VkDeviceSize size, TransientAllocation& allocation) {
+        return allocate(size, uniform_alignment, allocation);
+    }
+
+    // Most bytes any frame used so far, to size FRAME_ALLOCATOR_SIZE
+    VkDeviceSize peakUsage() const { return peak; }
+
+private:
+    VkBuffer buffer = VK_NULL_HANDLE;
+    char* mapped = nullptr;
+    uint32_t frame_count = 0;
+    VkDeviceSize region_size = 0;
+    VkDeviceSize uniform_alignment = 1;
+
+    uint32_t frame = 0;
+    std::atomic<VkDeviceSize> head{0};     // bytes used in the current region
+    VkDeviceSize peak = 0;
+};
+
+}
@@ -0,0 +1,229 @@
+#include "HostAllocator.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace VK {
+
+// Sits right before every block handed to the driver
+struct AllocationHeader {
+	void* base;             // what malloc or the arena returned
+	size_t size;            // requested by the driver
+	uint32_t scope;
+	uint32_t size_class;    // arena class, HOST_ALLOCATOR_ARENA_CLASS_COUNT for malloc
+};
+
+static const char* ScopeNames[HOST_ALLOCATOR_SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+
+static uint32_t size_class_of(size_t size) {
+	uint32_t size_class = 0;
+	while (((size_t) HOST_ALLOCATOR_ARENA_MIN_SIZE << size_class) < size) {
+		size_class++;
+	}
+	return size_class;
+}
+
+HostAllocator::HostAllocator() {
+	vk_callbacks.pUserData = this;
+	vk_callbacks.pfnAllocation = vk_allocation;
+	vk_callbacks.pfnReallocation = vk_reallocation;
+	vk_callbacks.pfnFree = vk_free;
+	vk_callbacks.pfnInternalAllocation = vk_internal_allocation;
+	vk_callbacks.pfnInternalFree = vk_internal_free;
+}
+
+HostAllocator::~HostAllocator() {
+	for (void* chunk : chunks) {
+		free(chunk);
+	}
+}
+
+void* HostAllocator::arena_take(uint32_t size_class) {
+	ArenaClass& arena_class = arena[size_class];
+	std::lock_guard<std::mutex> lock(arena_class.mutex);
+
+	// An empty class carves a new chunk into slots
+	if (arena_class.free_slots.empty()) {
+		char* chunk = (char*) malloc(HOST_ALLOCATOR_ARENA_CHUNK_SIZE);
+		if (chunk == nullptr) {
+			return nullptr;
+		}
+
+		{
+			std::lock_guard<std::mutex> chunk_lock(chunk_mutex);
+			chunks.push_back(chunk);
+		}
+
+		size_t slot_size = (size_t) HOST_ALLOCATOR_ARENA_MIN_SIZE << size_class;
+		for (size_t offset = 0; offset + slot_size <= HOST_ALLOCATOR_ARENA_CHUNK_SIZE; offset += slot_size) {
+			arena_class.free_slots.push_back(chunk + offset);
+		}
+	}
+
+	void* slot = arena_class.free_slots.back();
+	arena_class.free_slots.pop_back();
+	return slot;
+}
+
+void HostAllocator::arena_give(uint32_t size_class, void* slot) {
+	ArenaClass& arena_class = arena[size_class];
+	std::lock_guard<std::mutex> lock(arena_class.mutex);
+	arena_class.free_slots.push_back(slot);
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	if (size == 0) {
+		return nullptr;
+	}
+
+	// Room for the header and for aligning past it, alignments are powers of two
+	if (alignment < alignof(AllocationHeader)) {
+		alignment = alignof(AllocationHeader);
+	}
+	size_t total = size + alignment - 1 + sizeof(AllocationHeader);
+
+	uint32_t size_class = HOST_ALLOCATOR_ARENA_CLASS_COUNT;
+	void* base = nullptr;
+
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT && total <= HOST_ALLOCATOR_ARENA_MAX_SIZE && use_arena.load(std::memory_order_relaxed)) {
+		size_class = size_class_of(total);
+		base = arena_take(size_class);
+	}
+
+	if (base == nullptr) {
+		size_class = HOST_ALLOCATOR_ARENA_CLASS_COUNT;
+		base = malloc(total);
+		if (base == nullptr) {
+			return nullptr;
+		}
+	}
+
+	uintptr_t user = ((uintptr_t) base + sizeof(AllocationHeader) + alignment - 1) & ~(uintptr_t) (alignment - 1);
+	AllocationHeader* header = (AllocationHeader*) user - 1;
+	header->base = base;
+	header->size = size;
+	header->scope = (uint32_t) scope;
+	header->size_class = size_class;
+
+	ScopeCounters& counters = scopes[scope];
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.live_count.fetch_add(1, std::memory_order_relaxed);
+	if (size_class != HOST_ALLOCATOR_ARENA_CLASS_COUNT) {
+		counters.arena_allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+	while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return (void*) user;
+}
+
+void HostAllocator::release(void* memory) {
+	if (memory == nullptr) {
+		return;
+	}
+
+	AllocationHeader* header = (AllocationHeader*) memory - 1;
+
+	ScopeCounters& counters = scopes[header->scope];
+	counters.frees.fetch_add(1, std::memory_order_relaxed);
+	counters.live_count.fetch_sub(1, std::memory_order_relaxed);
+	counters.live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+	if (header->size_class != HOST_ALLOCATOR_ARENA_CLASS_COUNT) {
+		arena_give(header->size_class, header->base);
+	} else {
+		free(header->base);
+	}
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	if (original == nullptr) {
+		return allocate(size, alignment, scope);
+	}
+	if (size == 0) {
+		release(original);
+		return nullptr;
+	}
+
+	// On failure the original must stay untouched
+	void* memory = allocate(size, alignment, scope);
+	if (memory == nullptr) {
+		return nullptr;
+	}
+
+	AllocationHeader* header = (AllocationHeader*) original - 1;
+	memcpy(memory, original, header->size < size ? header->size : size);
+	release(original);
+	return memory;
+}
+
+void* VKAPI_PTR HostAllocator::vk_allocation(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	return ((HostAllocator*) user_data)->allocate(size, alignment, scope);
+}
+
+void* VKAPI_PTR HostAllocator::vk_reallocation(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	return ((HostAllocator*) user_data)->reallocate(original, size, alignment, scope);
+}
+
+void VKAPI_PTR HostAllocator::vk_free(void* user_data, void* memory) {
+	((HostAllocator*) user_data)->release(memory);
+}
+
+void VKAPI_PTR HostAllocator::vk_internal_allocation(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+	((HostAllocator*) user_data)->scopes[scope].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_PTR HostAllocator::vk_internal_free(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+	((HostAllocator*) user_data)->scopes[scope].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+HostAllocationStats HostAllocator::stats(VkSystemAllocationScope scope) const {
+	const ScopeCounters& counters = scopes[scope];
+
+	HostAllocationStats stats;
+	stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+	stats.frees = counters.frees.load(std::memory_order_relaxed);
+	stats.arena_allocations = counters.arena_allocations.load(std::memory_order_relaxed);
+	stats.live_count = counters.live_count.load(std::memory_order_relaxed);
+	stats.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+	stats.peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed);
+	stats.internal_bytes = counters.internal_bytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+HostAllocationStats HostAllocator::total() const {
+	// The peak is the sum of the per scope peaks, an upper bound
+	HostAllocationStats total;
+	for (uint32_t scope = 0; scope < HOST_ALLOCATOR_SCOPE_COUNT; scope++) {
+		HostAllocationStats current = stats((VkSystemAllocationScope) scope);
+		total.allocations += current.allocations;
+		total.frees += current.frees;
+		total.arena_allocations += current.arena_allocations;
+		total.live_count += current.live_count;
+		total.live_bytes += current.live_bytes;
+		total.peak_bytes += current.peak_bytes;
+		total.internal_bytes += current.internal_bytes;
+	}
+	return total;
+}
+
+void HostAllocator::printStats() {
+	printf(" Driver host memory:\n");
+	for (uint32_t scope = 0; scope < HOST_ALLOCATOR_SCOPE_COUNT; scope++) {
+		HostAllocationStats current = stats((VkSystemAllocationScope) scope);
+		if (current.allocations == 0 && current.internal_bytes == 0) {
+			continue;
+		}
+
+		printf("  %-8s %8llu allocations (%llu from the arena), %llu live (%.1f KiB), peak %.1f KiB, internal %.1f KiB\n",
+			ScopeNames[scope], (unsigned long long) current.allocations, (unsigned long long) current.arena_allocations,
+			(unsigned long long) current.live_count, current.live_bytes / 1024.0, current.peak_bytes / 1024.0,
+			current.internal_bytes / 1024.0);
+	}
+}
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+	#include <vulkan/vulkan.h>
+	#include <stdio.h>
+	#include <stdbool.h>
+	#include <stdint.h>
+}
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Host allocator  ////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND to VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE
+#define HOST_ALLOCATOR_SCOPE_COUNT 5
+
+// Object scope allocations up to this size come from the arena when it is enabled
+#define HOST_ALLOCATOR_ARENA_MAX_SIZE 4096
+// Smallest arena slot, the size classes are its power of two multiples
+#define HOST_ALLOCATOR_ARENA_MIN_SIZE 64
+// Memory the arena grabs from malloc at once
+#define HOST_ALLOCATOR_ARENA_CHUNK_SIZE (64 * 1024)
+#define HOST_ALLOCATOR_ARENA_CLASS_COUNT 7
+
+struct HostAllocationStats {
+    uint64_t allocations = 0;       // pfnAllocation and pfnReallocation calls
+    uint64_t frees = 0;
+    uint64_t arena_allocations = 0; // of allocations, served from the arena
+    uint64_t live_count = 0;
+    uint64_t live_bytes = 0;        // as requested by the driver
+    uint64_t peak_bytes = 0;
+    uint64_t internal_bytes = 0;    // driver's own allocations it told us about (executable memory)
+};
+
+/*
+ * VkAllocationCallbacks that keep count of what the driver and loader allocate on the host.
+ *
+ * Allocations, frees and bytes are tracked per VkSystemAllocationScope. Each block carries a small
+ * header with its size and origin, so realloc and free never have to search. Object scope
+ * allocations, the ones drivers make when creating and destroying objects, can be served from a
+ * size class arena with a free list per class; the arena never returns memory before shutdown.
+ *
+ * Every vkCreate / vkAllocate call and its matching vkDestroy / vkFree pass callbacks() so the
+ * pairs stay compatible. All entry points are thread safe.
+ */
+class HostAllocator {
+public:
+    static HostAllocator& shared() {
+        static HostAllocator allocator;
+        return allocator;
+    }
+
+    ~HostAllocator();
+
+    HostAllocator(const HostAllocator&) = delete;
+    void operator=(const HostAllocator&) = delete;
+
+    const VkAllocationCallbacks* callbacks() const { return &vk_callbacks; }
+
+    // Can change at any time, blocks remember where they came from
+    void setObjectArena(bool enabled) { use_arena.store(enabled, std::memory_order_relaxed); }
+
+    HostAllocationStats stats(VkSystemAllocationScope scope) const;
+    HostAllocationStats total() const;
+    // Cheap running count of pfnAllocation and pfnReallocation calls, to diff across a frame
+    uint64_t allocationCount() const { return allocation_count.load(std::memory_order_relaxed); }
+
+    void printStats();
+
+private:
+    HostAllocator();
+
+    struct ScopeCounters {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<uint64_t> arena_allocations{0};
+        std::atomic<uint64_t> live_count{0};
+        std::atomic<uint64_t> live_bytes{0};
+        std::atomic<uint64_t> peak_bytes{0};
+        std::atomic<uint64_t> internal_bytes{0};
+    };
+
+    struct ArenaClass {
+        std::mutex mutex;
+        std::vector<void*> free_slots;
+    };
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void release(void* memory);
+
+    void* arena_take(uint32_t size_class);
+    void arena_give(uint32_t size_class, void* slot);
+
+    static void* VKAPI_PTR vk_allocation(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void* VKAPI_PTR vk_reallocation(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void VKAPI_PTR vk_free(void* user_data, void* memory);
+    static void VKAPI_PTR vk_internal_allocation(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static void VKAPI_PTR vk_internal_free(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    VkAllocationCallbacks vk_callbacks;
+    std::atomic<bool> use_arena{true};
+    std::atomic<uint64_t> allocation_count{0};
+
+    ScopeCounters scopes[HOST_ALLOCATOR_SCOPE_COUNT];
+
+    ArenaClass arena[HOST_ALLOCATOR_ARENA_CLASS_COUNT];
+    std::mutex chunk_mutex;
+    std::vector<void*> chunks;
+};
+
+// Shorthand for the shared allocator's callbacks
+inline const VkAllocationCallbacks* host_allocation_callbacks() {
+    return HostAllocator::shared().callbacks();
+}
+
+}
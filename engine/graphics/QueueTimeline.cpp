@@ -0,0 +1,80 @@
+#include "QueueTimeline.hpp"
+
+namespace VK {
+
+bool QueueTimeline::init(VkDevice device, VkQueue queue) {
+	this->device = device;
+	this->submit_queue = queue;
+	submitted = 0;
+	reached.store(0, std::memory_order_relaxed);
+
+	VkSemaphoreTypeCreateInfo type_info = VkTypeWrapper<VkSemaphoreTypeCreateInfo>{};
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_info = VkTypeWrapper<VkSemaphoreCreateInfo>{};
+	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphore_info.pNext = &type_info;
+
+	if (vkCreateSemaphore(device, &semaphore_info, host_allocation_callbacks(), &timeline) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create timeline semaphore!\n");
+		return false;
+	}
+
+	return true;
+}
+
+void QueueTimeline::destroy() {
+	if (timeline != VK_NULL_HANDLE) {
+		vkDestroySemaphore(device, timeline, host_allocation_callbacks());
+		timeline = VK_NULL_HANDLE;
+	}
+}
+
+uint64_t QueueTimeline::completed() {
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(device, timeline, &value) != VK_SUCCESS) {
+		fprintf(stderr, "failed to query timeline semaphore!\n");
+		exit(1);
+	}
+
+	// Several threads may refresh it at once, keep the highest
+	uint64_t cached = reached.load(std::memory_order_relaxed);
+	while (cached < value && !reached.compare_exchange_weak(cached, value, std::memory_order_relaxed)) {
+	}
+
+	return value > cached ? value : cached;
+}
+
+bool QueueTimeline::isComplete(uint64_t value) {
+	// Most checks are for values reached long ago, no driver call for those
+	if (value <= reached.load(std::memory_order_relaxed)) {
+		return true;
+	}
+
+	return value <= completed();
+}
+
+void QueueTimeline::wait(uint64_t value) {
+	if (isComplete(value)) {
+		return;
+	}
+
+	VkSemaphoreWaitInfo wait_info = VkTypeWrapper<VkSemaphoreWaitInfo>{};
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &timeline;
+	wait_info.pValues = &value;
+
+	if (vkWaitSemaphores(device, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+		fprintf(stderr, "failed to wait on timeline semaphore!\n");
+		exit(1);
+	}
+
+	uint64_t cached = reached.load(std::memory_order_relaxed);
+	while (cached < value && !reached.compare_exchange_weak(cached, value, std::memory_order_relaxed)) {
+	}
+}
+
+}
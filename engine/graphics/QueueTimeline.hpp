@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+#include "VkCommon.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Queue timeline  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Monotonic GPU timeline of one queue, backed by a timeline semaphore (core in Vulkan 1.2).
+ *
+ * Every submission to the queue that something waits on signals the next value of its timeline.
+ * A signal covers every command submitted to the queue before it, so reaching a value means all
+ * earlier work on the queue is done: a single counter replaces one fence per frame slot or upload
+ * batch, nothing is ever reset, and other queues wait on it on the GPU through the same semaphore.
+ *
+ * Values have to be signalled in the order next() hands them out, next() and the submission
+ * happen together on the thread submitting to the queue. The completion queries are thread safe.
+ */
+class QueueTimeline {
+public:
+    bool init(VkDevice device, VkQueue queue);
+    void destroy();
+
+    // Value the submission about to be made signals
+    uint64_t next() { return ++submitted; }
+
+    uint64_t lastSubmitted() const { return submitted; }
+
+    // Last value the GPU reached, queried from the semaphore
+    uint64_t completed();
+    bool isComplete(uint64_t value);
+    void wait(uint64_t value);
+
+    VkSemaphore semaphore() const { return timeline; }
+    VkQueue queue() const { return submit_queue; }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue submit_queue = VK_NULL_HANDLE;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+
+    uint64_t submitted = 0;
+    std::atomic<uint64_t> reached{0};     // cached, only ever grows
+};
+
+}
@@ -0,0 +1,882 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+
+namespace VK {
+
+// Stages a queue without graphics support accepts
+#define COMPUTE_QUEUE_STAGES (VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT \
+	| VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT \
+	| VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+#define TRANSFER_QUEUE_STAGES (VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT \
+	| VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+
+static VkPipelineStageFlags2 queue_stage_mask(RenderQueue queue) {
+	switch (queue) {
+	case RenderQueue::Compute:
+		return COMPUTE_QUEUE_STAGES;
+	case RenderQueue::Transfer:
+		return TRANSFER_QUEUE_STAGES;
+	default:
+		return ~(VkPipelineStageFlags2) 0;
+	}
+}
+
+static bool lifetimes_overlap(uint32_t first_a, uint32_t last_a, uint32_t first_b, uint32_t last_b) {
+	return first_a <= last_b && first_b <= last_a;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////  Pass builder  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+RenderPassBuilder& RenderPassBuilder::read(RenderResource resource, ResourceAccess access) {
+	graph.passes[pass].uses.push_back({resource, access, false});
+	return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::write(RenderResource resource, ResourceAccess access) {
+	graph.passes[pass].uses.push_back({resource, access, true});
+	return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::sideEffect() {
+	graph.passes[pass].side_effect = true;
+	return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::execute(RenderPassFn fn) {
+	graph.passes[pass].fn = std::move(fn);
+	return *this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////  Render graph  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+bool RenderGraph::TransientKey::operator==(const TransientKey& other) const {
+	if (is_image != other.is_image || first_use != other.first_use || last_use != other.last_use || queue_mask != other.queue_mask) {
+		return false;
+	}
+
+	if (is_image) {
+		return image_desc.format == other.image_desc.format && image_desc.extent.width == other.image_desc.extent.width
+			&& image_desc.extent.height == other.image_desc.extent.height && image_desc.usage == other.image_desc.usage
+			&& image_desc.aspect == other.image_desc.aspect;
+	}
+
+	return buffer_desc.size == other.buffer_desc.size && buffer_desc.usage == other.buffer_desc.usage;
+}
+
+bool RenderGraph::init(VkPhysicalDevice physical_device, VkDevice device, VkAllocator* allocator, DeletionQueue* deletion_queue,
+		PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2) {
+	this->physical_device = physical_device;
+	this->device = device;
+	this->allocator = allocator;
+	this->deletion_queue = deletion_queue;
+	barriers.init(cmd_pipeline_barrier2);
+	return true;
+}
+
+void RenderGraph::destroy() {
+	// Only once the device is idle, nothing goes through the deletion queue
+	release_transients(transients, UINT64_MAX);
+	reset();
+	runs.clear();
+	order.clear();
+	barriers.clear();
+
+	for (QueueSlot& slot : queues) {
+		for (VkCommandPool pool : slot.pools) {
+			vkDestroyCommandPool(device, pool, host_allocation_callbacks());
+		}
+		slot = QueueSlot{};
+	}
+}
+
+bool RenderGraph::setQueues(QueueTimeline* const timelines[(uint32_t) RenderQueue::Count], const uint32_t families[(uint32_t) RenderQueue::Count],
+		uint32_t frame_count) {
+	this->frame_count = frame_count;
+	submit_index = 0;
+
+	VkCommandPoolCreateInfo pool_info = VkTypeWrapper<VkCommandPoolCreateInfo>{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	// Reset as a whole once the frame that used it is done
+	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	for (uint32_t q = 0; q < (uint32_t) RenderQueue::Count; q++) {
+		QueueSlot& slot = queues[q];
+		slot.timeline = timelines[q];
+		slot.family = families[q];
+		last_values[q] = 0;
+
+		if (slot.timeline == nullptr) {
+			continue;
+		}
+
+		pool_info.queueFamilyIndex = slot.family;
+		slot.pools.resize(frame_count, VK_NULL_HANDLE);
+		slot.command_buffers.resize(frame_count);
+		slot.values.assign(frame_count, 0);
+
+		for (VkCommandPool& pool : slot.pools) {
+			if (vkCreateCommandPool(device, &pool_info, host_allocation_callbacks(), &pool) != VK_SUCCESS) {
+				fprintf(stderr, "failed to create render graph command pool!\n");
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void RenderGraph::reset() {
+	passes.clear();
+	resources.clear();
+}
+
+RenderResource RenderGraph::importImage(const char* name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+		const ResourceState& initial, const ResourceState& final) {
+	Resource resource;
+	resource.name = name;
+	resource.is_image = true;
+	resource.imported = true;
+	resource.image = image;
+	resource.view = view;
+	resource.aspect = aspect;
+	resource.initial = initial;
+	resource.final = final;
+	resource.has_final = true;
+
+	resources.push_back(resource);
+	return (RenderResource) resources.size() - 1;
+}
+
+RenderResource RenderGraph::importBuffer(const char* name, VkBuffer buffer, const ResourceState& initial) {
+	Resource resource;
+	resource.name = name;
+	resource.imported = true;
+	resource.buffer = buffer;
+	resource.initial = initial;
+
+	resources.push_back(resource);
+	return (RenderResource) resources.size() - 1;
+}
+
+RenderResource RenderGraph::createImage(const char* name, const RenderImageDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.is_image = true;
+	resource.image_desc = desc;
+	resource.aspect = desc.aspect;
+
+	resources.push_back(resource);
+	return (RenderResource) resources.size() - 1;
+}
+
+RenderResource RenderGraph::createBuffer(const char* name, const RenderBufferDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.buffer_desc = desc;
+
+	resources.push_back(resource);
+	return (RenderResource) resources.size() - 1;
+}
+
+RenderPassBuilder RenderGraph::addPass(const char* name, RenderQueue queue) {
+	Pass pass;
+	pass.name = name;
+	pass.queue = queue;
+	passes.push_back(std::move(pass));
+
+	return RenderPassBuilder(*this, (uint32_t) passes.size() - 1);
+}
+
+VkImage RenderGraph::image(RenderResource resource) const {
+	return resources[resource].image;
+}
+
+VkImageView RenderGraph::view(RenderResource resource) const {
+	return resources[resource].view;
+}
+
+VkBuffer RenderGraph::buffer(RenderResource resource) const {
+	return resources[resource].buffer;
+}
+
+const BarrierBatch* RenderGraph::passBarriers(uint32_t pass) const {
+	for (const Run& run : runs) {
+		for (size_t i = 0; i < run.passes.size(); i++) {
+			if (run.passes[i] == pass) {
+				return &run.barriers[i];
+			}
+		}
+	}
+	return nullptr;
+}
+
+bool RenderGraph::transientPlacement(RenderResource resource, uint32_t& heap, VkDeviceSize& offset, VkDeviceSize& size) const {
+	uint32_t transient = resources[resource].transient;
+	if (transient == UINT32_MAX) {
+		return false;
+	}
+
+	const TransientObject& object = transients.objects[transient];
+	heap = object.heap;
+	offset = object.offset;
+	size = object.requirements.size;
+	return true;
+}
+
+RenderQueue RenderGraph::resolve_queue(RenderQueue queue) const {
+	QueueTimeline* timeline = queues[(uint32_t) queue].timeline;
+	if (queue == RenderQueue::Graphics || timeline == nullptr) {
+		return RenderQueue::Graphics;
+	}
+
+	// Queues sharing a timeline submit to the same VkQueue: one queue, no handoff and no semaphore between them
+	for (uint32_t q = 0; q < (uint32_t) queue; q++) {
+		if (queues[q].timeline == timeline) {
+			return (RenderQueue) q;
+		}
+	}
+	return queue;
+}
+
+void RenderGraph::cull() {
+	/*
+	 * Walked backwards: a pass is needed when it has side effects, writes an imported resource, or
+	 * writes a resource some needed pass after it reads. Its own reads are then needed in turn
+	 */
+	std::vector<bool> needed(resources.size(), false);
+	culled_count = 0;
+
+	for (uint32_t p = (uint32_t) passes.size(); p-- > 0;) {
+		Pass& pass = passes[p];
+		pass.alive = pass.side_effect;
+
+		for (const Use& use : pass.uses) {
+			if (use.write && (resources[use.resource].imported || needed[use.resource])) {
+				pass.alive = true;
+			}
+		}
+
+		if (!pass.alive) {
+			culled_count++;
+			continue;
+		}
+
+		for (const Use& use : pass.uses) {
+			if (!use.write) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	order.clear();
+	for (uint32_t p = 0; p < (uint32_t) passes.size(); p++) {
+		if (passes[p].alive) {
+			order.push_back(p);
+		}
+	}
+}
+
+bool RenderGraph::compile(uint64_t frame) {
+	cull();
+
+	// ----- Lifetimes, usage and last use of every resource over the kept passes -----
+	for (Resource& resource : resources) {
+		resource.transient = UINT32_MAX;
+		resource.first_use = UINT32_MAX;
+		resource.last_use = 0;
+		resource.queue_mask = 0;
+		resource.last_stages = 0;
+		resource.last_access = 0;
+	}
+
+	for (uint32_t k = 0; k < (uint32_t) order.size(); k++) {
+		const Pass& pass = passes[order[k]];
+		RenderQueue queue = resolve_queue(pass.queue);
+
+		for (const Use& use : pass.uses) {
+			Resource& resource = resources[use.resource];
+			const AccessInfo& info = access_info(use.access);
+
+			// Several uses by the last pass all count
+			if (resource.first_use == UINT32_MAX || resource.last_use != k) {
+				resource.last_stages = 0;
+				resource.last_access = 0;
+			}
+			if (resource.first_use == UINT32_MAX) {
+				resource.first_use = k;
+			}
+			resource.last_use = k;
+			resource.queue_mask |= 1u << (uint32_t) queue;
+
+			if (resource.is_image) {
+				resource.image_desc.usage |= info.image_usage;
+			} else {
+				resource.buffer_desc.usage |= info.buffer_usage;
+			}
+
+			resource.last_stages |= info.stages & queue_stage_mask(queue);
+			resource.last_access |= info.access;
+		}
+	}
+
+	// ----- Transients, reused from the previous compilation when they are declared alike -----
+	TransientSet set;
+	for (Resource& resource : resources) {
+		if (resource.imported || resource.first_use == UINT32_MAX) {
+			continue;
+		}
+
+		TransientKey key;
+		key.is_image = resource.is_image;
+		key.image_desc = resource.image_desc;
+		key.buffer_desc = resource.buffer_desc;
+		key.first_use = resource.first_use;
+		key.last_use = resource.last_use;
+		key.queue_mask = resource.queue_mask;
+
+		resource.transient = (uint32_t) set.keys.size();
+		set.keys.push_back(key);
+	}
+
+	if (set.keys != transients.keys) {
+		release_transients(transients, frame);
+		if (!create_transients(set)) {
+			release_transients(set, UINT64_MAX);
+			return false;
+		}
+		transients = std::move(set);
+		transient_generation++;
+	}
+
+	for (Resource& resource : resources) {
+		if (resource.transient == UINT32_MAX) {
+			continue;
+		}
+
+		const TransientObject& object = transients.objects[resource.transient];
+		resource.image = object.image;
+		resource.view = object.view;
+		resource.buffer = object.buffer;
+	}
+
+	return build_runs();
+}
+
+bool RenderGraph::create_transients(TransientSet& set) {
+	set.objects.assign(set.keys.size(), TransientObject{});
+
+	for (uint32_t t = 0; t < (uint32_t) set.keys.size(); t++) {
+		const TransientKey& key = set.keys[t];
+		TransientObject& object = set.objects[t];
+
+		// Concurrent when queues of different families use it, no ownership transfers to record
+		std::vector<uint32_t> families;
+		for (uint32_t q = 0; q < (uint32_t) RenderQueue::Count; q++) {
+			if ((key.queue_mask & (1u << q)) && std::find(families.begin(), families.end(), queues[q].family) == families.end()) {
+				families.push_back(queues[q].family);
+			}
+		}
+		bool concurrent = families.size() > 1;
+
+		if (key.is_image) {
+			VkImageCreateInfo image_info = VkTypeWrapper<VkImageCreateInfo>{};
+			image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_info.imageType = VK_IMAGE_TYPE_2D;
+			image_info.format = key.image_desc.format;
+			image_info.extent.width = key.image_desc.extent.width;
+			image_info.extent.height = key.image_desc.extent.height;
+			image_info.extent.depth = 1;
+			image_info.mipLevels = 1;
+			image_info.arrayLayers = 1;
+			image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+			image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			image_info.usage = key.image_desc.usage;
+			image_info.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+			image_info.queueFamilyIndexCount = concurrent ? (uint32_t) families.size() : 0;
+			image_info.pQueueFamilyIndices = concurrent ? families.data() : NULL;
+			image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(device, &image_info, host_allocation_callbacks(), &object.image) != VK_SUCCESS) {
+				fprintf(stderr, "failed to create transient image!\n");
+				return false;
+			}
+			vkGetImageMemoryRequirements(device, object.image, &object.requirements);
+		} else {
+			VkBufferCreateInfo buffer_info = VkTypeWrapper<VkBufferCreateInfo>{};
+			buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buffer_info.size = key.buffer_desc.size;
+			buffer_info.usage = key.buffer_desc.usage;
+			buffer_info.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+			buffer_info.queueFamilyIndexCount = concurrent ? (uint32_t) families.size() : 0;
+			buffer_info.pQueueFamilyIndices = concurrent ? families.data() : NULL;
+
+			if (vkCreateBuffer(device, &buffer_info, host_allocation_callbacks(), &object.buffer) != VK_SUCCESS) {
+				fprintf(stderr, "failed to create transient buffer!\n");
+				return false;
+			}
+			vkGetBufferMemoryRequirements(device, object.buffer, &object.requirements);
+		}
+	}
+
+	place_transients(set);
+
+	VkPhysicalDeviceMemoryProperties mem_properties = VkTypeWrapper<VkPhysicalDeviceMemoryProperties>{};
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+	for (Heap& heap : set.heaps) {
+		// Device local when any allowed type is
+		uint32_t memory_type = UINT32_MAX;
+		for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+			if (!(heap.type_bits & (1u << i))) {
+				continue;
+			}
+			if (memory_type == UINT32_MAX || (mem_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+				memory_type = i;
+				if (mem_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+					break;
+				}
+			}
+		}
+
+		VkMemoryRequirements requirements = {heap.size, heap.alignment, heap.type_bits};
+		if (memory_type == UINT32_MAX || !allocator->allocate(requirements, memory_type, heap.images, heap.allocation)) {
+			fprintf(stderr, "failed to allocate %llu bytes of transient memory!\n", (unsigned long long) heap.size);
+			return false;
+		}
+
+		for (uint32_t t : heap.members) {
+			TransientObject& object = set.objects[t];
+			VkDeviceSize offset = heap.allocation.offset + object.offset;
+
+			if (object.image != VK_NULL_HANDLE) {
+				vkBindImageMemory(device, object.image, heap.allocation.memory, offset);
+			} else {
+				vkBindBufferMemory(device, object.buffer, heap.allocation.memory, offset);
+			}
+		}
+	}
+
+	// Views need the memory bound
+	for (uint32_t t = 0; t < (uint32_t) set.keys.size(); t++) {
+		const TransientKey& key = set.keys[t];
+		TransientObject& object = set.objects[t];
+		if (!key.is_image) {
+			continue;
+		}
+
+		VkImageViewCreateInfo view_info = VkTypeWrapper<VkImageViewCreateInfo>{};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = object.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = key.image_desc.format;
+		view_info.subresourceRange.aspectMask = key.image_desc.aspect;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &view_info, host_allocation_callbacks(), &object.view) != VK_SUCCESS) {
+			fprintf(stderr, "failed to create transient image view!\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void RenderGraph::place_transients(TransientSet& set) {
+	/*
+	 * Biggest first, each one at the lowest offset of a compatible heap where it overlaps no
+	 * resource alive at the same time. Only transients used on the same single queue share memory,
+	 * the ones on different queues may run at the same time whatever their order
+	 */
+	std::vector<uint32_t> sorted(set.keys.size());
+	for (uint32_t t = 0; t < (uint32_t) sorted.size(); t++) {
+		sorted[t] = t;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) {
+		return set.objects[a].requirements.size > set.objects[b].requirements.size;
+	});
+
+	unaliased_bytes = 0;
+
+	for (uint32_t t : sorted) {
+		const TransientKey& key = set.keys[t];
+		TransientObject& object = set.objects[t];
+		const VkMemoryRequirements& requirements = object.requirements;
+		unaliased_bytes += requirements.size;
+
+		auto conflicts = [&](uint32_t other) {
+			const TransientKey& other_key = set.keys[other];
+			bool same_queue = key.queue_mask == other_key.queue_mask && (key.queue_mask & (key.queue_mask - 1)) == 0;
+			return !same_queue || lifetimes_overlap(key.first_use, key.last_use, other_key.first_use, other_key.last_use);
+		};
+
+		uint32_t chosen = UINT32_MAX;
+		VkDeviceSize chosen_offset = 0;
+
+		for (uint32_t h = 0; h < (uint32_t) set.heaps.size() && chosen == UINT32_MAX; h++) {
+			Heap& heap = set.heaps[h];
+			if (heap.images != key.is_image || (heap.type_bits & requirements.memoryTypeBits) == 0) {
+				continue;
+			}
+
+			// Candidates are the start of the heap and the end of every member, lowest first
+			std::vector<VkDeviceSize> candidates = {0};
+			for (uint32_t member : heap.members) {
+				const TransientObject& placed = set.objects[member];
+				VkDeviceSize end = placed.offset + placed.requirements.size;
+				candidates.push_back((end + requirements.alignment - 1) / requirements.alignment * requirements.alignment);
+			}
+			std::sort(candidates.begin(), candidates.end());
+
+			for (VkDeviceSize offset : candidates) {
+				bool fits = true;
+				for (uint32_t member : heap.members) {
+					const TransientObject& placed = set.objects[member];
+					bool overlaps = offset < placed.offset + placed.requirements.size && placed.offset < offset + requirements.size;
+					if (overlaps && conflicts(member)) {
+						fits = false;
+						break;
+					}
+				}
+
+				if (fits) {
+					chosen = h;
+					chosen_offset = offset;
+					break;
+				}
+			}
+		}
+
+		if (chosen == UINT32_MAX) {
+			Heap heap;
+			heap.images = key.is_image;
+			heap.type_bits = requirements.memoryTypeBits;
+			set.heaps.push_back(heap);
+			chosen = (uint32_t) set.heaps.size() - 1;
+			chosen_offset = 0;
+		}
+
+		Heap& heap = set.heaps[chosen];
+		heap.type_bits &= requirements.memoryTypeBits;
+		heap.alignment = std::max(heap.alignment, requirements.alignment);
+		heap.size = std::max(heap.size, chosen_offset + requirements.size);
+		heap.members.push_back(t);
+
+		object.heap = chosen;
+		object.offset = chosen_offset;
+	}
+
+	transient_bytes = 0;
+	for (const Heap& heap : set.heaps) {
+		transient_bytes += heap.size;
+	}
+}
+
+void RenderGraph::release_transients(TransientSet& set, uint64_t frame) {
+	if (set.objects.empty() && set.heaps.empty()) {
+		set = TransientSet{};
+		return;
+	}
+
+	VkDevice device = this->device;
+	VkAllocator* allocator = this->allocator;
+	std::vector<TransientObject> objects = std::move(set.objects);
+	std::vector<Heap> heaps = std::move(set.heaps);
+	set = TransientSet{};
+
+	auto release = [device, allocator, objects, heaps]() mutable {
+		for (TransientObject& object : objects) {
+			if (object.view != VK_NULL_HANDLE) {
+				vkDestroyImageView(device, object.view, host_allocation_callbacks());
+			}
+			if (object.image != VK_NULL_HANDLE) {
+				vkDestroyImage(device, object.image, host_allocation_callbacks());
+			}
+			if (object.buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(device, object.buffer, host_allocation_callbacks());
+			}
+		}
+
+		for (Heap& heap : heaps) {
+			if (heap.allocation.memory != VK_NULL_HANDLE) {
+				allocator->free(heap.allocation);
+			}
+		}
+	};
+
+	// Frames already submitted may still render with them
+	if (deletion_queue != nullptr && frame != UINT64_MAX) {
+		deletion_queue->push(frame, std::move(release));
+	} else {
+		release();
+	}
+}
+
+bool RenderGraph::build_runs() {
+	runs.clear();
+	barriers.clear();
+
+	// ----- Starting state of every resource -----
+	for (uint32_t r = 0; r < (uint32_t) resources.size(); r++) {
+		const Resource& resource = resources[r];
+		ResourceState state;
+
+		if (resource.imported) {
+			state = resource.initial;
+		} else if (resource.transient != UINT32_MAX) {
+			// The previous occupants of its memory, itself in the frame before included, are done with it first
+			const TransientObject& object = transients.objects[resource.transient];
+			for (const Resource& occupant : resources) {
+				if (occupant.transient == UINT32_MAX || transients.objects[occupant.transient].heap != object.heap) {
+					continue;
+				}
+
+				const TransientObject& placed = transients.objects[occupant.transient];
+				bool shares_memory = object.offset < placed.offset + placed.requirements.size && placed.offset < object.offset + object.requirements.size;
+				if (shares_memory) {
+					state.stages |= occupant.last_stages;
+					state.access |= occupant.last_access;
+				}
+			}
+		} else {
+			continue;
+		}
+
+		if (resource.is_image) {
+			barriers.setImageState(resource.image, resource.aspect, state);
+		} else {
+			barriers.setBufferState(resource.buffer, state);
+		}
+	}
+
+	// ----- Barriers ahead of each kept pass, grouped in runs on one queue -----
+	std::vector<uint32_t> last_runs(resources.size(), UINT32_MAX);
+
+	for (uint32_t p : order) {
+		const Pass& pass = passes[p];
+		RenderQueue queue = resolve_queue(pass.queue);
+		barriers.setQueueStages(queue_stage_mask(queue));
+
+		if (runs.empty() || runs.back().queue != queue) {
+			Run run;
+			run.queue = queue;
+			runs.push_back(run);
+		}
+		uint32_t run_index = (uint32_t) runs.size() - 1;
+		Run& run = runs[run_index];
+
+		for (const Use& use : pass.uses) {
+			const Resource& resource = resources[use.resource];
+			uint32_t& last_run = last_runs[use.resource];
+
+			// Waiting on the other queue's timeline makes its work visible, nothing to release or acquire
+			if (last_run != UINT32_MAX && runs[last_run].queue != queue) {
+				if (std::find(run.waits.begin(), run.waits.end(), last_run) == run.waits.end()) {
+					run.waits.push_back(last_run);
+				}
+				if (resource.is_image) {
+					barriers.acquiredImage(resource.image);
+				} else {
+					barriers.acquiredBuffer(resource.buffer);
+				}
+			}
+			last_run = run_index;
+
+			if (!resource.is_image) {
+				barriers.useBuffer(resource.buffer, use.access, use.write);
+			} else if (!barriers.useImage(resource.image, resource.aspect, use.access, use.write)) {
+				fprintf(stderr, "pass %s uses %s in two layouts\n", pass.name.c_str(), resource.name.c_str());
+				return false;
+			}
+		}
+
+		run.passes.push_back(p);
+		run.barriers.push_back(barriers.take());
+	}
+
+	// ----- Imported images left the way the outside expects them, by the last run using them -----
+	for (uint32_t run_index = 0; run_index < (uint32_t) runs.size(); run_index++) {
+		Run& run = runs[run_index];
+		barriers.setQueueStages(queue_stage_mask(run.queue));
+
+		for (uint32_t r = 0; r < (uint32_t) resources.size(); r++) {
+			const Resource& resource = resources[r];
+			uint32_t last_run = last_runs[r] != UINT32_MAX ? last_runs[r] : (uint32_t) runs.size() - 1;
+			if (resource.has_final && last_run == run_index) {
+				barriers.useImage(resource.image, resource.aspect, resource.final, false);
+			}
+		}
+
+		run.final_barriers = barriers.take();
+	}
+
+	return true;
+}
+
+void RenderGraph::record_run(VkCommandBuffer command_buffer, const Run& run) const {
+	for (size_t i = 0; i < run.passes.size(); i++) {
+		barriers.emit(command_buffer, run.barriers[i]);
+
+		const Pass& pass = passes[run.passes[i]];
+		if (pass.fn) {
+			pass.fn(command_buffer, *this);
+		}
+	}
+
+	barriers.emit(command_buffer, run.final_barriers);
+}
+
+void RenderGraph::record(VkCommandBuffer command_buffer) const {
+	for (const Run& run : runs) {
+		if (run.queue != runs.front().queue) {
+			fprintf(stderr, "render graph spans several queues, it has to be submitted\n");
+			return;
+		}
+	}
+
+	for (const Run& run : runs) {
+		record_run(command_buffer, run);
+	}
+}
+
+uint64_t RenderGraph::submit(VkSemaphore wait_semaphore, VkPipelineStageFlags wait_stages, VkSemaphore signal_semaphore) {
+	if (frame_count == 0 || queues[(uint32_t) RenderQueue::Graphics].timeline == nullptr) {
+		fprintf(stderr, "render graph has no queues to submit to!\n");
+		exit(1);
+	}
+
+	uint32_t frame = submit_index++ % frame_count;
+
+	// Each queue's pool for this frame is free again once what it last submitted is done
+	uint32_t used[(uint32_t) RenderQueue::Count] = {0};
+	for (QueueSlot& slot : queues) {
+		if (slot.timeline == nullptr) {
+			continue;
+		}
+		slot.timeline->wait(slot.values[frame]);
+		if (!slot.command_buffers[frame].empty()) {
+			vkResetCommandPool(device, slot.pools[frame], 0);
+		}
+	}
+
+	uint32_t first_graphics = UINT32_MAX;
+	uint32_t last_graphics = UINT32_MAX;
+	for (uint32_t r = 0; r < (uint32_t) runs.size(); r++) {
+		if (runs[r].queue == RenderQueue::Graphics) {
+			first_graphics = first_graphics == UINT32_MAX ? r : first_graphics;
+			last_graphics = r;
+		}
+	}
+
+	uint64_t previous_values[(uint32_t) RenderQueue::Count];
+	memcpy(previous_values, last_values, sizeof(previous_values));
+	bool waited_previous[(uint32_t) RenderQueue::Count] = {false};
+
+	std::vector<uint64_t> run_values(runs.size(), 0);
+
+	for (uint32_t r = 0; r < (uint32_t) runs.size(); r++) {
+		const Run& run = runs[r];
+		uint32_t q = (uint32_t) run.queue;
+		QueueSlot& slot = queues[q];
+
+		// ----- Record -----
+		std::vector<VkCommandBuffer>& command_buffers = slot.command_buffers[frame];
+		if (used[q] == command_buffers.size()) {
+			VkCommandBufferAllocateInfo alloc_info = VkTypeWrapper<VkCommandBufferAllocateInfo>{};
+			alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			alloc_info.commandPool = slot.pools[frame];
+			alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			alloc_info.commandBufferCount = 1;
+
+			VkCommandBuffer command_buffer;
+			if (vkAllocateCommandBuffers(device, &alloc_info, &command_buffer) != VK_SUCCESS) {
+				fprintf(stderr, "failed to allocate render graph command buffer!\n");
+				exit(1);
+			}
+			command_buffers.push_back(command_buffer);
+		}
+		VkCommandBuffer command_buffer = command_buffers[used[q]++];
+
+		VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(command_buffer, &begin_info);
+		record_run(command_buffer, run);
+		vkEndCommandBuffer(command_buffer);
+
+		// ----- Waits -----
+		std::vector<VkSemaphore> wait_semaphores;
+		std::vector<uint64_t> wait_values;
+		std::vector<VkPipelineStageFlags> wait_stage_masks;
+
+		for (uint32_t w : run.waits) {
+			QueueTimeline* timeline = queues[(uint32_t) runs[w].queue].timeline;
+			if (timeline != slot.timeline) {
+				wait_semaphores.push_back(timeline->semaphore());
+				wait_values.push_back(run_values[w]);
+				wait_stage_masks.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			}
+		}
+
+		// The first run of a queue waits for last frame's work on the others, the transients are shared across frames
+		if (!waited_previous[q]) {
+			waited_previous[q] = true;
+			for (uint32_t other = 0; other < (uint32_t) RenderQueue::Count; other++) {
+				QueueTimeline* timeline = queues[other].timeline;
+				if (timeline != nullptr && timeline != slot.timeline && previous_values[other] != 0) {
+					wait_semaphores.push_back(timeline->semaphore());
+					wait_values.push_back(previous_values[other]);
+					wait_stage_masks.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+				}
+			}
+		}
+
+		if (r == first_graphics && wait_semaphore != VK_NULL_HANDLE) {
+			wait_semaphores.push_back(wait_semaphore);
+			wait_values.push_back(0);
+			wait_stage_masks.push_back(wait_stages);
+		}
+
+		// ----- Signals -----
+		run_values[r] = slot.timeline->next();
+
+		VkSemaphore signal_semaphores[2] = {slot.timeline->semaphore(), signal_semaphore};
+		uint64_t signal_values[2] = {run_values[r], 0};
+		uint32_t signal_count = (r == last_graphics && signal_semaphore != VK_NULL_HANDLE) ? 2 : 1;
+
+		VkTimelineSemaphoreSubmitInfo timeline_info = VkTypeWrapper<VkTimelineSemaphoreSubmitInfo>{};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.waitSemaphoreValueCount = (uint32_t) wait_values.size();
+		timeline_info.pWaitSemaphoreValues = wait_values.data();
+		timeline_info.signalSemaphoreValueCount = signal_count;
+		timeline_info.pSignalSemaphoreValues = signal_values;
+
+		VkSubmitInfo submit_info = VkTypeWrapper<VkSubmitInfo>{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_info;
+		submit_info.waitSemaphoreCount = (uint32_t) wait_semaphores.size();
+		submit_info.pWaitSemaphores = wait_semaphores.data();
+		submit_info.pWaitDstStageMask = wait_stage_masks.data();
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &command_buffer;
+		submit_info.signalSemaphoreCount = signal_count;
+		submit_info.pSignalSemaphores = signal_semaphores;
+
+		if (vkQueueSubmit(slot.timeline->queue(), 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+			fprintf(stderr, "failed to submit render graph pass %s!\n", passes[run.passes.front()].name.c_str());
+			exit(1);
+		}
+
+		slot.values[frame] = run_values[r];
+		last_values[q] = run_values[r];
+	}
+
+	return last_values[(uint32_t) RenderQueue::Graphics];
+}
+
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "VkCommon.hpp"
+#include "QueueTimeline.hpp"
+#include "DeletionQueue.hpp"
+#include "BarrierRecorder.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////  Render graph  ////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Queues a pass can ask for, it runs on graphics when the graph was given no timeline for it
+enum class RenderQueue : uint32_t {
+    Graphics = 0,
+    Compute,
+    Transfer,
+    Count
+};
+
+typedef uint32_t RenderResource;
+#define INVALID_RENDER_RESOURCE UINT32_MAX
+
+struct RenderImageDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {0, 0};
+    VkImageUsageFlags usage = 0;        // what the passes declare is added to it
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+struct RenderBufferDesc {
+    VkDeviceSize size = 0;
+    VkBufferUsageFlags usage = 0;       // what the passes declare is added to it
+};
+
+class RenderGraph;
+
+// Records the pass's commands, resources are looked up through the graph
+typedef std::function<void(VkCommandBuffer command_buffer, const RenderGraph& graph)> RenderPassFn;
+
+// Returned by addPass(), declares what the pass reads and writes
+class RenderPassBuilder {
+public:
+    RenderPassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+    RenderPassBuilder& read(RenderResource resource, ResourceAccess access);
+    RenderPassBuilder& write(RenderResource resource, ResourceAccess access);
+    // Kept even when nothing reads what it writes
+    RenderPassBuilder& sideEffect();
+    RenderPassBuilder& execute(RenderPassFn fn);
+
+private:
+    RenderGraph& graph;
+    uint32_t pass;
+};
+
+/*
+ * Frame graph of passes and the resources they read and write.
+ *
+ * Passes are added in execution order, each declaring every resource it uses and how. compile()
+ * then:
+ *  - culls the passes whose results nothing needs: a pass is kept when it has side effects, writes
+ *    an imported resource, or writes something a kept pass after it reads;
+ *  - declares every use of every kept pass to a BarrierRecorder, which gives one batched barrier
+ *    ahead of each pass holding only what it needs: layout transitions, read after write and
+ *    write after read hazards. Reads following reads in the same layout need nothing;
+ *  - creates the transient resources and places those of disjoint lifetimes at the same offsets
+ *    of a few shared allocations. The first use of one waits on the last uses of whatever shares
+ *    its memory, last frame's use of itself included;
+ *  - splits the kept passes into runs on the same queue. A run waits, on the GPU, for the
+ *    timeline values of the runs on other queues it depends on, so independent passes overlap.
+ *
+ * record() puts everything in one command buffer, for graphs on a single queue. submit() records
+ * and submits every run to its queue. Resources used from several queue families are created
+ * concurrent; imported ones are expected to be too.
+ *
+ * A compiled graph can be recorded any number of times. A graph rebuilt every frame reuses the
+ * transients of the previous compilation when it declares the same ones with the same lifetimes;
+ * otherwise they go through the deletion queue, frames already submitted keep using them.
+ */
+class RenderGraph {
+public:
+    // cmd_pipeline_barrier2 null without synchronization2, see BarrierRecorder
+    bool init(VkPhysicalDevice physical_device, VkDevice device, VkAllocator* allocator, DeletionQueue* deletion_queue,
+        PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2);
+    void destroy();
+
+    // Enables submit(); timelines[queue] may be null (no such queue, its passes run on graphics) or
+    // shared between queues, whose passes then run as the first of them. frame_count submissions
+    // can be in flight at once
+    bool setQueues(QueueTimeline* const timelines[(uint32_t) RenderQueue::Count], const uint32_t families[(uint32_t) RenderQueue::Count],
+        uint32_t frame_count);
+
+    // Drops every pass and resource to build the graph again, the transients are kept for compile()
+    void reset();
+
+    RenderResource importImage(const char* name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+        const ResourceState& initial, const ResourceState& final);
+    RenderResource importBuffer(const char* name, VkBuffer buffer, const ResourceState& initial);
+    RenderResource createImage(const char* name, const RenderImageDesc& desc);
+    RenderResource createBuffer(const char* name, const RenderBufferDesc& desc);
+
+    RenderPassBuilder addPass(const char* name, RenderQueue queue = RenderQueue::Graphics);
+
+    // frame is the one being built, transients that cannot be reused are released with it
+    bool compile(uint64_t frame);
+
+    // Single queue graphs only
+    void record(VkCommandBuffer command_buffer) const;
+
+    // Waits on wait_semaphore (binary) before the first graphics run and signals signal_semaphore
+    // (binary) after the last one, either may be VK_NULL_HANDLE. Returns the graphics timeline
+    // value reached once the whole graph is done
+    uint64_t submit(VkSemaphore wait_semaphore, VkPipelineStageFlags wait_stages, VkSemaphore signal_semaphore);
+
+    VkImage image(RenderResource resource) const;
+    VkImageView view(RenderResource resource) const;
+    VkBuffer buffer(RenderResource resource) const;
+
+    uint32_t passCount() const { return (uint32_t) passes.size(); }
+    uint32_t culledPassCount() const { return culled_count; }
+    // Transient memory with and without aliasing, to see what it saves
+    VkDeviceSize transientBytes() const { return transient_bytes; }
+    VkDeviceSize unaliasedTransientBytes() const { return unaliased_bytes; }
+    // Bumped by every compile() that created new transients, what was recorded before uses released ones
+    uint64_t transientGeneration() const { return transient_generation; }
+
+    // What compile() decided, for checks: the runs in submission order, the earlier runs each waits
+    // on, the batch ahead of a pass (null when culled) and where a transient was placed
+    uint32_t runCount() const { return (uint32_t) runs.size(); }
+    RenderQueue runQueue(uint32_t run) const { return runs[run].queue; }
+    const std::vector<uint32_t>& runWaits(uint32_t run) const { return runs[run].waits; }
+    const BarrierBatch* passBarriers(uint32_t pass) const;
+    // False when the resource is imported or no kept pass uses it
+    bool transientPlacement(RenderResource resource, uint32_t& heap, VkDeviceSize& offset, VkDeviceSize& size) const;
+
+private:
+    friend class RenderPassBuilder;
+
+    struct Use {
+        RenderResource resource;
+        ResourceAccess access;
+        bool write;
+    };
+
+    struct Pass {
+        std::string name;
+        RenderQueue queue;
+        std::vector<Use> uses;
+        RenderPassFn fn;
+        bool side_effect = false;
+        bool alive = false;
+    };
+
+    struct Resource {
+        std::string name;
+        bool is_image = false;
+        bool imported = false;
+
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        RenderImageDesc image_desc;
+        RenderBufferDesc buffer_desc;
+
+        ResourceState initial;
+        ResourceState final;
+        bool has_final = false;
+
+        // Transients only, first and last use in kept pass order
+        uint32_t transient = UINT32_MAX;
+        uint32_t first_use = UINT32_MAX;
+        uint32_t last_use = 0;
+        uint32_t queue_mask = 0;                // resolved queues of the kept passes using it
+        VkPipelineStageFlags2 last_stages = 0;  // of its last use, what the next occupant of its memory waits for
+        VkAccessFlags2 last_access = 0;
+    };
+
+    // What a transient is created from, a compilation with the same keys reuses the objects
+    struct TransientKey {
+        bool is_image = false;
+        RenderImageDesc image_desc;
+        RenderBufferDesc buffer_desc;
+        uint32_t first_use = 0;
+        uint32_t last_use = 0;
+        uint32_t queue_mask = 0;
+
+        bool operator==(const TransientKey& other) const;
+    };
+
+    struct TransientObject {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements = {};
+        uint32_t heap = UINT32_MAX;
+        VkDeviceSize offset = 0;
+    };
+
+    // Shared allocation the transients of one kind are placed in
+    struct Heap {
+        bool images = false;
+        uint32_t type_bits = 0;
+        VkDeviceSize alignment = 1;
+        VkDeviceSize size = 0;
+        std::vector<uint32_t> members;          // transient indices
+        MemoryAllocation allocation;
+    };
+
+    struct TransientSet {
+        std::vector<TransientKey> keys;
+        std::vector<TransientObject> objects;
+        std::vector<Heap> heaps;
+    };
+
+    // Kept passes in a row on the same queue
+    struct Run {
+        RenderQueue queue;
+        std::vector<uint32_t> passes;
+        std::vector<BarrierBatch> barriers;     // one ahead of each pass
+        BarrierBatch final_barriers;            // imported resources to their final state
+        std::vector<uint32_t> waits;            // earlier runs on other queues
+    };
+
+    struct QueueSlot {
+        QueueTimeline* timeline = nullptr;
+        uint32_t family = 0;
+        std::vector<VkCommandPool> pools;                       // one per frame
+        std::vector<std::vector<VkCommandBuffer>> command_buffers;
+        std::vector<uint64_t> values;                           // last value each frame's pool signalled
+    };
+
+    RenderQueue resolve_queue(RenderQueue queue) const;
+    void cull();
+    bool create_transients(TransientSet& set);
+    void place_transients(TransientSet& set);
+    void release_transients(TransientSet& set, uint64_t frame);
+    bool build_runs();
+    void record_run(VkCommandBuffer command_buffer, const Run& run) const;
+
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkAllocator* allocator = nullptr;
+    DeletionQueue* deletion_queue = nullptr;
+    // Tracks the resources while compiling, then emits the batches it gave
+    BarrierRecorder barriers;
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<uint32_t> order;        // kept passes
+    std::vector<Run> runs;
+    TransientSet transients;
+    uint32_t culled_count = 0;
+    VkDeviceSize transient_bytes = 0;
+    VkDeviceSize unaliased_bytes = 0;
+    uint64_t transient_generation = 0;
+
+    QueueSlot queues[(uint32_t) RenderQueue::Count];
+    uint64_t last_values[(uint32_t) RenderQueue::Count] = {0};  // signalled by the previous submit()
+    uint32_t frame_count = 0;
+    uint32_t submit_index = 0;
+};
+
+}
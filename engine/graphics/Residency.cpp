@@ -0,0 +1,115 @@
+#include "Residency.hpp"
+
+#include <algorithm>
+
+namespace VK {
+
+void ResidencyManager::track(ResourceHandle handle, Evictor evictor) {
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back(Entry{handle, 0, std::move(evictor)});
+}
+
+void ResidencyManager::untrack(ResourceHandle handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].handle == handle) {
+			entries[i] = std::move(entries.back());
+			entries.pop_back();
+			return;
+		}
+	}
+}
+
+void ResidencyManager::released(uint64_t frame, uint32_t heap, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending_releases.push_back(PendingRelease{frame, heap, size});
+}
+
+ResidencyManager::Eviction ResidencyManager::enforce(VkAllocator& allocator, ResourceTable& resources, uint64_t current_frame, uint64_t completed_frame) {
+	Eviction eviction;
+
+	// Releases of the frames the GPU finished are back in the allocator, the others are still to come
+	VkDeviceSize pending[VK_MAX_MEMORY_HEAPS] = {0};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (size_t i = 0; i < pending_releases.size();) {
+			if (pending_releases[i].frame <= completed_frame) {
+				pending_releases[i] = pending_releases.back();
+				pending_releases.pop_back();
+				continue;
+			}
+			pending[pending_releases[i].heap] += pending_releases[i].size;
+			i++;
+		}
+	}
+
+	// Heaps over the watermark and how much each has to shed
+	VkDeviceSize excess[VK_MAX_MEMORY_HEAPS] = {0};
+	for (uint32_t heap = 0; heap < allocator.heapCount(); heap++) {
+		HeapBudget budget;
+		allocator.heapBudget(heap, budget);
+
+		// Free ranges of our blocks take new allocations without growing the heap
+		VkDeviceSize reclaimable = budget.allocated - budget.used + pending[heap];
+		VkDeviceSize usage = budget.usage > reclaimable ? budget.usage - reclaimable : 0;
+
+		VkDeviceSize limit = (VkDeviceSize) (budget.budget * watermark);
+		if (usage > limit) {
+			excess[heap] = usage - limit;
+			eviction.heap_count++;
+		}
+	}
+
+	if (eviction.heap_count == 0) {
+		return eviction;
+	}
+
+	std::vector<Entry> victims;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// Oldest stamps first, resources released without being untracked are dropped
+		for (size_t i = 0; i < entries.size();) {
+			if (!resources.isValid(entries[i].handle)) {
+				entries[i] = std::move(entries.back());
+				entries.pop_back();
+				continue;
+			}
+			entries[i].last_used_frame = resources.get(entries[i].handle)->last_used_frame;
+			i++;
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+			return a.last_used_frame < b.last_used_frame;
+		});
+
+		for (size_t i = 0; i < entries.size();) {
+			DeviceResource* resource = resources.get(entries[i].handle);
+			uint32_t heap = allocator.heapOf(resource->allocation.memory_type);
+
+			if (resource->last_used_frame >= current_frame || resource->allocation.memory == VK_NULL_HANDLE || excess[heap] == 0) {
+				i++;
+				continue;
+			}
+
+			// Counted as gone right away, the evictor's release reports it until the frames in flight retire
+			VkDeviceSize size = resource->allocation.size;
+			excess[heap] = size < excess[heap] ? excess[heap] - size : 0;
+			eviction.evicted_bytes += size;
+
+			victims.push_back(std::move(entries[i]));
+			entries.erase(entries.begin() + i);
+		}
+	}
+
+	// The evictors run outside the lock, they may track the demoted copy again
+	for (Entry& victim : victims) {
+		victim.evictor(victim.handle);
+	}
+
+	eviction.evicted = (uint32_t) victims.size();
+	return eviction;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "VkCommon.hpp"
+#include "ResourceTable.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////  Residency  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Share of a heap's budget above which streamable resources start being evicted
+#define RESIDENCY_DEFAULT_WATERMARK 0.9f
+
+/*
+ * Least recently used eviction of streamable resources.
+ *
+ * Streamable resources are ones that can be brought back on demand (streamed meshes, mip tails,
+ * caches). Each one is tracked with an evictor supplied by its owner, which either demotes it to
+ * host memory or releases it and remembers to reload it. The frames using a resource stamp the
+ * last_used_frame of its record; once a heap's usage crosses watermark * budget, enforce() evicts the resources
+ * of that heap used longest ago until the estimate is back under the watermark. Resources used by
+ * the frame being built are never evicted, evictors release through the deletion queue so frames
+ * still in flight keep their copy.
+ *
+ * The usage measured leaves out the free ranges of the allocator's blocks, which new allocations
+ * reuse, and the releases still waiting in the deletion queue: those only give their memory back
+ * once the frame that released them retires, counting them again would evict more every frame.
+ */
+class ResidencyManager {
+public:
+    // Frees or demotes the resource, the handle is released or now names the demoted copy
+    typedef std::function<void(ResourceHandle)> Evictor;
+
+    struct Eviction {
+        uint32_t heap_count = 0;        // heaps that crossed the watermark
+        uint32_t evicted = 0;
+        VkDeviceSize evicted_bytes = 0;
+    };
+
+    void track(ResourceHandle handle, Evictor evictor);
+    void untrack(ResourceHandle handle);
+
+    // Memory handed to the deletion queue during frame, back in the allocator once it completes
+    void released(uint64_t frame, uint32_t heap, VkDeviceSize size);
+
+    void setWatermark(float watermark) { this->watermark = watermark; }
+    float getWatermark() const { return watermark; }
+
+    // current_frame is the frame being built, completed_frame the last one the GPU finished and
+    // whose releases went through. Call once per frame
+    Eviction enforce(VkAllocator& allocator, ResourceTable& resources, uint64_t current_frame, uint64_t completed_frame);
+
+private:
+    struct Entry {
+        ResourceHandle handle;
+        uint64_t last_used_frame;   // copied out of the record when sorting
+        Evictor evictor;
+    };
+
+    // Released memory not back in the allocator yet
+    struct PendingRelease {
+        uint64_t frame;
+        uint32_t heap;
+        VkDeviceSize size;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    std::vector<PendingRelease> pending_releases;
+    float watermark = RESIDENCY_DEFAULT_WATERMARK;
+};
+
+}
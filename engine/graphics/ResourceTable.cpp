@@ -0,0 +1,78 @@
+#include "ResourceTable.hpp"
+
+namespace VK {
+
+ResourceHandle ResourceTable::insert(const DeviceResource& resource) {
+	uint32_t index;
+	if (!free_slots.empty()) {
+		index = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		if (slots.size() >= RESOURCE_HANDLE_MAX_SLOTS) {
+			fprintf(stderr, "Resource table full (%u slots)\n", RESOURCE_HANDLE_MAX_SLOTS);
+			exit(1);
+		}
+		index = (uint32_t) slots.size();
+		slots.push_back(Slot{});
+	}
+
+	Slot& slot = slots[index];
+	slot.dense_index = (uint32_t) records.size();
+
+	ResourceHandle handle = (slot.generation << RESOURCE_HANDLE_INDEX_BITS) | index;
+	records.push_back(resource);
+	handles.push_back(handle);
+	return handle;
+}
+
+bool ResourceTable::remove(ResourceHandle handle, DeviceResource& resource) {
+	if (!isValid(handle)) {
+		return false;
+	}
+
+	Slot& slot = slots[index_of(handle)];
+	uint32_t dense_index = slot.dense_index;
+	resource = records[dense_index];
+
+	// The last record fills the hole, its slot follows it
+	uint32_t last = (uint32_t) records.size() - 1;
+	if (dense_index != last) {
+		records[dense_index] = records[last];
+		handles[dense_index] = handles[last];
+		slots[index_of(handles[dense_index])].dense_index = dense_index;
+	}
+	records.pop_back();
+	handles.pop_back();
+
+	// Generation 0 is skipped when wrapping so no handle ever equals INVALID_RESOURCE_HANDLE
+	slot.generation = (slot.generation + 1) & RESOURCE_HANDLE_GENERATION_MASK;
+	if (slot.generation == 0) {
+		slot.generation = 1;
+	}
+	free_slots.push_back(index_of(handle));
+	return true;
+}
+
+bool ResourceTable::isValid(ResourceHandle handle) const {
+	uint32_t index = index_of(handle);
+	return handle != INVALID_RESOURCE_HANDLE && index < slots.size() && slots[index].generation == generation_of(handle);
+}
+
+DeviceResource* ResourceTable::get(ResourceHandle handle) {
+#if RESOURCE_TABLE_VALIDATE
+	if (!isValid(handle)) {
+		if (handle != INVALID_RESOURCE_HANDLE) {
+			fprintf(stderr, "Stale resource handle %08x\n", handle);
+		}
+		return nullptr;
+	}
+#else
+	if (handle == INVALID_RESOURCE_HANDLE) {
+		return nullptr;
+	}
+#endif
+
+	return &records[slots[index_of(handle)].dense_index];
+}
+
+}
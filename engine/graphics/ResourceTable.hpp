@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "VkCommon.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Resource table  ////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Generational handle of a DeviceResource, 0 is never handed out
+typedef uint32_t ResourceHandle;
+#define INVALID_RESOURCE_HANDLE 0u
+
+// Low bits index the slot, the rest hold its generation
+#define RESOURCE_HANDLE_INDEX_BITS 20
+#define RESOURCE_HANDLE_MAX_SLOTS (1u << RESOURCE_HANDLE_INDEX_BITS)
+#define RESOURCE_HANDLE_GENERATION_MASK ((1u << (32 - RESOURCE_HANDLE_INDEX_BITS)) - 1)
+
+// Lookups check the generation of the handle and report stale ones, debug builds only by default
+#ifndef RESOURCE_TABLE_VALIDATE
+#ifdef NDEBUG
+#define RESOURCE_TABLE_VALIDATE 0
+#else
+#define RESOURCE_TABLE_VALIDATE 1
+#endif
+#endif
+
+/*
+ * Slot map owning the DeviceResource records.
+ *
+ * The records are packed in one dense array; a handle names a slot which points into it, and the
+ * slot's generation is bumped every time it is freed so handles to a removed record can be told
+ * apart from the one reusing the slot. Removing moves the last record into the hole, so records
+ * move but handles never change: the defragmenter can swap a buffer under its handle and the
+ * holders see the new one on their next lookup.
+ *
+ * Pointers returned by get() are valid until the next insert() or remove(). The table is not
+ * synchronised, it is used from the thread driving the frame loop; other threads hold handles.
+ */
+class ResourceTable {
+public:
+    ResourceHandle insert(const DeviceResource& resource);
+
+    // Copies the record out and frees the slot, false for a stale handle
+    bool remove(ResourceHandle handle, DeviceResource& resource);
+
+    // O(1), nullptr for a stale handle when validating (or always for INVALID_RESOURCE_HANDLE).
+    // Without validation a stale handle reads whatever record its slot points at: holders that
+    // can outlive their resource check isValid() first
+    DeviceResource* get(ResourceHandle handle);
+    bool isValid(ResourceHandle handle) const;
+
+    size_t size() const { return records.size(); }
+
+    // Dense records in no particular order, with their handles
+    DeviceResource* begin() { return records.data(); }
+    DeviceResource* end() { return records.data() + records.size(); }
+    ResourceHandle handleAt(size_t dense_index) const { return handles[dense_index]; }
+
+private:
+    struct Slot {
+        uint32_t dense_index = 0;
+        uint32_t generation = 1;
+    };
+
+    static uint32_t index_of(ResourceHandle handle) { return handle & (RESOURCE_HANDLE_MAX_SLOTS - 1); }
+    static uint32_t generation_of(ResourceHandle handle) { return handle >> RESOURCE_HANDLE_INDEX_BITS; }
+
+    std::vector<DeviceResource> records;
+    std::vector<ResourceHandle> handles;    // handle of each dense record
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+};
+
+}
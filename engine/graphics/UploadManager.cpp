@@ -0,0 +1,369 @@
+#include "UploadManager.hpp"
+
+#include <algorithm>
+
+namespace VK {
+
+// Every way the uploaded buffers get read on the graphics queue
+#define UPLOAD_CONSUMER_USAGE (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT \
+	| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+
+static VkCommandPool create_pool(VkDevice device, uint32_t queue_family) {
+	VkCommandPoolCreateInfo pool_info = VkTypeWrapper<VkCommandPoolCreateInfo>{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_info.queueFamilyIndex = queue_family;
+
+	VkCommandPool pool = VK_NULL_HANDLE;
+	if (vkCreateCommandPool(device, &pool_info, host_allocation_callbacks(), &pool) != VK_SUCCESS) {
+		fprintf(stderr, "failed to create upload command pool!\n");
+		exit(1);
+	}
+
+	return pool;
+}
+
+static void allocate_command_buffers(VkDevice device, VkCommandPool pool, VkCommandBuffer* command_buffers) {
+	VkCommandBufferAllocateInfo alloc_info = VkTypeWrapper<VkCommandBufferAllocateInfo>{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.commandPool = pool;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.commandBufferCount = UPLOAD_BATCH_COUNT;
+
+	if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers) != VK_SUCCESS) {
+		fprintf(stderr, "failed to allocate upload command buffers!\n");
+		exit(1);
+	}
+}
+
+void UploadManager::init(VkDevice device, QueueTimeline* transfer_timeline, uint32_t transfer_family, QueueTimeline* graphics_timeline,
+		uint32_t graphics_family, const DeviceResource& staging, PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2) {
+	this->device = device;
+	this->timeline = transfer_timeline;
+	this->graphics_timeline = graphics_timeline;
+	this->queue_family = transfer_family;
+	this->graphics_family = graphics_family;
+	ownership_transfer = transfer_family != graphics_family;
+	barriers.init(cmd_pipeline_barrier2);
+
+	staging_buffer = staging.buffer;
+	staging_mapped = (char*) staging.allocation.mapped;
+	staging_size = staging.size;
+
+	VkCommandBuffer command_buffers[UPLOAD_BATCH_COUNT];
+	VkCommandBuffer acquire_command_buffers[UPLOAD_BATCH_COUNT] = {VK_NULL_HANDLE};
+
+	command_pool = create_pool(device, transfer_family);
+	allocate_command_buffers(device, command_pool, command_buffers);
+
+	if (ownership_transfer) {
+		acquire_pool = create_pool(device, graphics_family);
+		allocate_command_buffers(device, acquire_pool, acquire_command_buffers);
+	}
+
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+		batches[i] = Batch{};
+		batches[i].command_buffer = command_buffers[i];
+		batches[i].acquire_command_buffer = acquire_command_buffers[i];
+	}
+}
+
+void UploadManager::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	flush_locked();
+	while (!in_flight.empty()) {
+		retire(batches[in_flight.front()], true);
+	}
+
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+		batches[i] = Batch{};
+	}
+
+	// Frees the command buffers too
+	vkDestroyCommandPool(device, command_pool, host_allocation_callbacks());
+	command_pool = VK_NULL_HANDLE;
+
+	if (acquire_pool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(device, acquire_pool, host_allocation_callbacks());
+		acquire_pool = VK_NULL_HANDLE;
+	}
+}
+
+void UploadManager::retire(Batch& batch, bool block) {
+	if (block) {
+		graphics_timeline->wait(batch.value);
+	}
+
+	// Batches retire in submission order, so the tail only moves forward
+	ring_tail = batch.ring_end;
+	completed_ticket = batch.ticket;
+	batch.in_flight = false;
+	in_flight.pop_front();
+}
+
+void UploadManager::retire_completed() {
+	while (!in_flight.empty()) {
+		Batch& batch = batches[in_flight.front()];
+		if (!graphics_timeline->isComplete(batch.value)) {
+			break;
+		}
+		retire(batch, false);
+	}
+}
+
+void* UploadManager::reserve(VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (size > staging_size) {
+		fprintf(stderr, "Upload of %llu bytes does not fit the staging ring\n", (unsigned long long) size);
+		exit(1);
+	}
+
+	for (;;) {
+		// Never straddle the end of the ring, skip to its start instead
+		uint64_t position = (ring_head + UPLOAD_STAGING_ALIGNMENT - 1) & ~(uint64_t) (UPLOAD_STAGING_ALIGNMENT - 1);
+		uint64_t offset = position % staging_size;
+		if (offset + size > staging_size) {
+			position += staging_size - offset;
+			offset = 0;
+		}
+
+		if (position + size - ring_tail <= staging_size) {
+			ring_head = position + size;
+			pending.push_back(PendingCopy{staging_buffer, dst, VkBufferCopy{offset, dst_offset, size}});
+			return staging_mapped + offset;
+		}
+
+		// Full: wait for the oldest batch, or submit what is pending to be able to wait for it
+		if (!in_flight.empty()) {
+			retire(batches[in_flight.front()], true);
+		} else if (!pending.empty()) {
+			flush_locked();
+		} else {
+			ring_tail = position;
+		}
+	}
+}
+
+void UploadManager::upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size) {
+	// Chunks of half the ring keep a big upload from waiting on itself
+	VkDeviceSize chunk_size = staging_size / 2;
+
+	for (VkDeviceSize done = 0; done < size; done += chunk_size) {
+		VkDeviceSize chunk = size - done < chunk_size ? size - done : chunk_size;
+		memcpy(reserve(dst, dst_offset + done, chunk), (const char*) data + done, (size_t) chunk);
+	}
+}
+
+void UploadManager::copy(VkBuffer src, VkBuffer dst, const VkBufferCopy& region) {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending.push_back(PendingCopy{src, dst, region});
+}
+
+uint64_t UploadManager::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return flush_locked();
+}
+
+uint64_t UploadManager::flush_locked() {
+	retire_completed();
+
+	if (pending.empty()) {
+		return next_ticket - 1;
+	}
+
+	// The slot about to be reused is the oldest one in flight
+	Batch& batch = batches[next_batch];
+	while (batch.in_flight) {
+		retire(batches[in_flight.front()], true);
+	}
+
+	vkResetCommandBuffer(batch.command_buffer, 0);
+
+	VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.command_buffer, &begin_info);
+
+	// One vkCmdCopyBuffer per source / destination pair, with every region going there
+	std::stable_sort(pending.begin(), pending.end(), [](const PendingCopy& a, const PendingCopy& b) {
+		return a.src != b.src ? a.src < b.src : a.dst < b.dst;
+	});
+
+	std::vector<VkBufferCopy> regions;
+	regions.reserve(pending.size());
+
+	for (size_t first = 0; first < pending.size();) {
+		size_t last = first;
+		regions.clear();
+		while (last < pending.size() && pending[last].src == pending[first].src && pending[last].dst == pending[first].dst) {
+			regions.push_back(pending[last].region);
+			last++;
+		}
+
+		vkCmdCopyBuffer(batch.command_buffer, pending[first].src, pending[first].dst, (uint32_t) regions.size(), regions.data());
+		first = last;
+	}
+
+	// Every destination once, the copies wrote them
+	std::vector<VkBuffer> destinations;
+	destinations.reserve(pending.size());
+	for (const PendingCopy& copy : pending) {
+		destinations.push_back(copy.dst);
+	}
+	std::sort(destinations.begin(), destinations.end());
+	destinations.erase(std::unique(destinations.begin(), destinations.end()), destinations.end());
+
+	for (VkBuffer buffer : destinations) {
+		barriers.setBufferState(buffer, access_state(ResourceAccess::TransferDst));
+	}
+
+	if (ownership_transfer) {
+		submit_with_ownership_transfer(batch, destinations);
+	} else {
+		// Later submissions read the buffers as vertices, indices, uniforms, storage or copy sources
+		for (VkBuffer buffer : destinations) {
+			barriers.useBufferReads(buffer, UPLOAD_CONSUMER_USAGE);
+		}
+		barriers.flush(batch.command_buffer);
+		barriers.clear();
+
+		vkEndCommandBuffer(batch.command_buffer);
+
+		VkSubmitInfo submit_info = VkTypeWrapper<VkSubmitInfo>{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &batch.command_buffer;
+
+		// Same queue as the frames, the batch completes on the graphics timeline directly
+		batch.value = timeline->next();
+
+		VkSemaphore signal_semaphore = timeline->semaphore();
+		VkTimelineSemaphoreSubmitInfo timeline_info = VkTypeWrapper<VkTimelineSemaphoreSubmitInfo>{};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.signalSemaphoreValueCount = 1;
+		timeline_info.pSignalSemaphoreValues = &batch.value;
+
+		submit_info.pNext = &timeline_info;
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &signal_semaphore;
+
+		if (vkQueueSubmit(timeline->queue(), 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+			fprintf(stderr, "failed to submit upload batch!\n");
+			exit(1);
+		}
+	}
+
+	batch.ticket = next_ticket++;
+	batch.ring_end = ring_head;
+	batch.in_flight = true;
+	in_flight.push_back(next_batch);
+	next_batch = (next_batch + 1) % UPLOAD_BATCH_COUNT;
+
+	pending.clear();
+	return batch.ticket;
+}
+
+void UploadManager::submit_with_ownership_transfer(Batch& batch, const std::vector<VkBuffer>& buffers) {
+	/*
+	 * Exclusive buffers written on the transfer family have to be released by it and acquired by
+	 * the graphics family with matching barriers, the transfer timeline orders the two submissions
+	 */
+
+	// ----- Release on the transfer queue -----
+	for (VkBuffer buffer : buffers) {
+		barriers.releaseBuffer(buffer, queue_family, graphics_family);
+	}
+	barriers.flush(batch.command_buffer);
+	vkEndCommandBuffer(batch.command_buffer);
+
+	uint64_t released = timeline->next();
+	VkSemaphore transfer_semaphore = timeline->semaphore();
+
+	VkTimelineSemaphoreSubmitInfo release_timeline = VkTypeWrapper<VkTimelineSemaphoreSubmitInfo>{};
+	release_timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	release_timeline.signalSemaphoreValueCount = 1;
+	release_timeline.pSignalSemaphoreValues = &released;
+
+	VkSubmitInfo release_info = VkTypeWrapper<VkSubmitInfo>{};
+	release_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	release_info.pNext = &release_timeline;
+	release_info.commandBufferCount = 1;
+	release_info.pCommandBuffers = &batch.command_buffer;
+	release_info.signalSemaphoreCount = 1;
+	release_info.pSignalSemaphores = &transfer_semaphore;
+
+	if (vkQueueSubmit(timeline->queue(), 1, &release_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+		fprintf(stderr, "failed to submit upload batch!\n");
+		exit(1);
+	}
+
+	// ----- Acquire on the graphics queue -----
+	vkResetCommandBuffer(batch.acquire_command_buffer, 0);
+
+	VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.acquire_command_buffer, &begin_info);
+
+	for (VkBuffer buffer : buffers) {
+		barriers.acquireBuffer(buffer, queue_family, graphics_family);
+		barriers.useBufferReads(buffer, UPLOAD_CONSUMER_USAGE);
+	}
+	barriers.flush(batch.acquire_command_buffer);
+	barriers.clear();
+	vkEndCommandBuffer(batch.acquire_command_buffer);
+
+	// Chains the acquire after the release, it is the only command of the submission so waiting on every stage holds nothing else back
+	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	// The graphics value covers both halves, the staging range and both command buffers are free once it is reached
+	batch.value = graphics_timeline->next();
+	VkSemaphore graphics_semaphore = graphics_timeline->semaphore();
+
+	VkTimelineSemaphoreSubmitInfo acquire_timeline = VkTypeWrapper<VkTimelineSemaphoreSubmitInfo>{};
+	acquire_timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	acquire_timeline.waitSemaphoreValueCount = 1;
+	acquire_timeline.pWaitSemaphoreValues = &released;
+	acquire_timeline.signalSemaphoreValueCount = 1;
+	acquire_timeline.pSignalSemaphoreValues = &batch.value;
+
+	VkSubmitInfo acquire_info = VkTypeWrapper<VkSubmitInfo>{};
+	acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	acquire_info.pNext = &acquire_timeline;
+	acquire_info.waitSemaphoreCount = 1;
+	acquire_info.pWaitSemaphores = &transfer_semaphore;
+	acquire_info.pWaitDstStageMask = &wait_stage;
+	acquire_info.commandBufferCount = 1;
+	acquire_info.pCommandBuffers = &batch.acquire_command_buffer;
+	acquire_info.signalSemaphoreCount = 1;
+	acquire_info.pSignalSemaphores = &graphics_semaphore;
+
+	if (vkQueueSubmit(graphics_timeline->queue(), 1, &acquire_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+		fprintf(stderr, "failed to submit upload acquire!\n");
+		exit(1);
+	}
+}
+
+void UploadManager::wait(uint64_t ticket) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Regions recorded since the last flush belong to the next ticket
+	if (ticket >= next_ticket) {
+		flush_locked();
+	}
+
+	while (completed_ticket < ticket && !in_flight.empty()) {
+		retire(batches[in_flight.front()], true);
+	}
+}
+
+bool UploadManager::isComplete(uint64_t ticket) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	retire_completed();
+	return completed_ticket >= ticket;
+}
+
+}
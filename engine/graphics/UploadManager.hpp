@@ -0,0 +1,122 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "VkCommon.hpp"
+#include "QueueTimeline.hpp"
+#include "BarrierRecorder.hpp"
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Upload manager  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Staging ring shared by every upload
+#define UPLOAD_STAGING_SIZE (64ull * 1024 * 1024)
+// Command buffers cycled through by the flushes
+#define UPLOAD_BATCH_COUNT 4
+// Offsets of the staged data, enough for any texel block copied out of it later
+#define UPLOAD_STAGING_ALIGNMENT 16
+
+/*
+ * Batches host to device copies.
+ *
+ * Data is written into a persistently mapped staging ring and the copy is recorded as a region of
+ * the current batch; flush() submits every region recorded since the last flush in one command
+ * buffer (one vkCmdCopyBuffer per destination) and returns a ticket. The batch signals the next
+ * value of the graphics queue's timeline instead of idling the queue, staging space is reclaimed
+ * once the timeline reaches it, and wait() blocks until that one value. Like any vkCmdCopyBuffer,
+ * the regions of one batch must not overlap in their destination.
+ *
+ * On a device with a transfer only queue family the copies run there, overlapping rendering. The
+ * batch then ends by releasing every destination buffer to the graphics family and signals the
+ * transfer queue's timeline; a small command buffer submitted to the graphics queue waits for that
+ * value and acquires the buffers. Without such a family the copies go to the graphics queue and
+ * end with a plain barrier. Either way the writes are visible to vertex input and shaders of
+ * anything submitted to the graphics queue afterwards, without a CPU wait.
+ *
+ * The destinations are exclusive buffers not in use by the graphics queue (freshly created ones);
+ * copy() sources must not have been used by the graphics queue either. Submissions happen from the
+ * thread driving the frame loop, which is also the one taking the timelines' values.
+ */
+class UploadManager {
+public:
+    // The two timelines are the same when the device has no transfer only family. cmd_pipeline_barrier2
+    // null without synchronization2, see BarrierRecorder
+    void init(VkDevice device, QueueTimeline* transfer_timeline, uint32_t transfer_family, QueueTimeline* graphics_timeline,
+        uint32_t graphics_family, const DeviceResource& staging, PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2);
+    void destroy();
+
+    // Staging memory for size bytes that will land at dst_offset in dst, written by the caller
+    void* reserve(VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size);
+
+    // Copies data into staging, uploads bigger than the ring are split
+    void upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+    // Device to device copy recorded in the current batch
+    void copy(VkBuffer src, VkBuffer dst, const VkBufferCopy& region);
+
+    // Submits the current batch, returns its ticket (the last ticket when nothing was recorded)
+    uint64_t flush();
+
+    void wait(uint64_t ticket);
+    bool isComplete(uint64_t ticket);
+
+    VkDeviceSize capacity() const { return staging_size; }
+    bool usesTransferQueue() const { return ownership_transfer; }
+
+private:
+    struct PendingCopy {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+
+    struct Batch {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkCommandBuffer acquire_command_buffer = VK_NULL_HANDLE;    // graphics family, ownership transfer only
+        uint64_t value = 0;         // graphics timeline value reached once the whole batch is done
+        uint64_t ticket = 0;
+        uint64_t ring_end = 0;      // staging head when submitted
+        bool in_flight = false;
+    };
+
+    uint64_t flush_locked();
+    void submit_with_ownership_transfer(Batch& batch, const std::vector<VkBuffer>& buffers);
+    void retire(Batch& batch, bool block);
+    void retire_completed();
+
+    VkDevice device = VK_NULL_HANDLE;
+    QueueTimeline* timeline = nullptr;              // the copies' queue
+    QueueTimeline* graphics_timeline = nullptr;
+    uint32_t queue_family = 0;
+    uint32_t graphics_family = 0;
+    bool ownership_transfer = false;
+    // The batch being submitted, cleared after each
+    BarrierRecorder barriers;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandPool acquire_pool = VK_NULL_HANDLE;
+
+    VkBuffer staging_buffer = VK_NULL_HANDLE;
+    char* staging_mapped = nullptr;
+    VkDeviceSize staging_size = 0;
+
+    // Ever growing positions, the physical offset is position % staging_size
+    uint64_t ring_head = 0;
+    uint64_t ring_tail = 0;
+
+    Batch batches[UPLOAD_BATCH_COUNT];
+    uint32_t next_batch = 0;
+    std::deque<uint32_t> in_flight;     // oldest first
+
+    std::vector<PendingCopy> pending;
+    uint64_t next_ticket = 1;
+    uint64_t completed_ticket = 0;
+
+    std::mutex mutex;
+};
+
+}
@@ -0,0 +1,407 @@
+#include "VkCommon.hpp"
+
+namespace VK {
+
+// Ranges of one block, free_lists[order] holds the offsets of the free ranges of
+// VK_ALLOCATOR_MIN_ALLOCATION << order bytes
+struct MemoryBlock {
+	VkDeviceMemory memory{0};
+	void* mapped{nullptr};
+	uint32_t memory_type{0};
+	VkDeviceSize size{0};
+	bool optimal_tiling{false};
+	bool draining{false};       // emptied by the defragmenter, skipped by allocate()
+	VkDeviceSize used{0};
+	std::vector<std::set<VkDeviceSize>> free_lists;
+};
+
+static uint32_t order_of(VkDeviceSize size) {
+	uint32_t order = 0;
+	while ((VK_ALLOCATOR_MIN_ALLOCATION << order) < size) {
+		order++;
+	}
+	return order;
+}
+
+VkAllocator::~VkAllocator() {
+	destroy();
+}
+
+void VkAllocator::init(VkPhysicalDevice physical_device, VkDevice device, PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2) {
+	this->physical_device = physical_device;
+	this->device = device;
+	this->get_memory_properties2 = get_memory_properties2;
+
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	VkPhysicalDeviceProperties properties = VkTypeWrapper<VkPhysicalDeviceProperties>{};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	max_allocation_count = properties.limits.maxMemoryAllocationCount;
+
+	for (uint32_t type = 0; type < memory_properties.memoryTypeCount; type++) {
+		// At least 8 blocks per heap, a small heap would otherwise fit a single one
+		VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[type].heapIndex].size;
+		VkDeviceSize block_size = VK_ALLOCATOR_BLOCK_SIZE;
+		while (block_size > VK_ALLOCATOR_MIN_ALLOCATION * 64 && block_size * 8 > heap_size) {
+			block_size /= 2;
+		}
+
+		for (uint32_t tiling = 0; tiling < 2; tiling++) {
+			Pool& pool = pool_for(type, tiling != 0);
+			pool.block_size = block_size;
+			pool.order_count = order_of(block_size) + 1;
+		}
+	}
+}
+
+void VkAllocator::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (counters.allocation_count > 0) {
+		fprintf(stderr, "Device memory allocator destroyed with %u allocations alive\n", counters.allocation_count);
+	}
+
+	for (Pool& pool : pools) {
+		for (MemoryBlock* block : pool.blocks) {
+			destroy_block(block);
+		}
+		pool.blocks.clear();
+	}
+
+	counters = AllocatorStats{};
+}
+
+VkAllocator::Pool& VkAllocator::pool_for(uint32_t memory_type, bool optimal_tiling) {
+	return pools[memory_type * 2 + (optimal_tiling ? 1 : 0)];
+}
+
+bool VkAllocator::allocate_memory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory& memory, void*& mapped) {
+	if (max_allocation_count != 0 && device_allocation_count >= max_allocation_count) {
+		fprintf(stderr, "Reached maxMemoryAllocationCount (%u)\n", max_allocation_count);
+		return false;
+	}
+
+	VkMemoryAllocateInfo alloc_info = VkTypeWrapper<VkMemoryAllocateInfo>{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memory_type;
+
+	if (vkAllocateMemory(device, &alloc_info, host_allocation_callbacks(), &memory) != VK_SUCCESS) {
+		fprintf(stderr, "Failed to allocate %llu bytes of device memory\n", (unsigned long long) size);
+		return false;
+	}
+
+	mapped = nullptr;
+	if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+			fprintf(stderr, "Failed to map device memory\n");
+			vkFreeMemory(device, memory, host_allocation_callbacks());
+			return false;
+		}
+	}
+
+	device_allocation_count++;
+	heap_allocated[memory_properties.memoryTypes[memory_type].heapIndex] += size;
+	return true;
+}
+
+void VkAllocator::free_memory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory memory, void* mapped) {
+	if (mapped) {
+		vkUnmapMemory(device, memory);
+	}
+	vkFreeMemory(device, memory, host_allocation_callbacks());
+
+	device_allocation_count--;
+	heap_allocated[memory_properties.memoryTypes[memory_type].heapIndex] -= size;
+}
+
+MemoryBlock* VkAllocator::create_block(const Pool& pool, uint32_t memory_type, bool optimal_tiling) {
+	MemoryBlock* block = new MemoryBlock();
+
+	if (!allocate_memory(pool.block_size, memory_type, block->memory, block->mapped)) {
+		delete block;
+		return nullptr;
+	}
+	block->memory_type = memory_type;
+	block->size = pool.block_size;
+	block->optimal_tiling = optimal_tiling;
+
+	// The whole block starts as one free range of the top order
+	block->free_lists.resize(pool.order_count);
+	block->free_lists[pool.order_count - 1].insert(0);
+
+	counters.block_count++;
+	counters.block_bytes += pool.block_size;
+	return block;
+}
+
+void VkAllocator::destroy_block(MemoryBlock* block) {
+	free_memory(block->size, block->memory_type, block->memory, block->mapped);
+	delete block;
+}
+
+bool VkAllocator::allocate(const VkMemoryRequirements& requirements, uint32_t memory_type, bool optimal_tiling, MemoryAllocation& allocation) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Pool& pool = pool_for(memory_type, optimal_tiling);
+
+	allocation = MemoryAllocation{};
+	allocation.memory_type = memory_type;
+	allocation.optimal_tiling = optimal_tiling;
+
+	// ----- Dedicated allocation -----
+	if (requirements.size > pool.block_size / 2) {
+		if (!allocate_memory(requirements.size, memory_type, allocation.memory, allocation.mapped)) {
+			return false;
+		}
+
+		allocation.size = requirements.size;
+		heap_used[heapOf(memory_type)] += allocation.size;
+		counters.dedicated_count++;
+		counters.dedicated_bytes += requirements.size;
+		counters.allocation_count++;
+		return true;
+	}
+
+	// ----- Buddy sub-allocation -----
+	VkDeviceSize size = requirements.size > requirements.alignment ? requirements.size : requirements.alignment;
+	uint32_t order = order_of(size);
+
+	for (uint32_t attempt = 0; attempt < 2; attempt++) {
+		for (MemoryBlock* block : pool.blocks) {
+			if (block->draining) {
+				continue;
+			}
+
+			// Smallest free range that fits, split down to the requested order
+			uint32_t found = order;
+			while (found < pool.order_count && block->free_lists[found].empty()) {
+				found++;
+			}
+			if (found == pool.order_count) {
+				continue;
+			}
+
+			VkDeviceSize offset = *block->free_lists[found].begin();
+			block->free_lists[found].erase(block->free_lists[found].begin());
+
+			while (found > order) {
+				found--;
+				block->free_lists[found].insert(offset + (VK_ALLOCATOR_MIN_ALLOCATION << found));
+			}
+
+			allocation.memory = block->memory;
+			allocation.offset = offset;
+			allocation.size = VK_ALLOCATOR_MIN_ALLOCATION << order;
+			allocation.mapped = block->mapped ? (char*) block->mapped + offset : nullptr;
+			allocation.block = block;
+
+			block->used += allocation.size;
+			heap_used[heapOf(memory_type)] += allocation.size;
+			counters.used_bytes += allocation.size;
+			counters.allocation_count++;
+			return true;
+		}
+
+		// Every block is full, add one and try again
+		MemoryBlock* block = attempt == 0 ? create_block(pool, memory_type, optimal_tiling) : nullptr;
+		if (block == nullptr) {
+			break;
+		}
+		pool.blocks.push_back(block);
+	}
+
+	return false;
+}
+
+void VkAllocator::free(MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	counters.allocation_count--;
+	heap_used[heapOf(allocation.memory_type)] -= allocation.size;
+
+	if (allocation.block == nullptr) {
+		free_memory(allocation.size, allocation.memory_type, allocation.memory, allocation.mapped);
+
+		counters.dedicated_count--;
+		counters.dedicated_bytes -= allocation.size;
+		allocation = MemoryAllocation{};
+		return;
+	}
+
+	Pool& pool = pool_for(allocation.memory_type, allocation.optimal_tiling);
+	MemoryBlock* block = allocation.block;
+
+	// Merge with the buddy for as long as it is free too
+	VkDeviceSize offset = allocation.offset;
+	uint32_t order = order_of(allocation.size);
+
+	while (order + 1 < pool.order_count) {
+		VkDeviceSize buddy = offset ^ (VK_ALLOCATOR_MIN_ALLOCATION << order);
+		if (block->free_lists[order].erase(buddy) == 0) {
+			break;
+		}
+		offset = offset < buddy ? offset : buddy;
+		order++;
+	}
+	block->free_lists[order].insert(offset);
+
+	block->used -= allocation.size;
+	counters.used_bytes -= allocation.size;
+	allocation = MemoryAllocation{};
+
+	// Empty blocks go back to the driver, but one per pool is kept to absorb churn
+	if (block->used == 0 && (pool.blocks.size() > 1 || block->draining)) {
+		for (size_t i = 0; i < pool.blocks.size(); i++) {
+			if (pool.blocks[i] == block) {
+				pool.blocks.erase(pool.blocks.begin() + i);
+				break;
+			}
+		}
+
+		counters.block_count--;
+		counters.block_bytes -= pool.block_size;
+		destroy_block(block);
+	}
+}
+
+void VkAllocator::setDraining(MemoryBlock* block, bool draining) {
+	std::lock_guard<std::mutex> lock(mutex);
+	block->draining = draining;
+}
+
+bool VkAllocator::isDraining(const MemoryAllocation& allocation) {
+	if (allocation.block == nullptr) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return allocation.block->draining;
+}
+
+std::vector<BlockInfo> VkAllocator::blocks() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<BlockInfo> infos;
+	for (const Pool& pool : pools) {
+		for (MemoryBlock* block : pool.blocks) {
+			BlockInfo info;
+			info.block = block;
+			info.memory_type = block->memory_type;
+			info.optimal_tiling = block->optimal_tiling;
+			info.size = block->size;
+			info.used = block->used;
+			info.draining = block->draining;
+			infos.push_back(info);
+		}
+	}
+	return infos;
+}
+
+FragmentationStats VkAllocator::fragmentation() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	/*
+	 * Free space of one pool can't serve another's allocations, each pool is measured against its
+	 * own largest range. Weighted by free bytes the pools' values add up to
+	 * 1 - sum(largest per pool) / free bytes
+	 */
+	FragmentationStats fragmentation;
+	VkDeviceSize largest_per_pool = 0;
+	for (const Pool& pool : pools) {
+		VkDeviceSize pool_largest = 0;
+		for (MemoryBlock* block : pool.blocks) {
+			fragmentation.block_count++;
+			fragmentation.block_bytes += block->size;
+			fragmentation.free_bytes += block->size - block->used;
+
+			// The highest order with a free range is the largest one of the block
+			for (uint32_t order = pool.order_count; order-- > 0;) {
+				if (!block->free_lists[order].empty()) {
+					VkDeviceSize largest = VK_ALLOCATOR_MIN_ALLOCATION << order;
+					if (largest > pool_largest) {
+						pool_largest = largest;
+					}
+					break;
+				}
+			}
+		}
+
+		largest_per_pool += pool_largest;
+		if (pool_largest > fragmentation.largest_free) {
+			fragmentation.largest_free = pool_largest;
+		}
+	}
+
+	if (fragmentation.free_bytes > 0) {
+		fragmentation.fragmentation = 1.0f - (float) largest_per_pool / (float) fragmentation.free_bytes;
+	}
+	return fragmentation;
+}
+
+AllocatorStats VkAllocator::stats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+bool VkAllocator::heapBudget(uint32_t heap, HeapBudget& budget) {
+	if (heap >= memory_properties.memoryHeapCount) {
+		return false;
+	}
+
+	budget = HeapBudget{};
+	budget.size = memory_properties.memoryHeaps[heap].size;
+	budget.device_local = (memory_properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		budget.allocated = heap_allocated[heap];
+		budget.used = heap_used[heap];
+	}
+
+	if (get_memory_properties2) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = VkTypeWrapper<VkPhysicalDeviceMemoryBudgetPropertiesEXT>{};
+		budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 properties = VkTypeWrapper<VkPhysicalDeviceMemoryProperties2>{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget_properties;
+
+		get_memory_properties2(physical_device, &properties);
+
+		// Some drivers leave heaps they don't track at zero
+		if (budget_properties.heapBudget[heap] > 0) {
+			budget.budget = budget_properties.heapBudget[heap];
+			budget.usage = budget_properties.heapUsage[heap];
+			budget.reported = true;
+			return true;
+		}
+	}
+
+	budget.budget = (VkDeviceSize) (budget.size * VK_ALLOCATOR_DEFAULT_BUDGET);
+	budget.usage = budget.allocated;
+	return true;
+}
+
+void VkAllocator::printBudgets() {
+	for (uint32_t heap = 0; heap < memory_properties.memoryHeapCount; heap++) {
+		HeapBudget budget;
+		heapBudget(heap, budget);
+		printf(" Heap %u%s: %.1f / %.1f MiB (%.1f MiB ours)%s\n", heap, budget.device_local ? " (device local)" : "",
+			budget.usage / (1024.0 * 1024.0), budget.budget / (1024.0 * 1024.0), budget.allocated / (1024.0 * 1024.0),
+			budget.reported ? "" : ", estimated");
+	}
+}
+
+void VkAllocator::printStats() {
+	AllocatorStats current = stats();
+	printf(" Device memory: %u allocations, %u blocks (%.1f / %.1f MiB used), %u dedicated (%.1f MiB)\n",
+		current.allocation_count, current.block_count, current.used_bytes / (1024.0 * 1024.0),
+		current.block_bytes / (1024.0 * 1024.0), current.dedicated_count, current.dedicated_bytes / (1024.0 * 1024.0));
+}
+
+}
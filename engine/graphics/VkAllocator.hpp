@@ -0,0 +1,151 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <vector>
+
+extern "C" {
+	#include <vulkan/vulkan.h>
+	#include <stdio.h>
+	#include <stdbool.h>
+	#include <stdint.h>
+}
+
+namespace VK {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Device memory  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Size of the VkDeviceMemory blocks sub-allocated from, smaller on heaps that could not hold 8
+#define VK_ALLOCATOR_BLOCK_SIZE (64ull * 1024 * 1024)
+// Smallest range handed out, every range is a power of two and aligned to its size
+#define VK_ALLOCATOR_MIN_ALLOCATION 256ull
+
+struct MemoryBlock;
+
+// Range of device memory backing one resource
+struct MemoryAllocation {
+    VkDeviceMemory memory{0};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};           // reserved, at least what the resource asked for
+    void* mapped{nullptr};          // host visible memory stays mapped, points at offset
+    uint32_t memory_type{0};
+    bool optimal_tiling{false};
+    MemoryBlock* block{nullptr};    // nullptr for a dedicated allocation
+};
+
+struct AllocatorStats {
+    uint32_t block_count = 0;
+    uint32_t dedicated_count = 0;
+    uint32_t allocation_count = 0;  // live sub-allocations and dedicated ones
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize dedicated_bytes = 0;
+    VkDeviceSize used_bytes = 0;    // sub-allocated out of the blocks
+};
+
+// Free space of the blocks, the dedicated allocations are left out
+struct FragmentationStats {
+    uint32_t block_count = 0;
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize free_bytes = 0;
+    VkDeviceSize largest_free = 0;  // biggest range a single sub-allocation can still get, in any pool
+    float fragmentation = 0.0f;     // per pool 1 - largest range / free bytes, weighted by free bytes
+                                    // 0 when each pool's free space is one range
+};
+
+// One block as seen by the defragmenter
+struct BlockInfo {
+    MemoryBlock* block = nullptr;
+    uint32_t memory_type = 0;
+    bool optimal_tiling = false;
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    bool draining = false;
+};
+
+// Memory of one heap, as reported by VK_EXT_memory_budget or estimated from our own allocations
+struct HeapBudget {
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;        // what the process can use before allocations start failing or paging
+    VkDeviceSize usage = 0;         // by the whole process, drivers and other APIs included when reported
+    VkDeviceSize allocated = 0;     // VkDeviceMemory allocated by this allocator
+    VkDeviceSize used = 0;          // of allocated, handed out to resources, the rest is free ranges of blocks
+    bool device_local = false;
+    bool reported = false;          // budget and usage come from the driver
+};
+
+// Share of a heap's size used as its budget when the driver does not report one
+#define VK_ALLOCATOR_DEFAULT_BUDGET 0.8
+
+/*
+ * Buddy allocator over large VkDeviceMemory blocks.
+ *
+ * Each memory type has two pools, one for buffers and linear images and one for optimal tiling
+ * images, so neighbouring ranges never need bufferImageGranularity padding. A request is rounded
+ * up to a power of two no smaller than its alignment; since buddies are aligned to their size,
+ * every range meets its alignment for free. Resources bigger than half a block get memory of
+ * their own.
+ *
+ * Blocks of host visible types are mapped once when created and stay mapped, callers use the
+ * mapped pointer of their allocation instead of vkMapMemory.
+ */
+class VkAllocator {
+public:
+    VkAllocator() = default;
+    ~VkAllocator();
+
+    VkAllocator(const VkAllocator&) = delete;
+    void operator=(const VkAllocator&) = delete;
+
+    // get_memory_properties2 is vkGetPhysicalDeviceMemoryProperties2(KHR) when VK_EXT_memory_budget is
+    // enabled on the device, NULL to rely on our own accounting
+    void init(VkPhysicalDevice physical_device, VkDevice device, PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2);
+    void destroy();
+
+    bool allocate(const VkMemoryRequirements& requirements, uint32_t memory_type, bool optimal_tiling, MemoryAllocation& allocation);
+    void free(MemoryAllocation& allocation);
+
+    // Draining blocks get no new allocations, they are released once their last range is freed
+    void setDraining(MemoryBlock* block, bool draining);
+    bool isDraining(const MemoryAllocation& allocation);
+    std::vector<BlockInfo> blocks();
+    FragmentationStats fragmentation();
+
+    AllocatorStats stats();
+
+    uint32_t heapCount() const { return memory_properties.memoryHeapCount; }
+    uint32_t heapOf(uint32_t memory_type) const { return memory_properties.memoryTypes[memory_type].heapIndex; }
+    // Queries the driver every call when it reports budgets, meant for once a frame
+    bool heapBudget(uint32_t heap, HeapBudget& budget);
+    void printBudgets();
+    void printStats();
+
+private:
+    struct Pool {
+        VkDeviceSize block_size = 0;
+        uint32_t order_count = 0;
+        std::vector<MemoryBlock*> blocks;
+    };
+
+    Pool& pool_for(uint32_t memory_type, bool optimal_tiling);
+    MemoryBlock* create_block(const Pool& pool, uint32_t memory_type, bool optimal_tiling);
+    void destroy_block(MemoryBlock* block);
+    bool allocate_memory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory& memory, void*& mapped);
+    void free_memory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory memory, void* mapped);
+
+    VkPhysicalDevice physical_device{0};
+    VkDevice device{0};
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2{nullptr};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    uint32_t max_allocation_count = 0;
+    uint32_t device_allocation_count = 0;  // VkDeviceMemory objects alive
+    VkDeviceSize heap_allocated[VK_MAX_MEMORY_HEAPS] = {0};
+    VkDeviceSize heap_used[VK_MAX_MEMORY_HEAPS] = {0};
+
+    std::mutex mutex;
+    Pool pools[VK_MAX_MEMORY_TYPES * 2];
+    AllocatorStats counters;
+};
+
+}
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <vector>
+
+#include "VkAllocator.hpp"
+#include "HostAllocator.hpp"
+
 extern "C" {
 	#include <SDL3/SDL.h>
 	#include <SDL3/SDL_vulkan.h>
 	#include <vulkan/vulkan.h>
 	#include "io.h"
+	#include "archive.h"
+	#include "meshfile.h"
 	#include <stdio.h>
 	#include <stdbool.h>
 	#include <stdlib.h>
@@ -28,8 +35,10 @@ namespace VK{
 struct QueueFamilyIndices {
     uint32_t graphics_family;
     uint32_t present_family;
+    uint32_t transfer_family;       // transfer only, uploads run there when the device has one
 	bool has_graphics_family;
 	bool has_present_family;
+	bool has_transfer_family;
 };
 
 struct SwapChainSupportDetails {
@@ -51,16 +60,17 @@ struct VkConfiguration {
 // Data structures
 
 struct Vertex {
-	vec2 pos;
+	vec3 pos;
 	vec3 color;
 };
 
-template <uint32_t Vertices, uint32_t Indices>
-struct Mesh {
-	Vertex vertices[Vertices];
-	uint16_t indices[Indices];
-	uint32_t vertex_count = Vertices;
-	uint32_t index_count = Indices;
+// Runtime mesh, sized by whatever was imported
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<mesh_file_submesh> submeshes;
+	vec3 bounds_min = {0.0f, 0.0f, 0.0f};
+	vec3 bounds_max = {0.0f, 0.0f, 0.0f};
 };
 
 struct UniformBufferObject {
@@ -71,15 +81,9 @@ struct UniformBufferObject {
 
 struct DeviceResource {
 	VkBuffer buffer{0};
-	VkDeviceMemory memory{0};
 	VkDeviceSize size{0};
-};
-
-template <uint32_t Vertices, uint32_t Indices>
-struct DeviceMesh {
-	Mesh<Vertices, Indices> mesh;
-	DeviceResource vertexResource;
-	DeviceResource indicesResource;
+	MemoryAllocation allocation;    // block, offset and mapped pointer of the backing memory
+	uint64_t last_used_frame{0};    // stamped by the frames using it, drives residency eviction
 };
 
 // Wrapper for vulkan types with initialization
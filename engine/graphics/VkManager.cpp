@@ -1,22 +1,29 @@
 #include "VkManager.hpp"
+#include "engine/io/MeshImporter.hpp"
 
-#define NUM_VERTICES 4
-#define NUM_VERTEX_INDICES 6
-
-VK::Mesh<NUM_VERTICES, NUM_VERTEX_INDICES> mesh = {
+// Shown until a model is loaded
+VK::MeshData mesh = {
 	.vertices = {
-    	{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-    	{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-    	{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-    	{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}},
-	.indices = {0, 1, 2, 2, 3, 0}
+    	{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+    	{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+    	{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+    	{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}}},
+	.indices = {0, 1, 2, 2, 3, 0},
+	.bounds_min = {-0.5f, -0.5f, 0.0f},
+	.bounds_max = {0.5f, 0.5f, 0.0f}
 };
 
-VK::DeviceResource vertexResource;
-VK::DeviceResource indexResource;
-VK::DeviceResource uniformResources[MAX_FRAMES_IN_FLIGHT];
+// Indices in the index buffer, a mesh loaded from a .mesh file keeps no CPU copy
+uint32_t mesh_index_count = 0;
 
-void* uniform_buffers_mapped[MAX_FRAMES_IN_FLIGHT] = {0};
+// Shader variants the graphics pipeline is built from, vertex then fragment
+static const struct {
+	VK::ShaderId id;
+	uint32_t key;
+} pipeline_shaders[] = {
+	{VK::ShaderId::shader_vert, VK::shader_vert_axes::VERTEX_COLOR},
+	{VK::ShaderId::shader_frag, VK::shader_frag_axes::VERTEX_COLOR},
+};
 
 namespace VK {
 
@@ -81,6 +88,38 @@ char const * const * get_required_extensions(const VkConfiguration& config, uint
 	return (char const * const *) extensions;
 }
 
+bool has_instance_extension(const char* name) {
+	uint32_t extension_count;
+	vkEnumerateInstanceExtensionProperties(NULL, &extension_count, NULL);
+
+	VkExtensionProperties* available_extensions = new VkExtensionProperties[extension_count];
+	vkEnumerateInstanceExtensionProperties(NULL, &extension_count, available_extensions);
+
+	bool found = false;
+	for (uint32_t i = 0; i < extension_count && !found; i++) {
+		found = strcmp(name, available_extensions[i].extensionName) == 0;
+	}
+
+	delete[] available_extensions;
+	return found;
+}
+
+bool has_device_extension(VkPhysicalDevice device, const char* name) {
+	uint32_t extension_count;
+	vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, NULL);
+
+	VkExtensionProperties* available_extensions = new VkExtensionProperties[extension_count];
+	vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, available_extensions);
+
+	bool found = false;
+	for (uint32_t i = 0; i < extension_count && !found; i++) {
+		found = strcmp(name, available_extensions[i].extensionName) == 0;
+	}
+
+	delete[] available_extensions;
+	return found;
+}
+
 void free_swap_chain_support(VK::SwapChainSupportDetails* details) {
 	delete[] details->formats;
 	delete[] details->present_modes;
@@ -116,7 +155,7 @@ VkVertexInputAttributeDescription* get_attribute_descriptions(size_t* count) {
 	
 	attribute_descriptions[0].binding = 0;
 	attribute_descriptions[0].location = 0;
-	attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+	attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
 	attribute_descriptions[0].offset = offsetof(VK::Vertex, pos);
 
 	attribute_descriptions[1].binding = 0;
@@ -152,6 +191,16 @@ void VkManager::waitIdle() {
 }
 
 uint32_t VkManager::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+    uint32_t memory_type;
+    if (!find_memory_type(type_filter, properties, memory_type)) {
+        fprintf(stderr, "failed to find suitable memory type!");
+        exit(1);
+    }
+
+    return memory_type;
+}
+
+bool VkManager::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, uint32_t& memory_type) {
     /*
     * See https://vulkan-tutorial.com/Vertex_buffers/Staging_buffer#page_Memory_types
     * for an explanation of how this works
@@ -162,12 +211,51 @@ uint32_t VkManager::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags
     for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
         if ((type_filter & (1 << i))
                 && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+            memory_type = i;
+            return true;
         }
     }
 
-    fprintf(stderr, "failed to find suitable memory type!");
-    exit(1);
+    return false;
+}
+
+bool VkManager::has_memory_type(VkMemoryPropertyFlags properties) {
+	VkPhysicalDeviceMemoryProperties mem_properties = VkTypeWrapper<VkPhysicalDeviceMemoryProperties>{};
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+	for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+		if ((mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool VkManager::detect_direct_upload(bool& cached) {
+	/*
+	 * Device local memory the CPU can write is only worth uploading into directly when it covers
+	 * the whole of VRAM (integrated GPUs, resizable BAR, software rasterizers); the 256 MiB BAR
+	 * window of a discrete GPU is too small to hold every resource
+	 */
+	VkPhysicalDeviceMemoryProperties mem_properties = VkTypeWrapper<VkPhysicalDeviceMemoryProperties>{};
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+	VkDeviceSize largest_device_heap = 0;
+	for (uint32_t i = 0; i < mem_properties.memoryHeapCount; i++) {
+		if ((mem_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && mem_properties.memoryHeaps[i].size > largest_device_heap) {
+			largest_device_heap = mem_properties.memoryHeaps[i].size;
+		}
+	}
+
+	uint32_t memory_type;
+	if (!find_memory_type(~0u, DIRECT_UPLOAD_MEMORY_PROPERTIES, memory_type)) {
+		return false;
+	}
+
+	const VkMemoryType& type = mem_properties.memoryTypes[memory_type];
+	cached = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+	return mem_properties.memoryHeaps[type.heapIndex].size >= largest_device_heap;
 }
 
 VK::QueueFamilyIndices VkManager::find_queue_families(VkPhysicalDevice device) {
@@ -198,6 +286,19 @@ VK::QueueFamilyIndices VkManager::find_queue_families(VkPhysicalDevice device) {
 		}
 	}
 
+	// A family that can copy but not draw is backed by the DMA engines, prefer one without compute
+	for (uint32_t i = 0; i < queue_family_count; i++) {
+		VkQueueFlags flags = queue_families[i].queueFlags;
+		if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+			continue;
+		}
+
+		if (!indices.has_transfer_family || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+			indices.transfer_family = i;
+			indices.has_transfer_family = true;
+		}
+	}
+
 	delete[] queue_families;
 
 	return indices;
@@ -270,6 +371,28 @@ VkPhysicalDevice VkManager::pick_physical_device() {
 		if (!required_extensions_supported) {
 			continue;
 		}
+
+		// Frame pacing and uploads wait on timeline semaphores
+		VkPhysicalDeviceProperties properties = VkTypeWrapper<VkPhysicalDeviceProperties>{};
+		vkGetPhysicalDeviceProperties(devices[i], &properties);
+
+		if (properties.apiVersion < REQUIRED_VULKAN_VERSION) {
+			printf("  Vulkan %u.%u not supported\n", VK_API_VERSION_MAJOR(REQUIRED_VULKAN_VERSION), VK_API_VERSION_MINOR(REQUIRED_VULKAN_VERSION));
+			continue;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12_features = VkTypeWrapper<VkPhysicalDeviceVulkan12Features>{};
+		vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features = VkTypeWrapper<VkPhysicalDeviceFeatures2>{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &vulkan12_features;
+		vkGetPhysicalDeviceFeatures2(devices[i], &features);
+
+		if (!vulkan12_features.timelineSemaphore) {
+			printf("  Timeline semaphores not supported\n");
+			continue;
+		}
 		
 		VK::SwapChainSupportDetails swap_chain_support = query_swap_chain_support(devices[i]);
 		bool swap_chain_adequate = swap_chain_support.formats_count > 0 && swap_chain_support.present_modes_count > 0;
@@ -339,7 +462,7 @@ void VkManager::create_image_views() {
 		create_info.subresourceRange.baseArrayLayer = 0;
 		create_info.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(device, &create_info, NULL, &swap_chain_image_views[i]) != VK_SUCCESS) {
+		if (vkCreateImageView(device, &create_info, host_allocation_callbacks(), &swap_chain_image_views[i]) != VK_SUCCESS) {
 			fprintf(stderr, "failed to create image views!");
 			exit(1);
 		}
@@ -350,7 +473,7 @@ void VkManager::create_image_views() {
 
 void VkManager::cleanup_image_views() {
 	for (size_t i = 0; i < swap_chain_image_views_count; i++) {
-		vkDestroyImageView(device, swap_chain_image_views[i], NULL);
+		vkDestroyImageView(device, swap_chain_image_views[i], host_allocation_callbacks());
 	}
 
 	delete[] swap_chain_image_views;
@@ -376,7 +499,7 @@ void VkManager::create_framebuffers() {
 		framebuffer_info.height = swap_chain_extent.height;
 		framebuffer_info.layers = 1;
 
-		if (vkCreateFramebuffer(device, &framebuffer_info, NULL, &swap_chain_framebuffers[i]) != VK_SUCCESS) {
+		if (vkCreateFramebuffer(device, &framebuffer_info, host_allocation_callbacks(), &swap_chain_framebuffers[i]) != VK_SUCCESS) {
 			fprintf(stderr, "failed to create framebuffer!");
 			exit(1);
 		}
@@ -387,7 +510,7 @@ void VkManager::create_framebuffers() {
 
 void VkManager::cleanup_framebuffers() {
 	for (size_t i = 0; i < swap_chain_framebuffers_count; i++) {
-		vkDestroyFramebuffer(device, swap_chain_framebuffers[i], NULL);
+		vkDestroyFramebuffer(device, swap_chain_framebuffers[i], host_allocation_callbacks());
 	}
 
 	delete[] swap_chain_framebuffers;
@@ -463,7 +586,7 @@ void VkManager::create_swap_chain() {
 	create_info.presentMode = present_mode;
 	create_info.clipped = VK_TRUE;
 
-	if (vkCreateSwapchainKHR(device, &create_info, NULL, &swap_chain) != VK_SUCCESS) {
+	if (vkCreateSwapchainKHR(device, &create_info, host_allocation_callbacks(), &swap_chain) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create swap chain!");
 		exit(1);
 	}
@@ -483,7 +606,7 @@ void VkManager::cleanup_swap_chain(void) {
 	printf("Cleaning up swap chain\n");
 	cleanup_framebuffers();
 	cleanup_image_views();
-	vkDestroySwapchainKHR(device, swap_chain, NULL);
+	vkDestroySwapchainKHR(device, swap_chain, host_allocation_callbacks());
 }
 
 void VkManager::recreate_swap_chain() {
@@ -492,27 +615,19 @@ void VkManager::recreate_swap_chain() {
 
 	vkDeviceWaitIdle(device);
 
+	// Recorded against the old framebuffers, and the image count may change
+	cleanup_command_buffers();
 	cleanup_swap_chain();
 
 	create_swap_chain();
 	create_image_views();
 	create_framebuffers();
+	create_command_buffers();
 }
 
 void VkManager::create_graphics_pipeline(void) {
-	size_t vert_shader_code_size;
-	char* vert_shader_code = read_entire_binary_file("shaders/shader.vert.spv", &vert_shader_code_size);
-	printf(" Read %zu bytes\n", vert_shader_code_size);
-
-	VkShaderModule vert_shader_module = create_shader_module(vert_shader_code, vert_shader_code_size);
-	free(vert_shader_code);
-
-	size_t frag_shader_code_size;
-	char* frag_shader_code = read_entire_binary_file("shaders/shader.frag.spv", &frag_shader_code_size);
-	printf(" Read %zu bytes\n", frag_shader_code_size);
-
-	VkShaderModule frag_shader_module = create_shader_module(frag_shader_code, frag_shader_code_size);
-	free(frag_shader_code);
+	VkShaderModule vert_shader_module = load_shader_variant(pipeline_shaders[0].id, pipeline_shaders[0].key);
+	VkShaderModule frag_shader_module = load_shader_variant(pipeline_shaders[1].id, pipeline_shaders[1].key);
 
 	VkPipelineShaderStageCreateInfo vert_shader_stage_info = VkTypeWrapper<VkPipelineShaderStageCreateInfo>{};
 	vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -593,7 +708,7 @@ void VkManager::create_graphics_pipeline(void) {
 	pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
 	pipeline_layout_info.pushConstantRangeCount = 0;
 
-	if (vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &pipeline_layout) != VK_SUCCESS) {
+	if (vkCreatePipelineLayout(device, &pipeline_layout_info, host_allocation_callbacks(), &pipeline_layout) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create pipeline layout!");
 		exit(1);
 	}
@@ -614,13 +729,13 @@ void VkManager::create_graphics_pipeline(void) {
 	pipeline_info.subpass = 0;
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &graphics_pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, host_allocation_callbacks(), &graphics_pipeline) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create graphics pipeline!");
 		exit(1);
 	}
 
-	vkDestroyShaderModule(device, frag_shader_module, NULL);
-	vkDestroyShaderModule(device, vert_shader_module, NULL);
+	vkDestroyShaderModule(device, frag_shader_module, host_allocation_callbacks());
+	vkDestroyShaderModule(device, vert_shader_module, host_allocation_callbacks());
 
 
 	delete[] attribute_descriptions;
@@ -628,14 +743,60 @@ void VkManager::create_graphics_pipeline(void) {
 	printf(" VK pipeline created\n");
 }
 
-VkShaderModule VkManager::create_shader_module(const char* code, size_t code_size) {
+static void shader_override_path(const char* override_dir, const char* name, char* path, size_t path_size) {
+	const char* base_name = strrchr(name, '/');
+	base_name = base_name ? base_name + 1 : name;
+
+	SDL_snprintf(path, path_size, "%s/%s", override_dir, base_name);
+}
+
+void VkManager::prefetch_shader_overrides() {
+	/*
+	 * Override shaders are read on the I/O workers while the instance and device are created,
+	 * load_shader_override() claims them. Embedded and archived ones need no read
+	 */
+	const char* override_dir = SDL_getenv(SHADER_DIR_ENV);
+	if (override_dir == NULL || override_dir[0] == '\0' || !IO::AsyncLoader::isRunning()) {
+		return;
+	}
+
+	const uint32_t shader_count = sizeof(pipeline_shaders) / sizeof(pipeline_shaders[0]);
+	char paths[shader_count][1024];
+	IO::ReadRequest requests[shader_count];
+	const char* names[shader_count];
+	uint32_t request_count = 0;
+
+	for (uint32_t i = 0; i < shader_count; i++) {
+		const EmbeddedShader* variant = get_shader_variant(pipeline_shaders[i].id, pipeline_shaders[i].key);
+		if (variant == NULL) {
+			continue;
+		}
+
+		shader_override_path(override_dir, variant->name, paths[request_count], sizeof(paths[request_count]));
+		requests[request_count].path = paths[request_count];
+		names[request_count] = variant->name;
+		request_count++;
+	}
+
+	if (request_count == 0) {
+		return;
+	}
+
+	// Tickets of a batch follow each other
+	uint64_t ticket = IO::AsyncLoader::instance().submit(requests, request_count);
+	for (uint32_t i = 0; i < request_count; i++) {
+		shader_override_reads[names[i]] = ticket + i;
+	}
+}
+
+VkShaderModule VkManager::create_shader_module(const void* code, size_t code_size) {
 	VkShaderModuleCreateInfo create_info = VkTypeWrapper<VkShaderModuleCreateInfo>{};
 	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	create_info.codeSize = code_size;
 	create_info.pCode = (const uint32_t*)code;
 
 	VkShaderModule shader_module;
-	if (vkCreateShaderModule(device, &create_info, NULL, &shader_module) != VK_SUCCESS) {
+	if (vkCreateShaderModule(device, &create_info, host_allocation_callbacks(), &shader_module) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create shader module!");
 		exit(1);
 	}
@@ -643,8 +804,108 @@ VkShaderModule VkManager::create_shader_module(const char* code, size_t code_siz
 	return shader_module;
 }
 
+VkShaderModule VkManager::load_shader_variant(ShaderId id, uint32_t key) {
+	// Direct index into the generated table, no name lookup
+	const EmbeddedShader* variant = get_shader_variant(id, key);
+	if (variant == NULL) {
+		fprintf(stderr, "shader %s has no variant %u!\n", shader_variant_tables[(uint32_t) id].name, key);
+		exit(1);
+	}
+
+	// Variants are only ever embedded, the build packs and copies none of them
+	VkShaderModule shader_module;
+	if (load_shader_override(variant->name, shader_module)) {
+		return shader_module;
+	}
+
+	return create_shader_module(variant->code, variant->size);
+}
+
+bool VkManager::load_shader_override(const char* name, VkShaderModule& shader_module) {
+	const char* override_dir = SDL_getenv(SHADER_DIR_ENV);
+	if (override_dir == NULL || override_dir[0] == '\0') {
+		return false;
+	}
+
+	char path[1024];
+	shader_override_path(override_dir, name, path, sizeof(path));
+
+	// Read ahead by prefetch_shader_overrides()
+	auto prefetched = shader_override_reads.find(name);
+	if (prefetched != shader_override_reads.end()) {
+		IO::AsyncLoader& loader = IO::AsyncLoader::instance();
+		IO::ReadResult result;
+		bool read = loader.wait(prefetched->second, &result);
+		shader_override_reads.erase(prefetched);
+
+		if (read) {
+			printf(" Loaded %s from %s (%llu bytes)\n", name, path, (unsigned long long) result.size);
+
+			shader_module = create_shader_module(result.data, result.size);
+			loader.release(result);
+			return true;
+		}
+		loader.release(result);
+	}
+
+	file_view view;
+	if (map_file_view(path, FILE_VIEW_HINT_SEQUENTIAL, &view)) {
+		printf(" Loaded %s from %s (%zu bytes)\n", name, path, view.size);
+
+		shader_module = create_shader_module(view.data, view.size);
+		release_file_view(&view);
+		return true;
+	}
+
+	fprintf(stderr, "Shader override %s not found, falling back\n", path);
+	return false;
+}
+
+VkShaderModule VkManager::load_shader_module(const char* name) {
+	VkShaderModule shader_module;
+	if (load_shader_override(name, shader_module)) {
+		return shader_module;
+	}
+
+	// Built-in shaders are part of the binary, nothing to read
+	const EmbeddedShader* embedded = find_embedded_shader(name);
+	if (embedded != NULL) {
+		printf(" Using embedded %s (%zu bytes)\n", name, embedded->size);
+		return create_shader_module(embedded->code, embedded->size);
+	}
+
+	// The archive is mapped once for the whole run, the blob goes straight to the driver
+	archive_blob blob;
+	if (archive_find(&asset_archive, name, &blob)) {
+		printf(" Loaded %s from archive (%zu bytes)\n", name, blob.size);
+		return create_shader_module(blob.data, blob.size);
+	}
+
+	// The mapped view is handed straight to the driver, no intermediate heap copy
+	file_view view;
+	if (!map_file_view(name, FILE_VIEW_HINT_SEQUENTIAL | FILE_VIEW_HINT_WILLNEED, &view)) {
+		fprintf(stderr, "failed to load shader %s!\n", name);
+		exit(1);
+	}
+	printf(" Mapped %s (%zu bytes)\n", name, view.size);
+
+	VkShaderModule shader_module = create_shader_module(view.data, view.size);
+	release_file_view(&view);
+
+	return shader_module;
+}
+
 DeviceResource VkManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
 	DeviceResource resource;
+	if (!tryCreateBuffer(size, usage, properties, resource)) {
+		exit(1);
+	}
+
+    return resource;
+}
+
+bool VkManager::tryCreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, DeviceResource& resource) {
+	resource = DeviceResource{};
     
     VkBufferCreateInfo buffer_info = VkTypeWrapper<VkBufferCreateInfo>{};
 	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -652,85 +913,481 @@ DeviceResource VkManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usa
 	buffer_info.usage = usage;  
 	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkCreateBuffer(device, &buffer_info, NULL, &(resource.buffer)) != VK_SUCCESS) {
+	if (vkCreateBuffer(device, &buffer_info, host_allocation_callbacks(), &(resource.buffer)) != VK_SUCCESS) {
 		fprintf(stderr, "Failed to create buffer");
-		exit(1);
+		return false;
 	}
 
 	VkMemoryRequirements mem_requirements = VkTypeWrapper<VkMemoryRequirements>{};
 	vkGetBufferMemoryRequirements(device, resource.buffer, &mem_requirements);
 
-	VkMemoryAllocateInfo alloc_info = VkTypeWrapper<VkMemoryAllocateInfo>{};
-	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	alloc_info.allocationSize = mem_requirements.size;
-	alloc_info.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device, &alloc_info, NULL, &(resource.memory)) != VK_SUCCESS) {
+	uint32_t memory_type;
+	if (!find_memory_type(mem_requirements.memoryTypeBits, properties, memory_type)
+		|| !allocator.allocate(mem_requirements, memory_type, false, resource.allocation)) {
 		fprintf(stderr, "Failed to allocate buffer memory");
-		exit(1);
+		vkDestroyBuffer(device, resource.buffer, host_allocation_callbacks());
+		resource.buffer = VK_NULL_HANDLE;
+		return false;
 	}
 
-	vkBindBufferMemory(device, resource.buffer, resource.memory, 0);
+	vkBindBufferMemory(device, resource.buffer, resource.allocation.memory, resource.allocation.offset);
 	resource.size = size;
-    return resource;
+    return true;
 }
 
-void VkManager::copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) {
+bool VkManager::create_direct_buffer(VkDeviceSize size, VkBufferUsageFlags usage, DeviceResource& resource) {
 	/*
-	 * Copy buffers - used to copy from staging buffer into vertext buffer
+	 * Device local buffer the CPU writes into, no staging copy needed. Fails when the device has
+	 * no such memory or it is full, the caller then goes through the upload manager
 	 */
-	VkCommandBufferAllocateInfo alloc_info = VkTypeWrapper<VkCommandBufferAllocateInfo>{};
-	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	alloc_info.commandPool = command_pool;
-	alloc_info.commandBufferCount = 1;
-
-	VkCommandBuffer command_buffer = VkTypeWrapper<VkCommandBuffer>{};
-	vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
+	if (!direct_upload) {
+		return false;
+	}
 
-	VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
-	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (!tryCreateBuffer(size, usage, DIRECT_UPLOAD_MEMORY_PROPERTIES, resource)) {
+		fprintf(stderr, " - staging instead\n");
+		return false;
+	}
 
-	vkBeginCommandBuffer(command_buffer, &begin_info);
+	return true;
+}
 
+void VkManager::copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) {
+	/*
+	 * Copy buffers - recorded into the upload manager's batch, waits for that batch only
+	 */
 	VkBufferCopy copy_region = VkTypeWrapper<VkBufferCopy>{};
 	copy_region.size = size;
-	vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
 
-	vkEndCommandBuffer(command_buffer);
+	uploader.copy(src_buffer, dst_buffer, copy_region);
+	uploader.wait(uploader.flush());
+}
 
-	VkSubmitInfo submit_info = VkTypeWrapper<VkSubmitInfo>{};
-	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &command_buffer;
+DeviceResource VkManager::uploadCompressedBuffer(const void* data, size_t size, VkBufferUsageFlags usage) {
+	/*
+	 * Decompress a block compressed payload straight into a mapped staging buffer, then copy it
+	 * into device local memory
+	 */
+	compressed_asset asset;
+	if (!compressed_asset_parse(data, size, &asset)) {
+		fprintf(stderr, "Failed to parse compressed buffer\n");
+		exit(1);
+	}
+
+	VkDeviceSize raw_size = asset.header->raw_size;
+	DeviceResource resource;
 
-	vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphics_queue);
+	// Decoded straight into the buffer when the CPU can write device local memory
+	if (create_direct_buffer(raw_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, resource)) {
+		if (!IO::decompress_parallel(asset, resource.allocation.mapped, Core::ThreadPool::shared(), direct_upload_cached)) {
+			fprintf(stderr, "Failed to decompress buffer\n");
+			exit(1);
+		}
+		return resource;
+	}
+
+	resource = createBuffer(raw_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+	// Decoded straight into the staging ring, the copy goes out with the next flush
+	if (raw_size <= uploader.capacity() / 2) {
+		void* staged = uploader.reserve(resource.buffer, 0, raw_size);
+		if (!IO::decompress_parallel(asset, staged, Core::ThreadPool::shared(), staging_cached)) {
+			fprintf(stderr, "Failed to decompress buffer\n");
+			exit(1);
+		}
+		return resource;
+	}
+
+	// Too big for the ring, it gets a staging buffer of its own
+	VkMemoryPropertyFlags staging_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (staging_cached) {
+		staging_properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+
+	DeviceResource staging_resource = createBuffer(raw_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, staging_properties);
+
+	if (!IO::decompress_parallel(asset, staging_resource.allocation.mapped, Core::ThreadPool::shared(), staging_cached)) {
+		fprintf(stderr, "Failed to decompress buffer\n");
+		exit(1);
+	}
+
+	copyBuffer(staging_resource.buffer, resource.buffer, raw_size);
+	clearResource(staging_resource);
+
+	return resource;
 }
 
 void VkManager::clearResource(DeviceResource& resource) {
     /*
-     * Clear the resource by destroying the buffer and freeing the memory
+     * Clear the resource by destroying the buffer and releasing its memory
      */
     if (resource.buffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device, resource.buffer, NULL);
+        vkDestroyBuffer(device, resource.buffer, host_allocation_callbacks());
         resource.buffer = VK_NULL_HANDLE;
     }
 
-    if (resource.memory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, resource.memory, NULL);
-        resource.memory = VK_NULL_HANDLE;
-    }
+    // The range goes back to its block, only dedicated allocations are freed
+    allocator.free(resource.allocation);
 
     resource.size = 0;
 }
 
+ResourceHandle VkManager::addResource(const DeviceResource& resource) {
+	return resources.insert(resource);
+}
+
+DeviceResource* VkManager::getResource(ResourceHandle handle) {
+	return resources.get(handle);
+}
+
+void VkManager::releaseResource(ResourceHandle& handle) {
+	/*
+	 * Destroy the resource once the frames that may still read it are done, the handle is
+	 * invalidated right away
+	 */
+	DeviceResource released;
+	if (!resources.remove(handle, released)) {
+		handle = INVALID_RESOURCE_HANDLE;
+		return;
+	}
+
+	residency.untrack(handle);
+	defragmenter.untrack(handle);
+	handle = INVALID_RESOURCE_HANDLE;
+
+	if (released.allocation.memory != VK_NULL_HANDLE) {
+		residency.released(frame_number, allocator.heapOf(released.allocation.memory_type), released.allocation.size);
+	}
+
+	// Tagged with the frame being built, its timeline value comes after every earlier frame's
+	deletion_queue.push(frame_number, [this, released]() mutable {
+		clearResource(released);
+	});
+}
+
+void VkManager::trackStreamable(ResourceHandle handle, ResidencyManager::Evictor evictor) {
+	residency.track(handle, std::move(evictor));
+}
+
+void VkManager::setEvictionWatermark(float watermark) {
+	residency.setWatermark(watermark);
+}
+
+uint32_t VkManager::memoryHeapCount() {
+	return allocator.heapCount();
+}
+
+bool VkManager::memoryBudget(uint32_t heap, HeapBudget& budget) {
+	return allocator.heapBudget(heap, budget);
+}
+
+void VkManager::enforce_memory_budget(uint64_t completed) {
+	ResidencyManager::Eviction eviction = residency.enforce(allocator, resources, frame_number, completed);
+
+	if (eviction.evicted > 0) {
+		printf("Evicted %u resources (%.1f MiB) to stay under the memory budget\n", eviction.evicted,
+			eviction.evicted_bytes / (1024.0 * 1024.0));
+	}
+
+	// Reported when a heap first crosses the watermark, not every frame it stays there
+	bool over = eviction.heap_count > 0;
+	if (over && !over_memory_watermark) {
+		fprintf(stderr, "Memory usage above %.0f%% of the budget on %u heap(s)\n", residency.getWatermark() * 100.0f, eviction.heap_count);
+		allocator.printBudgets();
+	}
+	over_memory_watermark = over;
+}
+
+uint64_t VkManager::completed_frame() {
+	/*
+	 * Frames are numbered on the CPU, the graphics timeline tells which of the ones in flight are
+	 * done. Every frame before a completed one is done too, values are signalled in submission order
+	 */
+	uint64_t reached = graphics_timeline.completed();
+	uint64_t completed = 0;
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (submitted_values[i] <= reached && submitted_frames[i] > completed) {
+			completed = submitted_frames[i];
+		}
+	}
+
+	return completed;
+}
+
+void VkManager::create_mesh_buffers(const void* vertices, size_t vertex_bytes, const uint32_t* indices, uint32_t index_count) {
+	VkDeviceSize index_buffer_size = sizeof(uint32_t) * index_count;
+
+	// Copy sources as well, the defragmenter moves them around
+	VkBufferUsageFlags vertex_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	VkBufferUsageFlags index_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+	DeviceResource vertex_resource = upload_buffer(vertices, vertex_bytes, vertex_usage);
+	DeviceResource index_resource = upload_buffer(indices, index_buffer_size, index_usage);
+
+	add_mesh_buffers(vertex_resource, vertex_usage, index_resource, index_usage, index_count);
+}
+
+DeviceResource VkManager::upload_buffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage) {
+	// Written in place when possible, host writes are visible to every later submission
+	DeviceResource resource;
+	if (create_direct_buffer(size, usage, resource)) {
+		memcpy(resource.allocation.mapped, data, size);
+	} else {
+		resource = createBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		uploader.upload(resource.buffer, 0, data, size);
+	}
+
+	return resource;
+}
+
+void VkManager::add_mesh_buffers(const DeviceResource& vertex_resource, VkBufferUsageFlags vertex_usage,
+	const DeviceResource& index_resource, VkBufferUsageFlags index_usage, uint32_t index_count) {
+	vertex_buffer = resources.insert(vertex_resource);
+	index_buffer = resources.insert(index_resource);
+
+	defragmenter.track(vertex_buffer, vertex_usage);
+	defragmenter.track(index_buffer, index_usage);
+
+	// The staged copies go out in one batch, the frames submitted after it see the data without a wait
+	uploader.flush();
+
+	mesh_index_count = index_count;
+
+	// The draw list and the buffers it binds changed, recorded frames are stale
+	geometry_generation++;
+}
+
+bool VkManager::load_mesh_file(const char* path, const void* data, size_t size) {
+	mesh_file file;
+	if (!mesh_file_parse(data, size, &file)) {
+		fprintf(stderr, "Invalid mesh file %s\n", path);
+		return false;
+	}
+
+	// The vertex stream is copied as is, it has to be laid out like VK::Vertex
+	if (file.header->vertex_layout != MESH_VERTEX_LAYOUT_POS3_COLOR3 || file.header->vertex_stride != sizeof(VK::Vertex)) {
+		fprintf(stderr, "Mesh file %s has an unsupported vertex layout %u (stride %u)\n", path,
+			file.header->vertex_layout, file.header->vertex_stride);
+		return false;
+	}
+
+	if (file.header->index_count == 0) {
+		fprintf(stderr, "Mesh file %s has no indices\n", path);
+		return false;
+	}
+
+	// Compressed indices are checked once decompressed, on the CPU before anything reaches the GPU
+	bool compressed = (file.header->flags & MESH_FILE_FLAG_COMPRESSED) != 0;
+	std::vector<uint32_t> decompressed_indices;
+
+	if (compressed) {
+		decompressed_indices.resize(file.header->index_count);
+
+		compressed_asset index_asset;
+		if (!compressed_asset_parse(file.indices, file.indices_size, &index_asset)
+			|| !IO::decompress_parallel(index_asset, decompressed_indices.data(), Core::ThreadPool::shared())
+			|| !mesh_file_check_indices(decompressed_indices.data(), file.header->index_count, file.header->vertex_count)) {
+			fprintf(stderr, "Mesh file %s has invalid indices\n", path);
+			return false;
+		}
+	}
+
+	retire_mesh(path);
+
+	if (compressed) {
+		// Vertices are decompressed across the workers straight into the staging ring, or the buffer itself
+		VkBufferUsageFlags vertex_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		VkBufferUsageFlags index_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+		DeviceResource vertex_resource = uploadCompressedBuffer(file.vertices, file.vertices_size, vertex_usage);
+		DeviceResource index_resource = upload_buffer(decompressed_indices.data(),
+			sizeof(uint32_t) * decompressed_indices.size(), index_usage);
+
+		add_mesh_buffers(vertex_resource, vertex_usage, index_resource, index_usage, file.header->index_count);
+	} else {
+		create_mesh_buffers(file.vertices, (size_t) file.header->vertex_count * file.header->vertex_stride,
+			file.indices, file.header->index_count);
+	}
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.submeshes.assign(file.submeshes, file.submeshes + file.header->submesh_count);
+	glm_vec3_copy((float*) file.header->bounds_min, mesh.bounds_min);
+	glm_vec3_copy((float*) file.header->bounds_max, mesh.bounds_max);
+
+	return true;
+}
+
+void VkManager::retire_mesh(const char* next_path) {
+	/*
+	 * The mesh being replaced by next_path stays on the GPU, showing it again is then a swap. Cached
+	 * meshes are streamable, the residency manager releases the ones shown longest ago once memory
+	 * runs short
+	 */
+	if (current_mesh_path.empty() || current_mesh_path == next_path || vertex_buffer == INVALID_RESOURCE_HANDLE) {
+		// Frames in flight may still read the old buffers, they go once those are done
+		releaseResource(vertex_buffer);
+		releaseResource(index_buffer);
+	} else {
+		if (mesh_cache.size() >= MESH_CACHE_SIZE) {
+			evict_cached_mesh(mesh_cache.front().vertex_buffer);
+		}
+
+		CachedMesh& cached = mesh_cache.emplace_back();
+		cached.path = current_mesh_path;
+		cached.vertex_buffer = vertex_buffer;
+		cached.index_buffer = index_buffer;
+		cached.index_count = mesh_index_count;
+		cached.submeshes = mesh.submeshes;
+		glm_vec3_copy(mesh.bounds_min, cached.bounds_min);
+		glm_vec3_copy(mesh.bounds_max, cached.bounds_max);
+
+		ResidencyManager::Evictor evictor = [this](ResourceHandle handle) {
+			evict_cached_mesh(handle);
+		};
+		trackStreamable(vertex_buffer, evictor);
+		trackStreamable(index_buffer, evictor);
+
+		vertex_buffer = INVALID_RESOURCE_HANDLE;
+		index_buffer = INVALID_RESOURCE_HANDLE;
+	}
+
+	current_mesh_path = next_path;
+}
+
+void VkManager::evict_cached_mesh(ResourceHandle handle) {
+	// Either buffer takes the whole mesh with it, the other one's eviction then finds nothing
+	for (size_t i = 0; i < mesh_cache.size(); i++) {
+		if (mesh_cache[i].vertex_buffer == handle || mesh_cache[i].index_buffer == handle) {
+			printf(" Released cached mesh %s\n", mesh_cache[i].path.c_str());
+
+			releaseResource(mesh_cache[i].vertex_buffer);
+			releaseResource(mesh_cache[i].index_buffer);
+			mesh_cache.erase(mesh_cache.begin() + i);
+			return;
+		}
+	}
+}
+
+bool VkManager::show_cached_mesh(const char* path) {
+	size_t i = 0;
+	while (i < mesh_cache.size() && mesh_cache[i].path != path) {
+		i++;
+	}
+	if (i == mesh_cache.size()) {
+		return false;
+	}
+
+	CachedMesh cached = std::move(mesh_cache[i]);
+	mesh_cache.erase(mesh_cache.begin() + i);
+
+	// Shown again, not evictable while it is
+	residency.untrack(cached.vertex_buffer);
+	residency.untrack(cached.index_buffer);
+
+	retire_mesh(path);
+
+	vertex_buffer = cached.vertex_buffer;
+	index_buffer = cached.index_buffer;
+	mesh_index_count = cached.index_count;
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.submeshes = std::move(cached.submeshes);
+	glm_vec3_copy(cached.bounds_min, mesh.bounds_min);
+	glm_vec3_copy(cached.bounds_max, mesh.bounds_max);
+
+	// The draw list and the buffers it binds changed, recorded frames are stale
+	geometry_generation++;
+
+	printf(" Showing cached mesh %s\n", path);
+	return true;
+}
+
+bool VkManager::apply_mesh(const char* path, const void* data, size_t size) {
+	const char* extension = SDL_strrchr(path, '.');
+	if (extension && SDL_strcasecmp(extension, ".mesh") == 0) {
+		return load_mesh_file(path, data, size);
+	}
+
+	VK::MeshData imported;
+	if (!IO::import_mesh_data(path, data, size, imported) || imported.indices.empty()) {
+		return false;
+	}
+
+	retire_mesh(path);
+
+	mesh = std::move(imported);
+	create_mesh_buffers(mesh.vertices.data(), sizeof(mesh.vertices[0]) * mesh.vertices.size(),
+		mesh.indices.data(), (uint32_t) mesh.indices.size());
+
+	return true;
+}
+
+void VkManager::mesh_read_callback(const IO::ReadResult& result) {
+	// Runs from drainCompletions() on the frame loop thread, between two frames
+	VkManager* manager = (VkManager*) result.user_data;
+
+	// Superseded by a later loadMesh()
+	if (result.ticket != manager->pending_mesh_ticket) {
+		return;
+	}
+	manager->pending_mesh_ticket = 0;
+
+	if (!result.ok || !manager->apply_mesh(manager->pending_mesh_path.c_str(), result.data, result.size)) {
+		fprintf(stderr, "Could not load %s, keeping the current mesh\n", manager->pending_mesh_path.c_str());
+	}
+}
+
+bool VkManager::loadMesh(const char* path) {
+	/*
+	 * Loose files are read on the I/O workers, the frame loop keeps drawing the current mesh until
+	 * the read completes and the new one replaces it
+	 */
+	if (show_cached_mesh(path)) {
+		// Supersedes a read still in flight
+		pending_mesh_ticket = 0;
+		return true;
+	}
+
+	// Packed meshes are a range of the archive, mapped for the whole run: no open, read or copy
+	archive_blob blob;
+	if (archive_find(&asset_archive, path, &blob) && blob.size > 0) {
+		pending_mesh_ticket = 0;
+		return apply_mesh(path, blob.data, blob.size);
+	}
+
+	if (!IO::AsyncLoader::isRunning()) {
+		file_view view;
+		if (!map_file_view(path, FILE_VIEW_HINT_SEQUENTIAL | FILE_VIEW_HINT_WILLNEED, &view)) {
+			return false;
+		}
+
+		bool ok = apply_mesh(path, view.data, view.size);
+		release_file_view(&view);
+		return ok;
+	}
+
+	IO::ReadRequest request;
+	request.path = path;
+	request.callback = mesh_read_callback;
+	request.user_data = this;
+
+	pending_mesh_path = path;
+	pending_mesh_ticket = IO::AsyncLoader::instance().submit(request);
+	return true;
+}
+
 void VkManager::init_vulkan() {
 	printf("Initialising Vulkan\n");
 
+	if (!archive_open(ASSET_ARCHIVE_PATH, &asset_archive)) {
+		printf(" No asset archive, loading loose files\n");
+	}
+
+	prefetch_shader_overrides();
+
 	if (vk_config.enableValidationLayers && !VK::check_validation_layer_support()) {
 		fprintf(stderr, "validation layers requested, but not available!");
 		exit(1);
@@ -742,13 +1399,25 @@ void VkManager::init_vulkan() {
 	app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	app_info.pEngineName = "No Engine";
 	app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	app_info.apiVersion = VK_API_VERSION_1_0;
+	// Devices only need REQUIRED_VULKAN_VERSION, newer features are used where they exist
+	app_info.apiVersion = PREFERRED_VULKAN_VERSION;
 
 	VkInstanceCreateInfo instance_create_info = VkTypeWrapper<VkInstanceCreateInfo>{};
 	instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instance_create_info.pApplicationInfo = &app_info;
 
-	instance_create_info.ppEnabledExtensionNames = get_required_extensions(vk_config, instance_create_info.enabledExtensionCount);
+	uint32_t required_extension_count;
+	char const * const * required_extensions = get_required_extensions(vk_config, required_extension_count);
+	std::vector<const char*> instance_extensions(required_extensions, required_extensions + required_extension_count);
+
+	// Core in 1.1, needed to query VK_EXT_memory_budget
+	bool has_properties2 = has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	if (has_properties2) {
+		instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	instance_create_info.enabledExtensionCount = (uint32_t) instance_extensions.size();
+	instance_create_info.ppEnabledExtensionNames = instance_extensions.data();
 
 	for (int i = 0; i < instance_create_info.enabledExtensionCount; i++) {
 		printf(" Extension: %s\n", instance_create_info.ppEnabledExtensionNames[i]);
@@ -767,7 +1436,7 @@ void VkManager::init_vulkan() {
 	}
 	
 	// ----- Create the Vulkan instance -----
-	if (vkCreateInstance(&instance_create_info, NULL, &vkInstance) != VK_SUCCESS) {
+	if (vkCreateInstance(&instance_create_info, host_allocation_callbacks(), &vkInstance) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create instance!");
 		exit(1);
 	}
@@ -786,7 +1455,7 @@ void VkManager::init_vulkan() {
 	}
 
 	// ----- Create the window surface -----
-	if (!SDL_Vulkan_CreateSurface(vkScreen.sdlWindow, vkInstance, NULL, &surface)) {
+	if (!SDL_Vulkan_CreateSurface(vkScreen.sdlWindow, vkInstance, host_allocation_callbacks(), &surface)) {
 		fprintf(stderr, "failed to create window surface!");
 		exit(1);
 	}
@@ -800,6 +1469,10 @@ void VkManager::init_vulkan() {
 		fprintf(stderr, "failed to find a suitable GPU!\n");
 		exit(1);
 	}
+
+	// API version and limits, for the optional features and the allocations sized by them
+	VkPhysicalDeviceProperties device_properties = VkTypeWrapper<VkPhysicalDeviceProperties>{};
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
 	
 	// ----- Create the logical device -----
 
@@ -809,8 +1482,13 @@ void VkManager::init_vulkan() {
 	VK::QueueFamilyIndices physical_indices = find_queue_families(physical_device);
 	
 	// I don't fully understand why, but sometimes it looks like both families could be the same
-	uint32_t unique_queue_families[2] = {physical_indices.graphics_family, physical_indices.present_family};
+	uint32_t unique_queue_families[3] = {physical_indices.graphics_family, physical_indices.present_family};
 	uint32_t num_unique_queue_families = unique_queue_families[0] == unique_queue_families[1] ? 1 : 2;
+
+	// The transfer family never does graphics, so it is distinct from the graphics family
+	if (physical_indices.has_transfer_family && physical_indices.transfer_family != physical_indices.present_family) {
+		unique_queue_families[num_unique_queue_families++] = physical_indices.transfer_family;
+	}
 	VkDeviceQueueCreateInfo* queue_create_infos = new VkDeviceQueueCreateInfo[num_unique_queue_families];
 
 	float queue_priority = 1.0f;
@@ -825,16 +1503,52 @@ void VkManager::init_vulkan() {
 	}
 
 	VkPhysicalDeviceFeatures device_features = VkTypeWrapper<VkPhysicalDeviceFeatures>{};
+
+	// Checked for when picking the device
+	VkPhysicalDeviceVulkan12Features vulkan12_features = VkTypeWrapper<VkPhysicalDeviceVulkan12Features>{};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12_features.timelineSemaphore = VK_TRUE;
+
+	// Optional, barriers go through vkCmdPipelineBarrier without it
+	bool core_synchronization2 = device_properties.apiVersion >= PREFERRED_VULKAN_VERSION;
+	bool has_synchronization2_extension = !core_synchronization2 && has_device_extension(physical_device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+	VkPhysicalDeviceSynchronization2Features synchronization2_features = VkTypeWrapper<VkPhysicalDeviceSynchronization2Features>{};
+	synchronization2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+	if (core_synchronization2 || has_synchronization2_extension) {
+		VkPhysicalDeviceFeatures2 features = VkTypeWrapper<VkPhysicalDeviceFeatures2>{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &synchronization2_features;
+		vkGetPhysicalDeviceFeatures2(physical_device, &features);
+	}
+
+	bool has_synchronization2 = synchronization2_features.synchronization2 == VK_TRUE;
+	if (has_synchronization2) {
+		vulkan12_features.pNext = &synchronization2_features;
+	}
+
 	VkDeviceCreateInfo create_info = VkTypeWrapper<VkDeviceCreateInfo>{};
 	create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	create_info.pNext = &vulkan12_features;
 
 	create_info.queueCreateInfoCount = num_unique_queue_families;
 	create_info.pQueueCreateInfos = queue_create_infos;
 
 	create_info.pEnabledFeatures = &device_features;
 
-	create_info.enabledExtensionCount = NUM_DEVICE_EXTENSIONS;
-	create_info.ppEnabledExtensionNames = VK::DeviceExtensions;
+	std::vector<const char*> device_extensions(VK::DeviceExtensions, VK::DeviceExtensions + NUM_DEVICE_EXTENSIONS);
+
+	// Optional, the allocator estimates the budgets itself without it
+	bool has_memory_budget = has_properties2 && has_device_extension(physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (has_memory_budget) {
+		device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	if (has_synchronization2 && !core_synchronization2) {
+		device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+	}
+
+	create_info.enabledExtensionCount = (uint32_t) device_extensions.size();
+	create_info.ppEnabledExtensionNames = device_extensions.data();
 
 	if (vk_config.enableValidationLayers) {
 		create_info.enabledLayerCount = NUM_VALIDATION_LAYERS;
@@ -843,7 +1557,7 @@ void VkManager::init_vulkan() {
 		create_info.enabledLayerCount = 0;
 	}
 
-	if (vkCreateDevice(physical_device, &create_info, NULL, &device) != VK_SUCCESS) {
+	if (vkCreateDevice(physical_device, &create_info, host_allocation_callbacks(), &device) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create logical device!\n");
 		exit(1);
 	}
@@ -852,6 +1566,68 @@ void VkManager::init_vulkan() {
 
 	vkGetDeviceQueue(device, physical_indices.graphics_family, 0, &graphics_queue);
 	vkGetDeviceQueue(device, physical_indices.present_family, 0, &present_queue);
+
+	if (physical_indices.has_transfer_family) {
+		vkGetDeviceQueue(device, physical_indices.transfer_family, 0, &transfer_queue);
+		printf(" Uploads on transfer queue family %u\n", physical_indices.transfer_family);
+	}
+
+	// ----- Create the queue timelines -----
+	if (!graphics_timeline.init(device, graphics_queue)
+		|| (physical_indices.has_transfer_family && !transfer_timeline.init(device, transfer_queue))) {
+		exit(1);
+	}
+
+	// ----- Pick the barrier command -----
+	PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2 = NULL;
+	if (has_synchronization2) {
+		const char* name = core_synchronization2 ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR";
+		cmd_pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(device, name);
+	}
+	printf(" Barriers %s\n", cmd_pipeline_barrier2 ? "through synchronization2" : "through vkCmdPipelineBarrier");
+
+	// ----- Create the device memory allocator -----
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2 = NULL;
+	if (has_memory_budget) {
+		get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR) vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+	}
+	printf(" Memory budget %s\n", get_memory_properties2 ? "reported by the driver" : "estimated");
+
+	allocator.init(physical_device, device, get_memory_properties2);
+	defragmenter.init(device, &allocator, &deletion_queue, &resources, cmd_pipeline_barrier2);
+
+	// Lowered to exercise eviction of the cached meshes without filling the GPU
+	const char* watermark = SDL_getenv(EVICTION_WATERMARK_ENV);
+	if (watermark != NULL && watermark[0] != '\0') {
+		setEvictionWatermark((float) SDL_atof(watermark));
+		printf(" Eviction above %.0f%% of the memory budget\n", residency.getWatermark() * 100.0f);
+	}
+
+	// ----- Create the render graph -----
+	render_graph.init(physical_device, device, &allocator, &deletion_queue, cmd_pipeline_barrier2);
+
+	// ----- Look for device local memory the CPU can write -----
+	direct_upload = detect_direct_upload(direct_upload_cached);
+	printf(" Uploads %s\n", direct_upload ? "written straight into device local memory" : "staged");
+
+	// ----- Create the upload manager -----
+	// Cached staging memory lets the block decoder read back its own output cheaply
+	VkMemoryPropertyFlags staging_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	staging_cached = has_memory_type(staging_properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+	if (staging_cached) {
+		staging_properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+
+	DeviceResource staging_resource = createBuffer(UPLOAD_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, staging_properties);
+	staging_buffer = resources.insert(staging_resource);
+
+	if (physical_indices.has_transfer_family) {
+		uploader.init(device, &transfer_timeline, physical_indices.transfer_family, &graphics_timeline, physical_indices.graphics_family, staging_resource,
+			cmd_pipeline_barrier2);
+	} else {
+		uploader.init(device, &graphics_timeline, physical_indices.graphics_family, &graphics_timeline, physical_indices.graphics_family, staging_resource,
+			cmd_pipeline_barrier2);
+	}
 	
 	// ----- Create the swap chain -----
 	create_swap_chain();
@@ -867,8 +1643,9 @@ void VkManager::init_vulkan() {
 	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// The render graph transitions the swap chain image around the pass and orders it after acquisition
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference color_attachment_ref = {0};
 	color_attachment_ref.attachment = 0;
@@ -879,24 +1656,14 @@ void VkManager::init_vulkan() {
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &color_attachment_ref;
 
-	VkSubpassDependency dependency = {0};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
 	VkRenderPassCreateInfo render_pass_info = VkTypeWrapper<VkRenderPassCreateInfo>{};
 	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	render_pass_info.attachmentCount = 1;
 	render_pass_info.pAttachments = &color_attachment;
 	render_pass_info.subpassCount = 1;
 	render_pass_info.pSubpasses = &subpass;
-	render_pass_info.dependencyCount = 1;
-	render_pass_info.pDependencies = &dependency;
 
-	if (vkCreateRenderPass(device, &render_pass_info, NULL, &render_pass) != VK_SUCCESS) {
+	if (vkCreateRenderPass(device, &render_pass_info, host_allocation_callbacks(), &render_pass) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create render pass!\n");
 		exit(1);
 	}
@@ -907,7 +1674,7 @@ void VkManager::init_vulkan() {
 	// create_descriptor_set_layout()
 	VkDescriptorSetLayoutBinding ubo_layout_binding = VkTypeWrapper<VkDescriptorSetLayoutBinding>{};
 	ubo_layout_binding.binding = 0;
-	ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	ubo_layout_binding.descriptorCount = 1;
 	ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	ubo_layout_binding.pImmutableSamplers = NULL;
@@ -917,7 +1684,7 @@ void VkManager::init_vulkan() {
 	layout_info.bindingCount = 1;
 	layout_info.pBindings = &ubo_layout_binding;
 
-	if (vkCreateDescriptorSetLayout(device, &layout_info, NULL, &descriptor_set_layout) != VK_SUCCESS) {
+	if (vkCreateDescriptorSetLayout(device, &layout_info, host_allocation_callbacks(), &descriptor_set_layout) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create descriptor set layout!\n");
 		exit(1);
 	}
@@ -934,69 +1701,31 @@ void VkManager::init_vulkan() {
 	command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	command_pool_info.queueFamilyIndex = physical_indices.graphics_family;
 
-	if (vkCreateCommandPool(device, &command_pool_info, NULL, &command_pool) != VK_SUCCESS) {
+	if (vkCreateCommandPool(device, &command_pool_info, host_allocation_callbacks(), &command_pool) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create command pool!\n");
 		exit(1);
 	}
 
-	// ----- Create the vertex buffer -----
-	
-	VkDeviceSize buffer_size = sizeof(mesh.vertices[0]) * mesh.vertex_count;
-	VK::DeviceResource stagingVertexResource = createBuffer(
-		buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	);
-
-	void *data;
-	vkMapMemory(device, stagingVertexResource.memory, 0, buffer_size, 0, &data);
-	memcpy(data, mesh.vertices, (size_t) buffer_size);
-	vkUnmapMemory(device, stagingVertexResource.memory);
-	
-	vertexResource = createBuffer(buffer_size, 
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		   	VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		
-	// Copy the staging buffer into the vertex buffer
-	copyBuffer(stagingVertexResource.buffer, vertexResource.buffer, vertexResource.size);
-	clearResource(stagingVertexResource);
-
-	// ----- Create the index buffer -----
-	
-	VkDeviceSize index_buffer_size = sizeof(mesh.indices[0]) * mesh.index_count;
-	VK::DeviceResource stagingIndexResource = createBuffer(
-		index_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-	void *index_data;
-	vkMapMemory(device, stagingIndexResource.memory, 0, index_buffer_size, 0, &index_data);
-	memcpy(index_data, mesh.indices, (size_t) index_buffer_size);
-	vkUnmapMemory(device, stagingIndexResource.memory);
+	graphics_family = physical_indices.graphics_family;
 
-	indexResource = createBuffer(
-		index_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// ----- Create the vertex and index buffers -----
+	create_mesh_buffers(mesh.vertices.data(), sizeof(mesh.vertices[0]) * mesh.vertices.size(),
+		mesh.indices.data(), (uint32_t) mesh.indices.size());
 
-	// Copy the staging buffer into the index buffer
-	copyBuffer(stagingIndexResource.buffer, indexResource.buffer, index_buffer_size);
-	clearResource(stagingIndexResource);
-
-	// Map the buffer memory and copy the vertex data into it
-	
-	// ----- Create the uniform buffer -----
-	VkDeviceSize uniform_buffer_size = sizeof(VK::UniformBufferObject);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		uniformResources[i] = createBuffer(
-			uniform_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// ----- Create the frame allocator -----
+	// Uniforms and any other per-frame data are bump allocated out of it each frame
+	DeviceResource transient_resource = createBuffer(
+		FRAME_ALLOCATOR_SIZE * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	transient_buffer = resources.insert(transient_resource);
 
-		// Map the buffer memory and copy the vertex data into it
-		vkMapMemory(device, uniformResources[i].memory, 0, uniform_buffer_size, 0, &uniform_buffers_mapped[i]);
-	}
+	frame_allocator.init(transient_resource, MAX_FRAMES_IN_FLIGHT, FRAME_ALLOCATOR_SIZE,
+		device_properties.limits.minUniformBufferOffsetAlignment);
 
 	// ----- Create the descriptor pool -----
 	VkDescriptorPoolSize desc_pool_size = VkTypeWrapper<VkDescriptorPoolSize>{};
-	desc_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	desc_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	desc_pool_size.descriptorCount = MAX_FRAMES_IN_FLIGHT;
 
 	VkDescriptorPoolCreateInfo desc_pool_info = VkTypeWrapper<VkDescriptorPoolCreateInfo>{};
@@ -1005,7 +1734,7 @@ void VkManager::init_vulkan() {
 	desc_pool_info.pPoolSizes = &desc_pool_size;
 	desc_pool_info.maxSets = MAX_FRAMES_IN_FLIGHT;
 
-	if (vkCreateDescriptorPool(device, &desc_pool_info, NULL, &descriptor_pool) != VK_SUCCESS) {
+	if (vkCreateDescriptorPool(device, &desc_pool_info, host_allocation_callbacks(), &descriptor_pool) != VK_SUCCESS) {
 		fprintf(stderr, "failed to create descriptor pool!\n");
 		exit(1);
 	}
@@ -1029,7 +1758,8 @@ void VkManager::init_vulkan() {
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		VkDescriptorBufferInfo buffer_info = VkTypeWrapper<VkDescriptorBufferInfo>{};
-		buffer_info.buffer = uniformResources[i].buffer;
+		// The dynamic offset given at bind time picks the frame's uniforms
+		buffer_info.buffer = transient_resource.buffer;
 		buffer_info.offset = 0;
 		buffer_info.range = sizeof(VK::UniformBufferObject);
 
@@ -1038,7 +1768,7 @@ void VkManager::init_vulkan() {
 		descriptor_write.dstSet = descriptor_sets[i];
 		descriptor_write.dstBinding = 0;
 		descriptor_write.dstArrayElement = 0;
-		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		descriptor_write.descriptorCount = 1;
 		descriptor_write.pBufferInfo = &buffer_info;
 		descriptor_write.pImageInfo = NULL;
@@ -1046,31 +1776,30 @@ void VkManager::init_vulkan() {
 
 		vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, NULL);
 	}
+	descriptor_generation++;
 
 	// ----- Create the command buffers -----
 	VkCommandBufferAllocateInfo buf_alloc_info = VkTypeWrapper<VkCommandBufferAllocateInfo>{};
 	buf_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	buf_alloc_info.commandPool = command_pool;
 	buf_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	buf_alloc_info.commandBufferCount = command_buffers_count;
+	buf_alloc_info.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
 
-	if (vkAllocateCommandBuffers(device, &buf_alloc_info, command_buffers) != VK_SUCCESS) {
+	if (vkAllocateCommandBuffers(device, &buf_alloc_info, frame_command_buffers) != VK_SUCCESS) {
 		fprintf(stderr, "failed to allocate command buffers!\n");
 		exit(1);
 	}
 
+	create_command_buffers();
+
 	// ----- Create the semaphores -----
+	// Binary, the swap chain takes no timeline semaphores. Frame slots wait on the graphics timeline
 	VkSemaphoreCreateInfo semaphore_info = VkTypeWrapper<VkSemaphoreCreateInfo>{};
 	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fence_info = VkTypeWrapper<VkFenceCreateInfo>{};
-	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		if (vkCreateSemaphore(device, &semaphore_info, NULL, &image_available_semaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device, &semaphore_info, NULL, &render_finished_semaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fence_info, NULL, &in_flight_fences[i]) != VK_SUCCESS) {
+		if (vkCreateSemaphore(device, &semaphore_info, host_allocation_callbacks(), &image_available_semaphores[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(device, &semaphore_info, host_allocation_callbacks(), &render_finished_semaphores[i]) != VK_SUCCESS) {
 			fprintf(stderr, "failed to create synchronization objects for a frame!\n");
 			exit(1);
 		}
@@ -1079,7 +1808,73 @@ void VkManager::init_vulkan() {
 	printf("Initialisation complete\n");
 }
 
-void VkManager::record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index) {
+void VkManager::setCommandCaching(bool enabled) {
+	command_caching = enabled;
+}
+
+void VkManager::create_command_buffers() {
+	/*
+	 * One primary per frame slot and swap chain image: a slot always renders with the same uniform
+	 * region and descriptor set, an image with the same framebuffer, so a pair can be replayed as
+	 * recorded for as long as nothing else changes
+	 */
+	uint32_t count = MAX_FRAMES_IN_FLIGHT * swap_chain_images_count;
+	recorded_commands.assign(count, RecordedCommands{});
+
+	std::vector<VkCommandBuffer> command_buffers(count);
+
+	VkCommandBufferAllocateInfo alloc_info = VkTypeWrapper<VkCommandBufferAllocateInfo>{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.commandPool = command_pool;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.commandBufferCount = count;
+
+	if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers.data()) != VK_SUCCESS) {
+		fprintf(stderr, "failed to allocate command buffers!\n");
+		exit(1);
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		recorded_commands[i].command_buffer = command_buffers[i];
+	}
+
+	// The secondaries of a primary are only reset when it is re-recorded
+	if (!recorder.init(device, graphics_family, count, Core::ThreadPool::shared())) {
+		exit(1);
+	}
+}
+
+void VkManager::cleanup_command_buffers() {
+	recorder.destroy();
+
+	for (RecordedCommands& recorded : recorded_commands) {
+		vkFreeCommandBuffers(device, command_pool, 1, &recorded.command_buffer);
+	}
+	recorded_commands.clear();
+}
+
+RecordedState VkManager::current_record_state(uint32_t image_index, uint32_t uniform_offset) {
+	RecordedState state;
+	state.pipeline = graphics_pipeline;
+	state.framebuffer = swap_chain_framebuffers[image_index];
+	state.width = swap_chain_extent.width;
+	state.height = swap_chain_extent.height;
+	// Looked up every frame, the defragmenter or an eviction may have replaced them
+	state.vertex_buffer = resources.get(vertex_buffer)->buffer;
+	state.index_buffer = resources.get(index_buffer)->buffer;
+	state.geometry_generation = geometry_generation;
+	state.descriptor_generation = descriptor_generation;
+	state.transient_generation = render_graph.transientGeneration();
+	state.uniform_offset = uniform_offset;
+
+	return state;
+}
+
+void VkManager::record_command_buffer(RecordedCommands& recorded, uint32_t image_index, uint32_t uniform_offset) {
+	VkCommandBuffer command_buffer = recorded.command_buffer;
+	recorded.state = current_record_state(image_index, uniform_offset);
+
+	// Not one time submit, it is replayed until something it was recorded from changes
 	VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
 	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -1088,61 +1883,134 @@ void VkManager::record_command_buffer(VkCommandBuffer command_buffer, uint32_t i
 		exit(1);
 	}
 
-	VkRenderPassBeginInfo render_pass_info = VkTypeWrapper<VkRenderPassBeginInfo>{};
-	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	render_pass_info.renderPass = render_pass;
-	render_pass_info.framebuffer = swap_chain_framebuffers[image_index];
-	render_pass_info.renderArea.offset.x = 0;
-	render_pass_info.renderArea.offset.y = 0;
-	render_pass_info.renderArea.extent = swap_chain_extent;
+	// ------------- Frame graph ------------- //
+	render_graph.reset();
+
+	// Acquisition is waited for at color attachment output, the image leaves the graph ready to present
+	ResourceState acquired = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE};
+	ResourceState presented = {VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE};
+	RenderResource backbuffer = render_graph.importImage("backbuffer", swap_chain_images[image_index], swap_chain_image_views[image_index],
+		VK_IMAGE_ASPECT_COLOR_BIT, acquired, presented);
+
+	// The upload manager already made their contents visible to vertex input
+	RenderResource vertices = render_graph.importBuffer("vertices", recorded.state.vertex_buffer, ResourceState{});
+	RenderResource indices = render_graph.importBuffer("indices", recorded.state.index_buffer, ResourceState{});
+
+	render_graph.addPass("main")
+		.write(backbuffer, ResourceAccess::ColorAttachment)
+		.read(vertices, ResourceAccess::VertexBuffer)
+		.read(indices, ResourceAccess::IndexBuffer)
+		.execute([&](VkCommandBuffer pass_command_buffer, const RenderGraph& graph) {
+		VkRenderPassBeginInfo render_pass_info = VkTypeWrapper<VkRenderPassBeginInfo>{};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = render_pass;
+		render_pass_info.framebuffer = swap_chain_framebuffers[image_index];
+		render_pass_info.renderArea.offset.x = 0;
+		render_pass_info.renderArea.offset.y = 0;
+		render_pass_info.renderArea.extent = swap_chain_extent;
+
+		VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+		render_pass_info.clearValueCount = 1;
+		render_pass_info.pClearValues = &clear_color;
+
+		vkCmdBeginRenderPass(pass_command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		// ------------- Render Pass ------------- //
+
+		VkBuffer vertex_buffers[] = {graph.buffer(vertices)};
+		VkBuffer index_buffer_handle = graph.buffer(indices);
+
+		VkViewport viewport = {0};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float) swap_chain_extent.width;
+		viewport.height = (float) swap_chain_extent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {0};
+		scissor.offset.x = 0;
+		scissor.offset.y = 0;
+		scissor.extent = swap_chain_extent;
+
+		// One draw per submesh, the default quad has none and is drawn whole
+		mesh_file_submesh whole_mesh = {0, mesh_index_count, {0.0f}, {0.0f}};
+		const mesh_file_submesh* draws = mesh.submeshes.empty() ? &whole_mesh : mesh.submeshes.data();
+		uint32_t draw_count = mesh.submeshes.empty() ? 1 : (uint32_t) mesh.submeshes.size();
+
+		VkCommandBufferInheritanceInfo inheritance = VkTypeWrapper<VkCommandBufferInheritanceInfo>{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = render_pass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = swap_chain_framebuffers[image_index];
+
+		// The previous secondaries of this primary go, it is no longer pending
+		recorder.beginFrame((uint32_t) (&recorded - recorded_commands.data()));
+
+		// Secondaries inherit no state, each one binds everything its draws need
+		secondary_command_buffers.clear();
+		bool success = recorder.record(inheritance, draw_count, [&](VkCommandBuffer secondary, uint32_t first, uint32_t count) {
+			vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+
+			VkDeviceSize offsets[] = {0};
+			vkCmdBindVertexBuffers(secondary, 0, 1, vertex_buffers, offsets);
+			vkCmdBindIndexBuffer(secondary, index_buffer_handle, 0, VK_INDEX_TYPE_UINT32);
+
+			vkCmdSetViewport(secondary, 0, 1, &viewport);
+			vkCmdSetScissor(secondary, 0, 1, &scissor);
+
+			// Bind the descriptor set, the dynamic offset points at this frame's uniforms
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[current_frame], 1, &uniform_offset);
+
+			// Draw the triangles
+			for (uint32_t i = first; i < first + count; i++) {
+				vkCmdDrawIndexed(secondary, draws[i].index_count, 1, draws[i].first_index, 0, 0);
+			}
+		}, secondary_command_buffers);
 
-	VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-	render_pass_info.clearValueCount = 1;
-	render_pass_info.pClearValues = &clear_color;
+		if (!success) {
+			exit(1);
+		}
 
-	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-	
-	// ------------- Render Pass ------------- //
-	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+		vkCmdExecuteCommands(pass_command_buffer, (uint32_t) secondary_command_buffers.size(), secondary_command_buffers.data());
 
-	VkBuffer vertex_buffers[] = {vertexResource.buffer};
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+		// ------------- /Render Pass ------------- //
+		vkCmdEndRenderPass(pass_command_buffer);
+	});
 
-	vkCmdBindIndexBuffer(command_buffer, indexResource.buffer, 0, VK_INDEX_TYPE_UINT16);
-	
-	VkViewport viewport = {0};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float) swap_chain_extent.width;
-	viewport.height = (float) swap_chain_extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-	VkRect2D scissor = {0};
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent = swap_chain_extent;
-	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-	
-	// Bind the descriptor set to update the uniform buffer
-	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[current_frame], 0, NULL);
-	
-	// Draw the triangles
-	vkCmdDrawIndexed(command_buffer, NUM_VERTEX_INDICES, 1, 0, 0, 0);
+	// Transients the graph no longer declares are released with this frame
+	if (!render_graph.compile(frame_number)) {
+		fprintf(stderr, "failed to compile the render graph!\n");
+		exit(1);
+	}
+	// Recorded against the transients just compiled, the other cached frames still use the released ones
+	recorded.state.transient_generation = render_graph.transientGeneration();
+
+	render_graph.record(command_buffer);
 
-	// ------------- /Render Pass ------------- //
-	vkCmdEndRenderPass(command_buffer);
+	// ------------- /Frame graph ------------- //
 
 	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
 		fprintf(stderr, "failed to record command buffer!\n");
 		exit(1);
 	}
+
+	recorded.valid = true;
 }
 
 void VkManager::drawFrame() {
-	vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+	uint64_t host_allocations = HostAllocator::shared().allocationCount();
+
+	graphics_timeline.wait(submitted_values[current_frame]);
+
+	// The GPU is done with everything this frame allocated last time round
+	frame_allocator.beginFrame(current_frame);
+
+	// and with every frame the timeline has passed, at least up to the one this slot last submitted
+	uint64_t completed = completed_frame();
+	deletion_queue.collect(completed);
+
+	enforce_memory_budget(completed);
 
 	uint32_t image_index;
 	VkResult result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
@@ -1156,13 +2024,7 @@ void VkManager::drawFrame() {
 		exit(1);
 	}
 
-	vkResetFences(device, 1, &in_flight_fences[current_frame]);
 	
-	vkResetCommandBuffer(command_buffers[current_frame], /*VkCommandBufferResetFlagBits*/ 0);
-	
-	// Write our draw commands into the command buffer
-	record_command_buffer(command_buffers[current_frame], image_index);
-
 	// Update the uniform buffer
 	// TODO: Temporary code to apply some transformations over time
 	uint64_t ticks = SDL_GetTicksNS();
@@ -1170,10 +2032,18 @@ void VkManager::drawFrame() {
 
 	VK::UniformBufferObject ubo = {0};
 
-	// Model matrix
+	// Model matrix, the mesh is centred and scaled to the size of the default quad
+	vec3 mesh_center;
+	glm_vec3_center(mesh.bounds_min, mesh.bounds_max, mesh_center);
+	glm_vec3_negate(mesh_center);
+
+	float mesh_extent = SDL_max(SDL_max(mesh.bounds_max[0] - mesh.bounds_min[0], mesh.bounds_max[1] - mesh.bounds_min[1]), mesh.bounds_max[2] - mesh.bounds_min[2]);
+
 	glm_mat4_identity(ubo.model);
 	vec3 axis = {0.0f, 0.0f, 1.0f};
 	glm_rotate(ubo.model, (float) t, axis);
+	glm_scale_uni(ubo.model, mesh_extent > 0.0f ? 1.0f / mesh_extent : 1.0f);
+	glm_translate(ubo.model, mesh_center);
 	
 	// View matrix
 	// glm_mat4_identity(ubo.view);
@@ -1189,7 +2059,48 @@ void VkManager::drawFrame() {
 	// Flip the Y axis
 	ubo.proj[1][1] *= -1;
 
-	memcpy(uniform_buffers_mapped[current_frame], &ubo, sizeof(ubo));
+	VK::TransientAllocation uniforms;
+	if (!frame_allocator.allocateUniform(sizeof(ubo), uniforms)) {
+		exit(1);
+	}
+	memcpy(uniforms.data, &ubo, sizeof(ubo));
+
+	// Buffers moved out of sparse blocks are copied ahead of the frame, the draws then bind the new ones
+	VkCommandBuffer frame_command_buffer = frame_command_buffers[current_frame];
+	vkResetCommandBuffer(frame_command_buffer, /*VkCommandBufferResetFlagBits*/ 0);
+
+	VkCommandBufferBeginInfo begin_info = VkTypeWrapper<VkCommandBufferBeginInfo>{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(frame_command_buffer, &begin_info) != VK_SUCCESS) {
+		fprintf(stderr, "failed to begin recording command buffer!\n");
+		exit(1);
+	}
+
+	bool defragmented = defragmenter.record(frame_command_buffer, frame_number, completed) > 0;
+
+	if (vkEndCommandBuffer(frame_command_buffer) != VK_SUCCESS) {
+		fprintf(stderr, "failed to record command buffer!\n");
+		exit(1);
+	}
+
+	DeviceResource* vertices = resources.get(vertex_buffer);
+	DeviceResource* indices = resources.get(index_buffer);
+	vertices->last_used_frame = frame_number;
+	indices->last_used_frame = frame_number;
+
+	// Replayed as is unless something it was recorded from changed, only the uniforms differ then
+	RecordedCommands& recorded = recorded_commands[current_frame * swap_chain_images_count + image_index];
+	if (command_caching && recorded.valid && recorded.state == current_record_state(image_index, (uint32_t) uniforms.offset)) {
+		reused_frame_count++;
+	} else {
+		vkResetCommandBuffer(recorded.command_buffer, /*VkCommandBufferResetFlagBits*/ 0);
+		record_command_buffer(recorded, image_index, (uint32_t) uniforms.offset);
+		recorded_frame_count++;
+	}
+
+	VkCommandBuffer command_buffers[] = {frame_command_buffer, recorded.command_buffer};
 
 	VkSubmitInfo submit_info = VkTypeWrapper<VkSubmitInfo>{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1200,18 +2111,39 @@ void VkManager::drawFrame() {
 	submit_info.pWaitSemaphores = wait_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
 
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &command_buffers[current_frame];
+	// The frame's one-off commands are left out when there were none
+	submit_info.commandBufferCount = defragmented ? 2 : 1;
+	submit_info.pCommandBuffers = defragmented ? command_buffers : &command_buffers[1];
+
+	// Uploads recorded since the last flush reach the queue ahead of the frame using them, their
+	// timeline values come before the frame's
+	uploader.flush();
+
+	// The binary semaphores ignore their values
+	uint64_t frame_value = graphics_timeline.next();
+	uint64_t wait_values[] = {0};
+	uint64_t signal_values[] = {0, frame_value};
 
-	VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
-	submit_info.signalSemaphoreCount = 1;
+	VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame], graphics_timeline.semaphore()};
+	submit_info.signalSemaphoreCount = 2;
 	submit_info.pSignalSemaphores = signal_semaphores;
 
-	if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+	VkTimelineSemaphoreSubmitInfo timeline_info = VkTypeWrapper<VkTimelineSemaphoreSubmitInfo>{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.waitSemaphoreValueCount = 1;
+	timeline_info.pWaitSemaphoreValues = wait_values;
+	timeline_info.signalSemaphoreValueCount = 2;
+	timeline_info.pSignalSemaphoreValues = signal_values;
+	submit_info.pNext = &timeline_info;
+
+	if (vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
 		fprintf(stderr, "failed to submit draw command buffer!");
 		exit(1);
 	}
 
+	submitted_values[current_frame] = frame_value;
+	submitted_frames[current_frame] = frame_number++;
+
 	VkPresentInfoKHR present_info = VkTypeWrapper<VkPresentInfoKHR>{};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -1225,11 +2157,13 @@ void VkManager::drawFrame() {
 	present_info.pImageIndices = &image_index;
 
 	result = vkQueuePresentKHR(present_queue, &present_info);
+	bool swap_chain_recreated = false;
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized) {
 		printf("Couldn't present swap chain image - recreating swap chain\n");
 		framebuffer_resized = false;
 		recreate_swap_chain();
+		swap_chain_recreated = true;
 
 	} else if (result != VK_SUCCESS) {
 		fprintf(stderr, "failed to present swap chain image!\n");
@@ -1237,48 +2171,86 @@ void VkManager::drawFrame() {
 	}
 
 	current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	// Past the warm up, a frame should not make the driver allocate host memory (rebuilding the
+	// swap chain aside)
+	uint64_t frame_allocations = HostAllocator::shared().allocationCount() - host_allocations;
+	if (frame_number > HOST_ALLOCATION_WARMUP_FRAMES && frame_allocations > 0 && !swap_chain_recreated) {
+		if (steady_host_allocations == 0) {
+			fprintf(stderr, "Frame %llu made %llu driver host allocations\n", (unsigned long long) frame_number - 1,
+				(unsigned long long) frame_allocations);
+		}
+		steady_host_allocations += frame_allocations;
+	}
 }
 
 void VkManager::cleanup_vulkan(void) {
 	printf("Cleaning up Vulkan\n");
 
+	// Nothing is in flight anymore, the deferred destructions run in release order
+	vkDeviceWaitIdle(device);
+	deletion_queue.flush();
+
 	cleanup_swap_chain();
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		clearResource(uniformResources[i]);
+	uploader.destroy();
+
+	// Every buffer still registered goes with the device
+	while (resources.size() > 0) {
+		ResourceHandle handle = resources.handleAt(0);
+		DeviceResource resource;
+		resources.remove(handle, resource);
+		clearResource(resource);
 	}
+	vertex_buffer = index_buffer = transient_buffer = staging_buffer = INVALID_RESOURCE_HANDLE;
+	mesh_cache.clear();
 	
-	vkDestroyDescriptorPool(device, descriptor_pool, NULL);
-
-	vkDestroyDescriptorSetLayout(device, descriptor_set_layout, NULL);
+	vkDestroyDescriptorPool(device, descriptor_pool, host_allocation_callbacks());
 
-	clearResource(vertexResource);
-	clearResource(indexResource);
+	vkDestroyDescriptorSetLayout(device, descriptor_set_layout, host_allocation_callbacks());
 
-	vkDestroyPipeline(device, graphics_pipeline, NULL);
-	vkDestroyPipelineLayout(device, pipeline_layout, NULL);
+	vkDestroyPipeline(device, graphics_pipeline, host_allocation_callbacks());
+	vkDestroyPipelineLayout(device, pipeline_layout, host_allocation_callbacks());
 
-	vkDestroyRenderPass(device, render_pass, NULL);
+	vkDestroyRenderPass(device, render_pass, host_allocation_callbacks());
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroySemaphore(device, render_finished_semaphores[i], NULL);
-		vkDestroySemaphore(device, image_available_semaphores[i], NULL);
-		vkDestroyFence(device, in_flight_fences[i], NULL);
+		vkDestroySemaphore(device, render_finished_semaphores[i], host_allocation_callbacks());
+		vkDestroySemaphore(device, image_available_semaphores[i], host_allocation_callbacks());
 	}
 
-	vkDestroyCommandPool(device, command_pool, NULL);
+	transfer_timeline.destroy();
+	graphics_timeline.destroy();
 
-	vkDestroyDevice(device, NULL);
+	printf(" %llu frames recorded, %llu replayed\n", (unsigned long long) recorded_frame_count, (unsigned long long) reused_frame_count);
+	cleanup_command_buffers();
+	vkDestroyCommandPool(device, command_pool, host_allocation_callbacks());
+
+	render_graph.destroy();
+
+	allocator.printStats();
+	allocator.printBudgets();
+	allocator.destroy();
+
+	vkDestroyDevice(device, host_allocation_callbacks());
 
 	if (vk_config.enableValidationLayers) {
 		PFN_vkDestroyDebugUtilsMessengerEXT func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(vkInstance, "vkDestroyDebugUtilsMessengerEXT");
 		if (func != NULL) {
-			func(vkInstance, debug_messenger, NULL);
+			func(vkInstance, debug_messenger, host_allocation_callbacks());
 		}
 	}
 
-	vkDestroySurfaceKHR(vkInstance, surface, NULL);
-	vkDestroyInstance(vkInstance, NULL);
+	vkDestroySurfaceKHR(vkInstance, surface, host_allocation_callbacks());
+	vkDestroyInstance(vkInstance, host_allocation_callbacks());
+
+	// Whatever is still live here leaked in the driver or loader
+	HostAllocator::shared().printStats();
+	if (steady_host_allocations > 0) {
+		printf(" %llu driver host allocations during steady state frames\n", (unsigned long long) steady_host_allocations);
+	}
+
+	archive_close(&asset_archive);
 
     vkScreen.cleanup();
 }
@@ -1,7 +1,19 @@
 #pragma once
 
 #include "VkCommon.hpp"
+#include "FrameAllocator.hpp"
+#include "UploadManager.hpp"
+#include "DeletionQueue.hpp"
+#include "Residency.hpp"
+#include "Defragmenter.hpp"
+#include "ResourceTable.hpp"
+#include "CommandRecorder.hpp"
+#include "QueueTimeline.hpp"
+#include "RenderGraph.hpp"
 #include "VkScreen.hpp"
+#include "engine/io/Decompress.hpp"
+#include "engine/io/AsyncLoader.hpp"
+#include "EmbeddedShaders.hpp"
 namespace VK{
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -10,6 +22,8 @@ namespace VK{
 
 bool check_validation_layer_support();
 char const * const * get_required_extensions(const VkConfiguration& config, uint32_t& count);
+bool has_instance_extension(const char* name);
+bool has_device_extension(VkPhysicalDevice device, const char* name);
 
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -28,9 +42,65 @@ static const char* DeviceExtensions[NUM_DEVICE_EXTENSIONS] = {
 
 #define MAX_FRAMES_IN_FLIGHT 2
 
+// Frames and uploads are synchronised with timeline semaphores, core from this version
+#define REQUIRED_VULKAN_VERSION VK_API_VERSION_1_2
+// Highest version used when the device has it, barriers go through synchronization2 from it
+#define PREFERRED_VULKAN_VERSION VK_API_VERSION_1_3
+
+// Frames after which the driver is expected to have stopped allocating host memory
+#define HOST_ALLOCATION_WARMUP_FRAMES 16
+
+// Memory uploads are written into directly on devices where it spans the whole of VRAM
+#define DIRECT_UPLOAD_MEMORY_PROPERTIES (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT \
+    | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+
+// Packed assets, loose files are used for anything not found in it
+#define ASSET_ARCHIVE_PATH "assets.pak"
+
+// Development override, shaders are read from this directory instead of the ones embedded in the binary
+#define SHADER_DIR_ENV "VK_TEST_SHADER_DIR"
+// Development override, share of a heap's budget above which streamable resources are evicted
+#define EVICTION_WATERMARK_ENV "VK_TEST_EVICTION_WATERMARK"
+
+// Meshes kept on the GPU after another one replaced them
+#define MESH_CACHE_SIZE 8
+
 #define WIDTH 800
 #define HEIGHT 600
 
+// Everything a recorded frame depends on besides buffer contents, it is re-recorded once any of it differs
+struct RecordedState {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    uint64_t geometry_generation = 0;
+    uint64_t descriptor_generation = 0;
+    uint64_t transient_generation = 0;      // render graph transients, recreated when it changes
+    uint32_t uniform_offset = 0;            // baked in as the dynamic offset
+
+    bool operator==(const RecordedState&) const = default;
+};
+
+struct RecordedCommands {
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    RecordedState state;
+    bool valid = false;     // false until first recorded
+};
+
+// A mesh shown before, reloading it swaps its buffers back in
+struct CachedMesh {
+    std::string path;
+    ResourceHandle vertex_buffer = INVALID_RESOURCE_HANDLE;
+    ResourceHandle index_buffer = INVALID_RESOURCE_HANDLE;
+    uint32_t index_count = 0;
+    std::vector<mesh_file_submesh> submeshes;
+    vec3 bounds_min;
+    vec3 bounds_max;
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////  Vk interface  ////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -60,9 +130,30 @@ public:
     }
 
     uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties);
+    bool find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, uint32_t& memory_type);
+    bool has_memory_type(VkMemoryPropertyFlags properties);
     DeviceResource createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+    bool tryCreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, DeviceResource& resource);
     void copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size);
+    // Block compressed payload (blockcomp.h) into a new device local buffer, copied with the next upload flush
+    DeviceResource uploadCompressedBuffer(const void* data, size_t size, VkBufferUsageFlags usage);
     void clearResource(DeviceResource& resource);
+    // Registered resources are referred to by handle, lookups stay valid across defragmentation
+    ResourceHandle addResource(const DeviceResource& resource);
+    DeviceResource* getResource(ResourceHandle handle);
+    // Deferred clearResource, safe while frames using the resource are in flight
+    void releaseResource(ResourceHandle& handle);
+    // Evictable once memory runs short, see ResidencyManager
+    void trackStreamable(ResourceHandle handle, ResidencyManager::Evictor evictor);
+    void setEvictionWatermark(float watermark);
+    uint32_t memoryHeapCount();
+    bool memoryBudget(uint32_t heap, HeapBudget& budget);
+    // Loose files are read on the I/O workers, the mesh is replaced by the drainCompletions() that
+    // finishes it and a later call supersedes a pending one. Packed and still cached meshes are
+    // swapped in right away. False when the mesh could not be loaded or its read started
+    bool loadMesh(const char* path);
+    // Off, every frame is recorded from scratch
+    void setCommandCaching(bool enabled);
     void showWindow();
     void waitIdle();
     void drawFrame();
@@ -74,6 +165,8 @@ private:
 
     VK::SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device);
     QueueFamilyIndices find_queue_families(VkPhysicalDevice device);
+    bool detect_direct_upload(bool& cached);
+    bool create_direct_buffer(VkDeviceSize size, VkBufferUsageFlags usage, DeviceResource& resource);
     VkPhysicalDevice pick_physical_device();
     void create_image_views();
     void cleanup_image_views();
@@ -82,12 +175,32 @@ private:
     void create_swap_chain();
     void cleanup_swap_chain();
     void recreate_swap_chain();
-    VkShaderModule create_shader_module(const char* code, size_t code_size);
+    void prefetch_shader_overrides();
+    VkShaderModule create_shader_module(const void* code, size_t code_size);
+    // False when no override directory is set or it has no such file
+    bool load_shader_override(const char* name, VkShaderModule& shader_module);
+    VkShaderModule load_shader_module(const char* name);
+    VkShaderModule load_shader_variant(ShaderId id, uint32_t key);
     VkExtent2D choose_swap_extent(VkSurfaceCapabilitiesKHR *capabilities);
     void create_graphics_pipeline();
+    DeviceResource upload_buffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
+    void create_mesh_buffers(const void* vertices, size_t vertex_bytes, const uint32_t* indices, uint32_t index_count);
+    void add_mesh_buffers(const DeviceResource& vertex_resource, VkBufferUsageFlags vertex_usage,
+        const DeviceResource& index_resource, VkBufferUsageFlags index_usage, uint32_t index_count);
+    bool load_mesh_file(const char* path, const void* data, size_t size);
+    bool apply_mesh(const char* path, const void* data, size_t size);
+    void retire_mesh(const char* next_path);
+    void evict_cached_mesh(ResourceHandle handle);
+    bool show_cached_mesh(const char* path);
+    static void mesh_read_callback(const IO::ReadResult& result);
     void init_vulkan();
     void cleanup_vulkan();
-    void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index);
+    void create_command_buffers();
+    void cleanup_command_buffers();
+    RecordedState current_record_state(uint32_t image_index, uint32_t uniform_offset);
+    void record_command_buffer(RecordedCommands& recorded, uint32_t image_index, uint32_t uniform_offset);
+    void enforce_memory_budget(uint64_t completed);
+    uint64_t completed_frame();
 
     // Attributes
 
@@ -95,6 +208,18 @@ private:
 
     VkScreen vkScreen;
 
+    archive asset_archive = {0};
+
+    // Shader override reads started before device creation, by name, claimed when the module is built
+    std::unordered_map<std::string, uint64_t> shader_override_reads;
+    // Mesh read in flight, only the latest loadMesh() is applied
+    uint64_t pending_mesh_ticket = 0;
+    std::string pending_mesh_path;
+    // Empty for the built-in quad, which is not cached
+    std::string current_mesh_path;
+    // Meshes replaced since, shown longest ago first, evictable
+    std::vector<CachedMesh> mesh_cache;
+
     VkInstance vkInstance{0};
 
     VkDebugUtilsMessengerEXT debug_messenger{0};
@@ -105,6 +230,31 @@ private:
 
     VkQueue graphics_queue = {0};
     VkQueue present_queue = {0};
+    VkQueue transfer_queue = {0};   // VK_NULL_HANDLE without a transfer only family
+
+    // One monotonic timeline per queue submitted to, every wait on the GPU's progress goes through them
+    QueueTimeline graphics_timeline;
+    QueueTimeline transfer_timeline;    // unused without a transfer only family
+
+    // Sub-allocates every buffer's memory out of a few large blocks
+    VkAllocator allocator;
+
+    // Every long lived buffer, referred to by handle
+    ResourceTable resources;
+    ResourceHandle vertex_buffer = INVALID_RESOURCE_HANDLE;
+    ResourceHandle index_buffer = INVALID_RESOURCE_HANDLE;
+    ResourceHandle transient_buffer = INVALID_RESOURCE_HANDLE;   // frame allocator regions
+    ResourceHandle staging_buffer = INVALID_RESOURCE_HANDLE;     // upload manager ring
+
+    // Per-frame uniforms and other transient data
+    FrameAllocator frame_allocator;
+
+    // Every host to device copy goes through its staging ring
+    UploadManager uploader;
+    bool staging_cached = false;
+    // Device local memory is host visible and spans the whole of VRAM, nothing needs staging
+    bool direct_upload = false;
+    bool direct_upload_cached = false;
 
     // handle to images swap chain (images buffer)
     VkSwapchainKHR swap_chain = {0};
@@ -127,17 +277,46 @@ private:
     VkDescriptorSet descriptor_sets[MAX_FRAMES_IN_FLIGHT] = {0};
 
     VkCommandPool command_pool = {0};
-    const uint32_t command_buffers_count = MAX_FRAMES_IN_FLIGHT;
-    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT] = {0};
+    uint32_t graphics_family = 0;
+    // One primary per frame slot and swap chain image, indexed slot * swap_chain_images_count + image
+    std::vector<RecordedCommands> recorded_commands;
+    // One-off commands of a frame (defragmentation copies), submitted ahead of its primary
+    VkCommandBuffer frame_command_buffers[MAX_FRAMES_IN_FLIGHT] = {0};
+    // Per-worker pools the draws are recorded from, one set per primary above
+    CommandRecorder recorder;
+    std::vector<VkCommandBuffer> secondary_command_buffers;
+    // Replays a primary while nothing it was recorded from has changed
+    bool command_caching = true;
+    uint64_t geometry_generation = 0;       // bumped whenever the draw list or its buffers change
+    uint64_t descriptor_generation = 0;     // bumped whenever a descriptor set is written
+    uint64_t recorded_frame_count = 0;
+    uint64_t reused_frame_count = 0;
 
     const uint32_t image_available_semaphores_count = MAX_FRAMES_IN_FLIGHT;
     VkSemaphore image_available_semaphores[MAX_FRAMES_IN_FLIGHT] = {0};
     const uint32_t render_finished_semaphores_count = MAX_FRAMES_IN_FLIGHT;
     VkSemaphore render_finished_semaphores[MAX_FRAMES_IN_FLIGHT] = {0};
-    const uint32_t in_flight_fences_count = MAX_FRAMES_IN_FLIGHT;
-    VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT] = {0};
 
     uint32_t current_frame = 0;
+
+    // Resources released while frames may still use them
+    DeletionQueue deletion_queue;
+    // Number of the frame being built, and of the last frame each slot submitted
+    uint64_t frame_number = 1;
+    uint64_t submitted_frames[MAX_FRAMES_IN_FLIGHT] = {0};
+    // Graphics timeline value each slot's last frame signals
+    uint64_t submitted_values[MAX_FRAMES_IN_FLIGHT] = {0};
+    // Driver host allocations made by frames past the warm up
+    uint64_t steady_host_allocations = 0;
+
+    // Streamable resources, evicted least recently used first when a heap nears its budget
+    ResidencyManager residency;
+    bool over_memory_watermark = false;
+
+    // Moves tracked buffers out of sparse blocks, a budget's worth per frame
+    Defragmenter defragmenter;
+    // Passes of a frame and the barriers between them, rebuilt whenever a primary is recorded
+    RenderGraph render_graph;
     bool framebuffer_resized = false;
 
     VK::VkConfiguration vk_config{
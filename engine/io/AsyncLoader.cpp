@@ -0,0 +1,295 @@
+#include "AsyncLoader.hpp"
+
+namespace IO {
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Buffer pool  //////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+BufferPool::~BufferPool() {
+	for (uint32_t i = 0; i <= MAX_CLASS; i++) {
+		for (void* buffer : free_lists[i]) {
+			free(buffer);
+		}
+		free_lists[i].clear();
+	}
+}
+
+uint32_t BufferPool::size_class(uint64_t size) {
+	uint32_t size_class = MIN_CLASS;
+	while (size_class <= MAX_CLASS && (1ull << size_class) < size) {
+		size_class++;
+	}
+	return size_class;
+}
+
+void* BufferPool::acquire(uint64_t size) {
+	uint32_t cls = size_class(size);
+
+	// Too big to be worth keeping around
+	if (cls > MAX_CLASS) {
+		return malloc(size);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!free_lists[cls].empty()) {
+			void* buffer = free_lists[cls].back();
+			free_lists[cls].pop_back();
+			return buffer;
+		}
+	}
+
+	return malloc(1ull << cls);
+}
+
+void BufferPool::release(void* buffer, uint64_t size) {
+	if (buffer == nullptr) {
+		return;
+	}
+
+	uint32_t cls = size_class(size);
+
+	if (cls <= MAX_CLASS) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (free_lists[cls].size() < MAX_FREE_PER_CLASS) {
+			free_lists[cls].push_back(buffer);
+			return;
+		}
+	}
+
+	free(buffer);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Async loader  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+void AsyncLoader::start_workers(uint32_t worker_count) {
+	stopping = false;
+
+	if (worker_count == 0) {
+		worker_count = 1;
+	}
+
+	for (uint32_t i = 0; i < worker_count; i++) {
+		workers.emplace_back(&AsyncLoader::worker_loop, this);
+	}
+
+	printf("Async loader started with %u workers\n", worker_count);
+}
+
+void AsyncLoader::stop_workers() {
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobs_cv.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+
+	// Whatever finished while shutting down still owns pooled memory
+	ReadResult result;
+	while (completions.pop(result)) {
+		release(result);
+	}
+
+	for (auto& [ticket, unclaimed] : unclaimed_results) {
+		release(unclaimed);
+	}
+
+	unclaimed_results.clear();
+	pending_tickets.clear();
+}
+
+uint64_t AsyncLoader::submit(const ReadRequest* requests, uint32_t count) {
+	uint64_t first_ticket = next_ticket;
+
+	{
+		// One lock for the whole batch
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		for (uint32_t i = 0; i < count; i++) {
+			Job job;
+			job.ticket = next_ticket++;
+			job.path = requests[i].path;
+			job.request = requests[i];
+			job.request.path = nullptr;
+
+			pending_tickets.insert(job.ticket);
+			jobs.push_back(std::move(job));
+		}
+	}
+
+	if (count == 1) {
+		jobs_cv.notify_one();
+	} else {
+		jobs_cv.notify_all();
+	}
+
+	return first_ticket;
+}
+
+void AsyncLoader::worker_loop() {
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobs_mutex);
+			jobs_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (stopping) {
+				return;
+			}
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		ReadResult result;
+		execute(job, result);
+		complete(result);
+	}
+}
+
+void AsyncLoader::execute(Job& job, ReadResult& result) {
+	const ReadRequest& request = job.request;
+
+	result.ticket = job.ticket;
+	result.callback = request.callback;
+	result.user_data = request.user_data;
+
+	SDL_IOStream* stream = SDL_IOFromFile(job.path.c_str(), "rb");
+	if (stream == NULL) {
+		fprintf(stderr, "Failed to open file %s: %s\n", job.path.c_str(), SDL_GetError());
+		return;
+	}
+
+	Sint64 file_size = SDL_GetIOSize(stream);
+	if (file_size < 0 || request.offset > (uint64_t) file_size) {
+		fprintf(stderr, "Invalid read of file %s\n", job.path.c_str());
+		SDL_CloseIO(stream);
+		return;
+	}
+
+	uint64_t size = request.size != 0 ? request.size : (uint64_t) file_size - request.offset;
+	if (request.offset + size > (uint64_t) file_size) {
+		fprintf(stderr, "Read past the end of file %s\n", job.path.c_str());
+		SDL_CloseIO(stream);
+		return;
+	}
+
+	void* buffer = request.buffer;
+	if (buffer == nullptr) {
+		buffer = buffer_pool.acquire(size);
+		result.pooled = true;
+	} else if (request.buffer_capacity < size) {
+		fprintf(stderr, "Buffer too small to read file %s\n", job.path.c_str());
+		SDL_CloseIO(stream);
+		return;
+	}
+
+	result.data = buffer;
+	result.size = size;
+
+	if (SDL_SeekIO(stream, (Sint64) request.offset, SDL_IO_SEEK_SET) < 0) {
+		fprintf(stderr, "Failed to seek in file %s\n", job.path.c_str());
+		SDL_CloseIO(stream);
+		return;
+	}
+
+	uint64_t bytes_read = 0;
+	while (bytes_read < size) {
+		size_t read = SDL_ReadIO(stream, (char*) buffer + bytes_read, (size_t) (size - bytes_read));
+		if (read == 0) {
+			break;
+		}
+		bytes_read += read;
+	}
+
+	SDL_CloseIO(stream);
+
+	result.ok = bytes_read == size;
+	if (!result.ok) {
+		fprintf(stderr, "Short read on file %s\n", job.path.c_str());
+	}
+}
+
+void AsyncLoader::complete(const ReadResult& result) {
+	// The frame loop is behind, let it catch up rather than dropping the result
+	while (!completions.push(result)) {
+		std::this_thread::yield();
+	}
+
+	completed_count.fetch_add(1, std::memory_order_release);
+	completed_count.notify_all();
+}
+
+uint32_t AsyncLoader::drainCompletions() {
+	uint32_t drained = 0;
+
+	ReadResult result;
+	while (completions.pop(result)) {
+		pending_tickets.erase(result.ticket);
+		drained++;
+
+		if (result.callback == nullptr) {
+			unclaimed_results[result.ticket] = result;
+			continue;
+		}
+
+		result.callback(result);
+
+		// Pooled memory only lives for the duration of the callback
+		release(result);
+	}
+
+	return drained;
+}
+
+bool AsyncLoader::wait(uint64_t ticket, ReadResult* result) {
+	for (;;) {
+		uint32_t observed = completed_count.load(std::memory_order_acquire);
+		drainCompletions();
+
+		auto it = unclaimed_results.find(ticket);
+		if (it != unclaimed_results.end()) {
+			bool ok = it->second.ok;
+			if (result != nullptr) {
+				*result = it->second;
+			} else {
+				release(it->second);
+			}
+			unclaimed_results.erase(it);
+			return ok;
+		}
+
+		// Unknown, already claimed or handed to its callback: nothing to hand over
+		if (!isPending(ticket)) {
+			if (result != nullptr) {
+				*result = ReadResult{};
+				result->ticket = ticket;
+			}
+			return false;
+		}
+
+		completed_count.wait(observed, std::memory_order_acquire);
+	}
+}
+
+void AsyncLoader::release(ReadResult& result) {
+	if (result.pooled) {
+		buffer_pool.release(result.data, result.size);
+	}
+
+	result.data = nullptr;
+	result.pooled = false;
+}
+
+}
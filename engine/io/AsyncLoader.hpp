@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+extern "C" {
+	#include <SDL3/SDL.h>
+	#include <stdio.h>
+	#include <stdbool.h>
+	#include <stdlib.h>
+	#include <string.h>
+}
+
+#include "CompletionQueue.hpp"
+
+namespace IO {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Request types  ////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+struct ReadResult;
+typedef void (*ReadCallback)(const ReadResult& result);
+
+struct ReadRequest {
+    const char* path = nullptr;         // copied on submission
+    uint64_t offset = 0;
+    uint64_t size = 0;                  // 0 reads up to the end of the file
+    void* buffer = nullptr;             // caller-provided destination, nullptr to get a pooled buffer
+    uint64_t buffer_capacity = 0;
+    ReadCallback callback = nullptr;    // called from drainCompletions(), nullptr to claim the result with wait()
+    void* user_data = nullptr;
+};
+
+struct ReadResult {
+    uint64_t ticket = 0;
+    bool ok = false;
+    bool pooled = false;
+    void* data = nullptr;
+    uint64_t size = 0;
+    ReadCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+#define ASYNC_LOADER_DEFAULT_WORKERS 2
+#define ASYNC_LOADER_QUEUE_SIZE 1024
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Buffer pool  //////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Power of two size classes, buffers are recycled instead of going back to the heap
+ */
+class BufferPool {
+public:
+    ~BufferPool();
+
+    void* acquire(uint64_t size);
+    void release(void* buffer, uint64_t size);
+
+private:
+    static uint32_t size_class(uint64_t size);
+
+    static const uint32_t MIN_CLASS = 12;   // 4 KiB
+    static const uint32_t MAX_CLASS = 30;   // 1 GiB, anything larger is not pooled
+    static const uint32_t MAX_FREE_PER_CLASS = 8;
+
+    std::mutex mutex;
+    std::vector<void*> free_lists[MAX_CLASS + 1];
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  Async loader  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Reads files on a small pool of worker threads.
+ *
+ * Requests are submitted in batches from the frame loop thread, results come back on a lock-free
+ * completion queue that the frame loop drains once per frame with drainCompletions().
+ */
+class AsyncLoader {
+public:
+    static AsyncLoader& instance() {
+        static AsyncLoader instance;
+        return instance;
+    }
+
+    AsyncLoader(const AsyncLoader&) = delete;
+    void operator=(const AsyncLoader&) = delete;
+
+    static void Init(uint32_t worker_count = ASYNC_LOADER_DEFAULT_WORKERS) {
+        if (!initialized) {
+            initialized = true;
+            instance().start_workers(worker_count);
+        }
+    }
+
+    static void Quit() {
+        if (initialized) {
+            instance().stop_workers();
+            initialized = false;
+        }
+    }
+
+    // Without workers nothing submitted would ever complete
+    static bool isRunning() { return initialized; }
+
+    // Returns the ticket of the first request, the others follow in order
+    uint64_t submit(const ReadRequest* requests, uint32_t count);
+    uint64_t submit(const ReadRequest& request) { return submit(&request, 1); }
+
+    // Runs the callbacks of every finished request, returns how many completed
+    uint32_t drainCompletions();
+
+    // Blocks until the ticket has completed. Requests without callback hand their result over here,
+    // true when it was a successful read. False for a failed read and for a ticket with no result
+    // left to hand over (unknown, claimed already or given to its callback), result is then empty
+    bool wait(uint64_t ticket, ReadResult* result = nullptr);
+
+    bool isPending(uint64_t ticket) const { return pending_tickets.count(ticket) != 0; }
+
+    // Returns a pooled buffer to the pool, does nothing for caller-provided buffers
+    void release(ReadResult& result);
+
+private:
+    AsyncLoader() = default;
+
+    struct Job {
+        uint64_t ticket;
+        std::string path;
+        ReadRequest request;
+    };
+
+    void start_workers(uint32_t worker_count);
+    void stop_workers();
+    void worker_loop();
+    void execute(Job& job, ReadResult& result);
+    void complete(const ReadResult& result);
+
+    static inline bool initialized{false};
+
+    std::vector<std::thread> workers;
+
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    std::deque<Job> jobs;
+    bool stopping = false;
+
+    CompletionQueue<ReadResult, ASYNC_LOADER_QUEUE_SIZE> completions;
+    std::atomic<uint32_t> completed_count{0};
+    BufferPool buffer_pool;
+
+    // Only touched by the frame loop thread
+    uint64_t next_ticket = 1;
+    std::unordered_set<uint64_t> pending_tickets;
+    std::unordered_map<uint64_t, ReadResult> unclaimed_results;
+};
+
+static void Init() {
+    AsyncLoader::Init();
+}
+
+static void Quit() {
+    AsyncLoader::Quit();
+}
+
+} // Namespace IO
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace IO {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////  Completion queue  ///////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Bounded lock-free queue, any number of producers and consumers.
+ *
+ * Each slot carries a sequence number telling whether it is ready to be written (seq == pos) or
+ * read (seq == pos + 1), so producers and consumers only ever contend on their own cursor.
+ * Capacity must be a power of two.
+ */
+template <typename T, uint32_t Capacity>
+class CompletionQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    CompletionQueue() {
+        for (uint32_t i = 0; i < Capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    void operator=(const CompletionQueue&) = delete;
+
+    // Returns false when the queue is full
+    bool push(const T& value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot& slot = slots[pos & (Capacity - 1)];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false when the queue is empty
+    bool pop(T& value) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot& slot = slots[pos & (Capacity - 1)];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = slot.value;
+                    slot.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Keep the two cursors on separate cache lines
+    alignas(64) Slot slots[Capacity];
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+}
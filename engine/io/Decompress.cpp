@@ -0,0 +1,44 @@
+#include "Decompress.hpp"
+
+#include <vector>
+
+namespace IO {
+
+
+bool decompress_parallel(const compressed_asset& asset, void* dst, Core::ThreadPool& pool, bool direct) {
+	std::atomic<bool> ok{true};
+
+	if (direct) {
+		pool.parallelFor(asset.header->block_count, [&](uint32_t block, uint32_t worker) {
+			if (!compressed_asset_decompress_block(&asset, block, dst)) {
+				ok = false;
+			}
+		});
+		return ok;
+	}
+
+	uint32_t block_size = asset.header->block_size;
+	std::vector<std::vector<uint8_t>> scratch(pool.threadCount());
+
+	pool.parallelFor(asset.header->block_count, [&](uint32_t block, uint32_t worker) {
+		std::vector<uint8_t>& buffer = scratch[worker];
+		if (buffer.empty()) {
+			buffer.resize(block_size);
+		}
+
+		// Decode as if the scratch was block 0, then copy it to its real slot
+		compressed_asset single = asset;
+		single.blocks = &asset.blocks[block];
+
+		if (!compressed_asset_decompress_block(&single, 0, buffer.data())) {
+			ok = false;
+			return;
+		}
+
+		memcpy((uint8_t*) dst + (size_t) block * block_size, buffer.data(), asset.blocks[block].raw_size);
+	});
+
+	return ok;
+}
+
+}
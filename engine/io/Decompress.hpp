@@ -0,0 +1,21 @@
+#pragma once
+
+extern "C" {
+	#include "blockcomp.h"
+	#include <string.h>
+}
+
+#include "engine/core/ThreadPool.hpp"
+
+namespace IO {
+
+/*
+ * Decompresses every block of the asset into dst (raw_size bytes) across the pool.
+ *
+ * With direct set, blocks are decoded in place. Otherwise each worker decodes into a block sized
+ * scratch first and streams it out: LZ matches read back what was just written, which is very
+ * slow on uncached (write-combined) mappings, while a 64 KiB scratch stays in cache.
+ */
+bool decompress_parallel(const compressed_asset& asset, void* dst, Core::ThreadPool& pool, bool direct = true);
+
+}
@@ -0,0 +1,307 @@
+#include "Json.hpp"
+
+extern "C" {
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+}
+
+namespace IO {
+
+#define JSON_MAX_DEPTH 128
+
+const JsonValue* JsonValue::find(const char* key) const {
+	if (type != Type::Object) {
+		return nullptr;
+	}
+
+	for (const auto& [name, value] : object) {
+		if (name == key) {
+			return &value;
+		}
+	}
+	return nullptr;
+}
+
+double JsonValue::numberOr(const char* key, double fallback) const {
+	const JsonValue* value = find(key);
+	return value && value->type == Type::Number ? value->number : fallback;
+}
+
+const char* JsonValue::stringOr(const char* key, const char* fallback) const {
+	const JsonValue* value = find(key);
+	return value && value->type == Type::String ? value->string.c_str() : fallback;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////  Parser  ////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+struct JsonParser {
+	const char* cursor;
+	const char* end;
+	const char* error = nullptr;
+
+	void skip_whitespace() {
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+			cursor++;
+		}
+	}
+
+	bool fail(const char* message) {
+		if (error == nullptr) {
+			error = message;
+		}
+		return false;
+	}
+
+	bool expect(const char* literal) {
+		size_t length = strlen(literal);
+		if ((size_t) (end - cursor) < length || memcmp(cursor, literal, length) != 0) {
+			return fail("unexpected token");
+		}
+		cursor += length;
+		return true;
+	}
+
+	static void append_utf8(std::string& out, uint32_t codepoint) {
+		if (codepoint < 0x80) {
+			out += (char) codepoint;
+		} else if (codepoint < 0x800) {
+			out += (char) (0xC0 | (codepoint >> 6));
+			out += (char) (0x80 | (codepoint & 0x3F));
+		} else if (codepoint < 0x10000) {
+			out += (char) (0xE0 | (codepoint >> 12));
+			out += (char) (0x80 | ((codepoint >> 6) & 0x3F));
+			out += (char) (0x80 | (codepoint & 0x3F));
+		} else {
+			out += (char) (0xF0 | (codepoint >> 18));
+			out += (char) (0x80 | ((codepoint >> 12) & 0x3F));
+			out += (char) (0x80 | ((codepoint >> 6) & 0x3F));
+			out += (char) (0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	bool parse_hex4(uint32_t& value) {
+		if (end - cursor < 4) {
+			return fail("truncated unicode escape");
+		}
+
+		value = 0;
+		for (int i = 0; i < 4; i++) {
+			char c = *cursor++;
+			value <<= 4;
+			if (c >= '0' && c <= '9') {
+				value |= (uint32_t) (c - '0');
+			} else if (c >= 'a' && c <= 'f') {
+				value |= (uint32_t) (c - 'a' + 10);
+			} else if (c >= 'A' && c <= 'F') {
+				value |= (uint32_t) (c - 'A' + 10);
+			} else {
+				return fail("invalid unicode escape");
+			}
+		}
+		return true;
+	}
+
+	bool parse_string(std::string& out) {
+		cursor++;   // opening quote
+
+		while (cursor < end && *cursor != '"') {
+			// Copy runs of plain characters at once
+			const char* run = cursor;
+			while (cursor < end && *cursor != '"' && *cursor != '\\') {
+				cursor++;
+			}
+			out.append(run, cursor);
+
+			if (cursor < end && *cursor == '\\') {
+				if (++cursor >= end) {
+					return fail("truncated escape");
+				}
+
+				char c = *cursor++;
+				switch (c) {
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					uint32_t codepoint;
+					if (!parse_hex4(codepoint)) {
+						return false;
+					}
+
+					// Surrogate pair
+					if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+						cursor += 2;
+						uint32_t low;
+						if (!parse_hex4(low)) {
+							return false;
+						}
+						codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					}
+
+					append_utf8(out, codepoint);
+					break;
+				}
+				default:
+					return fail("invalid escape");
+				}
+			}
+		}
+
+		if (cursor >= end) {
+			return fail("unterminated string");
+		}
+		cursor++;   // closing quote
+		return true;
+	}
+
+	bool parse_number(double& out) {
+		// strtod needs a terminated buffer, numbers are short
+		char buffer[64];
+		size_t length = 0;
+
+		while (cursor + length < end && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", cursor[length]) != NULL) {
+			length++;
+		}
+		memcpy(buffer, cursor, length);
+		buffer[length] = '\0';
+
+		char* number_end;
+		out = strtod(buffer, &number_end);
+		if (number_end == buffer) {
+			return fail("invalid number");
+		}
+
+		cursor += number_end - buffer;
+		return true;
+	}
+
+	bool parse_value(JsonValue& out, int depth) {
+		if (depth > JSON_MAX_DEPTH) {
+			return fail("nesting too deep");
+		}
+
+		skip_whitespace();
+		if (cursor >= end) {
+			return fail("unexpected end of document");
+		}
+
+		switch (*cursor) {
+		case '{': {
+			out.type = JsonValue::Type::Object;
+			cursor++;
+			skip_whitespace();
+
+			if (cursor < end && *cursor == '}') {
+				cursor++;
+				return true;
+			}
+
+			while (true) {
+				skip_whitespace();
+				if (cursor >= end || *cursor != '"') {
+					return fail("expected a key");
+				}
+
+				out.object.emplace_back();
+				if (!parse_string(out.object.back().first)) {
+					return false;
+				}
+
+				skip_whitespace();
+				if (cursor >= end || *cursor != ':') {
+					return fail("expected ':'");
+				}
+				cursor++;
+
+				if (!parse_value(out.object.back().second, depth + 1)) {
+					return false;
+				}
+
+				skip_whitespace();
+				if (cursor < end && *cursor == ',') {
+					cursor++;
+				} else if (cursor < end && *cursor == '}') {
+					cursor++;
+					return true;
+				} else {
+					return fail("expected ',' or '}'");
+				}
+			}
+		}
+		case '[': {
+			out.type = JsonValue::Type::Array;
+			cursor++;
+			skip_whitespace();
+
+			if (cursor < end && *cursor == ']') {
+				cursor++;
+				return true;
+			}
+
+			while (true) {
+				out.array.emplace_back();
+				if (!parse_value(out.array.back(), depth + 1)) {
+					return false;
+				}
+
+				skip_whitespace();
+				if (cursor < end && *cursor == ',') {
+					cursor++;
+				} else if (cursor < end && *cursor == ']') {
+					cursor++;
+					return true;
+				} else {
+					return fail("expected ',' or ']'");
+				}
+			}
+		}
+		case '"':
+			out.type = JsonValue::Type::String;
+			return parse_string(out.string);
+		case 't':
+			out.type = JsonValue::Type::Bool;
+			out.boolean = true;
+			return expect("true");
+		case 'f':
+			out.type = JsonValue::Type::Bool;
+			out.boolean = false;
+			return expect("false");
+		case 'n':
+			out.type = JsonValue::Type::Null;
+			return expect("null");
+		default:
+			out.type = JsonValue::Type::Number;
+			return parse_number(out.number);
+		}
+	}
+};
+
+bool parse_json(const char* text, size_t size, JsonValue& out) {
+	JsonParser parser = {text, text + size};
+	out = JsonValue();
+
+	bool ok = parser.parse_value(out, 0);
+	if (ok) {
+		parser.skip_whitespace();
+		if (parser.cursor != parser.end) {
+			ok = parser.fail("trailing characters");
+		}
+	}
+
+	if (!ok) {
+		fprintf(stderr, "JSON parse error at offset %zu: %s\n", (size_t) (parser.cursor - text), parser.error);
+	}
+	return ok;
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+	#include <stddef.h>
+	#include <stdint.h>
+}
+
+namespace IO {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////  JSON  /////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Small DOM parser, enough for asset descriptions such as glTF. Numbers are doubles and
+ * strings are decoded to UTF-8, objects keep their keys in document order.
+ */
+struct JsonValue {
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    // nullptr when this is not an object or has no such key
+    const JsonValue* find(const char* key) const;
+
+    // Shorthands for optional members
+    double numberOr(const char* key, double fallback) const;
+    const char* stringOr(const char* key, const char* fallback) const;
+};
+
+bool parse_json(const char* text, size_t size, JsonValue& out);
+
+}
@@ -0,0 +1,1176 @@
+#include "MeshImporter.hpp"
+#include "Json.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace IO {
+
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+#define OBJ_CHUNKS_PER_THREAD 4
+#define GLTF_JOB_ELEMENTS 65536
+
+#define GLB_MAGIC 0x46546C67u           // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+#define GLTF_TRIANGLES 4
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////  Helpers  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static bool is_blank(char c) {
+	return c == ' ' || c == '\t';
+}
+
+// strtof needs a terminated string and honours the locale, this does neither
+static const char* parse_float(const char* p, const char* end, float* out) {
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	while (p < end && is_blank(*p)) {
+		p++;
+	}
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+
+	for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+		if (mantissa < 1000000000000000000ull) {
+			mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+		} else {
+			exponent++;
+		}
+	}
+
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+			if (mantissa < 1000000000000000000ull) {
+				mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+				exponent--;
+			}
+		}
+	}
+
+	if (digits == 0) {
+		return NULL;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool negative_exponent = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			negative_exponent = *e == '-';
+			e++;
+		}
+
+		int value = 0;
+		const char* first = e;
+		for (; e < end && *e >= '0' && *e <= '9'; e++) {
+			value = std::min(value * 10 + (*e - '0'), 1000);
+		}
+
+		if (e != first) {
+			exponent += negative_exponent ? -value : value;
+			p = e;
+		}
+	}
+
+	double result = (double) mantissa;
+	while (exponent > 22) {
+		result *= 1e22;
+		exponent -= 22;
+	}
+	while (exponent < -22) {
+		result /= 1e22;
+		exponent += 22;
+	}
+	result = exponent >= 0 ? result * powers[exponent] : result / powers[-exponent];
+
+	*out = (float) (negative ? -result : result);
+	return p;
+}
+
+static const char* parse_int(const char* p, const char* end, int64_t* out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	const char* first = p;
+	int64_t value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		value = value * 10 + (*p - '0');
+	}
+
+	if (p == first) {
+		return NULL;
+	}
+
+	*out = negative ? -value : value;
+	return p;
+}
+
+struct VertexRange {
+	size_t first;
+	size_t count;
+};
+
+// Bounds, and a colour from the position for the vertices that did not bring any
+static void finalize_mesh(VK::MeshData& mesh, const std::vector<VertexRange>& uncolored, Core::ThreadPool& pool) {
+	size_t vertex_count = mesh.vertices.size();
+	if (vertex_count == 0) {
+		glm_vec3_zero(mesh.bounds_min);
+		glm_vec3_zero(mesh.bounds_max);
+		mesh.submeshes.clear();
+		return;
+	}
+
+	uint32_t range_count = std::max(1u, std::min(pool.threadCount() * 4, (uint32_t) (vertex_count / 4096)));
+	size_t range_size = (vertex_count + range_count - 1) / range_count;
+
+	std::vector<float> range_bounds((size_t) range_count * 6);
+
+	pool.parallelFor(range_count, [&](uint32_t range, uint32_t worker) {
+		size_t first = range * range_size;
+		size_t last = std::min(vertex_count, first + range_size);
+
+		vec3 low = {FLT_MAX, FLT_MAX, FLT_MAX};
+		vec3 high = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+		for (size_t i = first; i < last; i++) {
+			glm_vec3_minv(low, mesh.vertices[i].pos, low);
+			glm_vec3_maxv(high, mesh.vertices[i].pos, high);
+		}
+
+		memcpy(&range_bounds[range * 6], low, sizeof(vec3));
+		memcpy(&range_bounds[range * 6 + 3], high, sizeof(vec3));
+	});
+
+	glm_vec3_copy(&range_bounds[0], mesh.bounds_min);
+	glm_vec3_copy(&range_bounds[3], mesh.bounds_max);
+	for (uint32_t range = 1; range < range_count; range++) {
+		if ((size_t) range * range_size < vertex_count) {
+			glm_vec3_minv(mesh.bounds_min, &range_bounds[range * 6], mesh.bounds_min);
+			glm_vec3_maxv(mesh.bounds_max, &range_bounds[range * 6 + 3], mesh.bounds_max);
+		}
+	}
+
+	// Submeshes without bounds of their own get the whole mesh's
+	if (mesh.submeshes.empty()) {
+		mesh.submeshes.push_back(mesh_file_submesh{0, (uint32_t) mesh.indices.size(), {0.0f}, {0.0f}});
+		mesh.submeshes.back().bounds_min[0] = FLT_MAX;
+	}
+	for (mesh_file_submesh& submesh : mesh.submeshes) {
+		if (submesh.bounds_min[0] > submesh.bounds_max[0]) {
+			glm_vec3_copy(mesh.bounds_min, submesh.bounds_min);
+			glm_vec3_copy(mesh.bounds_max, submesh.bounds_max);
+		}
+	}
+
+	if (uncolored.empty()) {
+		return;
+	}
+
+	vec3 extent;
+	glm_vec3_sub(mesh.bounds_max, mesh.bounds_min, extent);
+	for (int axis = 0; axis < 3; axis++) {
+		extent[axis] = extent[axis] > 0.0f ? 1.0f / extent[axis] : 0.0f;
+	}
+
+	std::vector<VertexRange> chunks;
+	for (const VertexRange& range : uncolored) {
+		for (size_t offset = 0; offset < range.count; offset += range_size) {
+			chunks.push_back(VertexRange{range.first + offset, std::min(range_size, range.count - offset)});
+		}
+	}
+
+	pool.parallelFor((uint32_t) chunks.size(), [&](uint32_t chunk, uint32_t worker) {
+		size_t first = chunks[chunk].first;
+		size_t last = first + chunks[chunk].count;
+
+		for (size_t i = first; i < last; i++) {
+			VK::Vertex& vertex = mesh.vertices[i];
+			glm_vec3_sub(vertex.pos, mesh.bounds_min, vertex.color);
+			glm_vec3_mul(vertex.color, extent, vertex.color);
+		}
+	});
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////  OBJ  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+	std::vector<VK::Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> relative;     // positions in indices holding an index relative to the chunk's first vertex
+	bool has_colors = false;
+	bool ok = true;
+};
+
+static void parse_obj_chunk(ObjChunk& chunk) {
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+
+	while (p < end) {
+		const char* line_end = (const char*) memchr(p, '\n', (size_t) (end - p));
+		if (line_end == NULL) {
+			line_end = end;
+		}
+
+		while (p < line_end && is_blank(*p)) {
+			p++;
+		}
+
+		if (line_end - p > 2 && p[0] == 'v' && is_blank(p[1])) {
+			VK::Vertex vertex = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+			const char* q = p + 2;
+
+			for (int i = 0; i < 3; i++) {
+				q = parse_float(q, line_end, &vertex.pos[i]);
+				if (q == NULL) {
+					chunk.ok = false;
+					return;
+				}
+			}
+
+			// Vertex colour extension: v x y z r g b
+			vec3 color;
+			if ((q = parse_float(q, line_end, &color[0])) && (q = parse_float(q, line_end, &color[1]))
+					&& (q = parse_float(q, line_end, &color[2]))) {
+				glm_vec3_copy(color, vertex.color);
+				chunk.has_colors = true;
+			}
+
+			chunk.vertices.push_back(vertex);
+		} else if (line_end - p > 2 && p[0] == 'f' && is_blank(p[1])) {
+			const char* q = p + 2;
+
+			uint32_t corners[3];
+			bool relative[3];
+			uint32_t corner_count = 0;
+
+			while (true) {
+				while (q < line_end && is_blank(*q)) {
+					q++;
+				}
+				if (q >= line_end || *q == '\r' || *q == '#') {
+					break;
+				}
+
+				int64_t index;
+				q = parse_int(q, line_end, &index);
+				if (q == NULL || index == 0) {
+					chunk.ok = false;
+					return;
+				}
+
+				// Skip /uv/normal
+				while (q < line_end && !is_blank(*q) && *q != '\r') {
+					q++;
+				}
+
+				// Negative indices count back from the last vertex read. Resolved against this chunk they
+				// wrap around as uint32_t, adding the chunk's first vertex later brings them back in range.
+				uint32_t corner = corner_count < 2 ? corner_count++ : 2;
+				relative[corner] = index < 0;
+				corners[corner] = relative[corner] ? (uint32_t) ((int64_t) chunk.vertices.size() + index) : (uint32_t) (index - 1);
+
+				// Fan triangulation
+				if (corner == 2) {
+					for (int i = 0; i < 3; i++) {
+						if (relative[i]) {
+							chunk.relative.push_back((uint32_t) chunk.indices.size());
+						}
+						chunk.indices.push_back(corners[i]);
+					}
+					corners[1] = corners[2];
+					relative[1] = relative[2];
+				}
+			}
+		}
+
+		p = line_end + 1;
+	}
+}
+
+bool import_obj(const char* text, size_t size, VK::MeshData& mesh, Core::ThreadPool& pool) {
+	// ----- Cut the text into line ranges -----
+	uint32_t chunk_count = std::max<size_t>(1, std::min<size_t>(pool.threadCount() * OBJ_CHUNKS_PER_THREAD, size / OBJ_MIN_CHUNK_SIZE));
+	std::vector<ObjChunk> chunks(chunk_count);
+
+	const char* end = text + size;
+	const char* cursor = text;
+
+	for (uint32_t i = 0; i < chunk_count; i++) {
+		const char* chunk_end = i + 1 == chunk_count ? end : text + (size / chunk_count) * (i + 1);
+
+		// Move the cut to the next line start
+		if (chunk_end < cursor) {
+			chunk_end = cursor;
+		}
+		if (chunk_end < end) {
+			const char* newline = (const char*) memchr(chunk_end, '\n', (size_t) (end - chunk_end));
+			chunk_end = newline ? newline + 1 : end;
+		}
+
+		chunks[i].begin = cursor;
+		chunks[i].end = chunk_end;
+		cursor = chunk_end;
+	}
+
+	// ----- Parse every range -----
+	pool.parallelFor(chunk_count, [&](uint32_t chunk, uint32_t worker) {
+		parse_obj_chunk(chunks[chunk]);
+	});
+
+	size_t vertex_count = 0;
+	size_t index_count = 0;
+	bool has_colors = false;
+
+	std::vector<size_t> vertex_offsets(chunk_count);
+	std::vector<size_t> index_offsets(chunk_count);
+
+	for (uint32_t i = 0; i < chunk_count; i++) {
+		if (!chunks[i].ok) {
+			fprintf(stderr, "OBJ parse error\n");
+			return false;
+		}
+
+		vertex_offsets[i] = vertex_count;
+		index_offsets[i] = index_count;
+		vertex_count += chunks[i].vertices.size();
+		index_count += chunks[i].indices.size();
+		has_colors = has_colors || chunks[i].has_colors;
+	}
+
+	if (vertex_count > UINT32_MAX) {
+		fprintf(stderr, "OBJ has too many vertices\n");
+		return false;
+	}
+
+	// ----- Stitch the ranges together -----
+	mesh.vertices.resize(vertex_count);
+	mesh.indices.resize(index_count);
+	mesh.submeshes.clear();
+
+	std::atomic<bool> ok{true};
+
+	pool.parallelFor(chunk_count, [&](uint32_t i, uint32_t worker) {
+		ObjChunk& chunk = chunks[i];
+		uint32_t* indices = mesh.indices.data() + index_offsets[i];
+
+		memcpy(mesh.vertices.data() + vertex_offsets[i], chunk.vertices.data(), chunk.vertices.size() * sizeof(VK::Vertex));
+		memcpy(indices, chunk.indices.data(), chunk.indices.size() * sizeof(uint32_t));
+
+		for (uint32_t position : chunk.relative) {
+			indices[position] += (uint32_t) vertex_offsets[i];
+		}
+
+		for (size_t j = 0; j < chunk.indices.size(); j++) {
+			if (indices[j] >= vertex_count) {
+				ok = false;
+				break;
+			}
+		}
+
+		// Done with the chunk, give the memory back while the other workers finish
+		std::vector<VK::Vertex>().swap(chunk.vertices);
+		std::vector<uint32_t>().swap(chunk.indices);
+	});
+
+	if (!ok) {
+		fprintf(stderr, "OBJ face references a missing vertex\n");
+		return false;
+	}
+
+	std::vector<VertexRange> uncolored;
+	if (!has_colors) {
+		uncolored.push_back(VertexRange{0, mesh.vertices.size()});
+	}
+
+	finalize_mesh(mesh, uncolored, pool);
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////  glTF  //////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+struct GltfBuffer {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	file_view view = {0};
+	std::vector<uint8_t> decoded;
+};
+
+struct GltfAccessor {
+	const uint8_t* data = nullptr;
+	size_t stride = 0;
+	uint32_t count = 0;
+	uint32_t component_type = 0;
+	uint32_t components = 0;
+	bool normalized = false;
+};
+
+enum class GltfStream {
+	Position,
+	Color,
+	Indices,
+	SequentialIndices,
+};
+
+struct GltfJob {
+	GltfStream stream;
+	const GltfAccessor* accessor;
+	uint32_t first;
+	uint32_t count;
+	size_t destination;     // first vertex or index written
+	uint32_t vertex_base;   // added to indices
+	uint32_t vertex_count;  // of the primitive, bounds the indices
+	vec4* transform;        // positions are baked into world space with it
+	bool flip_winding;      // indices, the transform mirrors
+};
+
+struct GltfPrimitive {
+	mesh_file_submesh submesh;
+	GltfAccessor position;
+	GltfAccessor color;
+	GltfAccessor indices;
+	bool has_color = false;
+	bool has_indices = false;
+	mat4 transform;         // of the node instancing it
+};
+
+// A node referencing a mesh, with its world transform
+struct GltfInstance {
+	size_t mesh;
+	mat4 transform;
+};
+
+static bool decode_base64(const char* text, size_t length, std::vector<uint8_t>& out) {
+	auto value_of = [](char c) -> int {
+		if (c >= 'A' && c <= 'Z') return c - 'A';
+		if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+		if (c >= '0' && c <= '9') return c - '0' + 52;
+		if (c == '+' || c == '-') return 62;
+		if (c == '/' || c == '_') return 63;
+		return -1;
+	};
+
+	out.clear();
+	out.reserve(length / 4 * 3);
+
+	uint32_t bits = 0;
+	int bit_count = 0;
+
+	for (size_t i = 0; i < length && text[i] != '='; i++) {
+		int value = value_of(text[i]);
+		if (value < 0) {
+			return false;
+		}
+
+		bits = (bits << 6) | (uint32_t) value;
+		bit_count += 6;
+
+		if (bit_count >= 8) {
+			bit_count -= 8;
+			out.push_back((uint8_t) (bits >> bit_count));
+		}
+	}
+
+	return true;
+}
+
+static bool load_gltf_buffers(const JsonValue& document, const uint8_t* glb_bin, size_t glb_bin_size, const char* base_dir, std::vector<GltfBuffer>& buffers) {
+	const JsonValue* list = document.find("buffers");
+	if (list == nullptr) {
+		return true;
+	}
+
+	buffers.resize(list->array.size());
+
+	for (size_t i = 0; i < list->array.size(); i++) {
+		const JsonValue& buffer = list->array[i];
+		const JsonValue* uri = buffer.find("uri");
+		size_t byte_length = (size_t) buffer.numberOr("byteLength", 0);
+
+		if (uri == nullptr) {
+			// The GLB binary chunk
+			if (i != 0 || glb_bin == nullptr) {
+				fprintf(stderr, "glTF buffer %zu has no data\n", i);
+				return false;
+			}
+			buffers[i].data = glb_bin;
+			buffers[i].size = glb_bin_size;
+		} else if (uri->string.compare(0, 5, "data:") == 0) {
+			size_t comma = uri->string.find(',');
+			if (comma == std::string::npos || !decode_base64(uri->string.c_str() + comma + 1, uri->string.size() - comma - 1, buffers[i].decoded)) {
+				fprintf(stderr, "glTF buffer %zu has an invalid data uri\n", i);
+				return false;
+			}
+			buffers[i].data = buffers[i].decoded.data();
+			buffers[i].size = buffers[i].decoded.size();
+		} else {
+			std::string path = std::string(base_dir) + uri->string;
+			if (!map_file_view(path.c_str(), FILE_VIEW_HINT_WILLNEED, &buffers[i].view)) {
+				return false;
+			}
+			buffers[i].data = (const uint8_t*) buffers[i].view.data;
+			buffers[i].size = buffers[i].view.size;
+		}
+
+		if (buffers[i].size < byte_length) {
+			fprintf(stderr, "glTF buffer %zu is shorter than its byteLength\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool resolve_accessor(const JsonValue& document, const std::vector<GltfBuffer>& buffers, const JsonValue* index, GltfAccessor& accessor) {
+	const JsonValue* accessors = document.find("accessors");
+	const JsonValue* views = document.find("bufferViews");
+
+	if (index == nullptr || index->type != JsonValue::Type::Number || accessors == nullptr
+			|| (size_t) index->number >= accessors->array.size()) {
+		fprintf(stderr, "glTF references a missing accessor\n");
+		return false;
+	}
+
+	const JsonValue& description = accessors->array[(size_t) index->number];
+
+	if (description.find("sparse") != nullptr) {
+		fprintf(stderr, "glTF sparse accessors are not supported\n");
+		return false;
+	}
+
+	const char* type = description.stringOr("type", "");
+	accessor.components = strcmp(type, "SCALAR") == 0 ? 1 : strcmp(type, "VEC2") == 0 ? 2 : strcmp(type, "VEC3") == 0 ? 3 : strcmp(type, "VEC4") == 0 ? 4 : 0;
+	accessor.component_type = (uint32_t) description.numberOr("componentType", 0);
+	accessor.count = (uint32_t) description.numberOr("count", 0);
+
+	const JsonValue* normalized = description.find("normalized");
+	accessor.normalized = normalized && normalized->type == JsonValue::Type::Bool && normalized->boolean;
+
+	size_t component_size = 0;
+	switch (accessor.component_type) {
+	case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: component_size = 1; break;
+	case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: component_size = 2; break;
+	case GLTF_UNSIGNED_INT: case GLTF_FLOAT: component_size = 4; break;
+	}
+
+	if (accessor.components == 0 || component_size == 0) {
+		fprintf(stderr, "glTF accessor has an unsupported type\n");
+		return false;
+	}
+
+	// No buffer view means all zeros, nothing a mesh can use
+	const JsonValue* view_index = description.find("bufferView");
+	if (view_index == nullptr || views == nullptr || (size_t) view_index->number >= views->array.size()) {
+		fprintf(stderr, "glTF accessor has no buffer view\n");
+		return false;
+	}
+
+	const JsonValue& view = views->array[(size_t) view_index->number];
+	size_t buffer = (size_t) view.numberOr("buffer", -1);
+	size_t view_offset = (size_t) view.numberOr("byteOffset", 0);
+	size_t view_length = (size_t) view.numberOr("byteLength", 0);
+	size_t element_size = component_size * accessor.components;
+
+	accessor.stride = (size_t) view.numberOr("byteStride", 0);
+	if (accessor.stride == 0) {
+		accessor.stride = element_size;
+	}
+
+	size_t offset = (size_t) description.numberOr("byteOffset", 0);
+	size_t needed = accessor.count == 0 ? 0 : offset + (size_t) (accessor.count - 1) * accessor.stride + element_size;
+
+	if (buffer >= buffers.size() || view_offset + view_length > buffers[buffer].size || needed > view_length) {
+		fprintf(stderr, "glTF accessor is out of bounds\n");
+		return false;
+	}
+
+	accessor.data = buffers[buffer].data + view_offset + offset;
+	return true;
+}
+
+static float read_component(const GltfAccessor& accessor, const uint8_t* element, uint32_t component) {
+	switch (accessor.component_type) {
+	case GLTF_FLOAT: {
+		float value;
+		memcpy(&value, element + component * 4, sizeof(value));
+		return value;
+	}
+	case GLTF_UNSIGNED_BYTE: {
+		float value = (float) element[component];
+		return accessor.normalized ? value / 255.0f : value;
+	}
+	case GLTF_UNSIGNED_SHORT: {
+		uint16_t value;
+		memcpy(&value, element + component * 2, sizeof(value));
+		return accessor.normalized ? (float) value / 65535.0f : (float) value;
+	}
+	case GLTF_BYTE: {
+		float value = (float) (int8_t) element[component];
+		return accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+	}
+	case GLTF_SHORT: {
+		int16_t value;
+		memcpy(&value, element + component * 2, sizeof(value));
+		return accessor.normalized ? std::max((float) value / 32767.0f, -1.0f) : (float) value;
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+static uint32_t read_index(const GltfAccessor& accessor, const uint8_t* element) {
+	switch (accessor.component_type) {
+	case GLTF_UNSIGNED_BYTE:
+		return element[0];
+	case GLTF_UNSIGNED_SHORT: {
+		uint16_t value;
+		memcpy(&value, element, sizeof(value));
+		return value;
+	}
+	default: {
+		uint32_t value;
+		memcpy(&value, element, sizeof(value));
+		return value;
+	}
+	}
+}
+
+// Where a triangle's index goes when the winding is reversed, its second and third corners swap
+static ptrdiff_t winding_offset(const GltfJob& job, uint32_t i) {
+	if (!job.flip_winding) {
+		return 0;
+	}
+
+	uint32_t corner = (job.first + i) % 3;
+	return corner == 1 ? 1 : corner == 2 ? -1 : 0;
+}
+
+static void node_transform(const JsonValue& node, mat4 transform) {
+	// Either a column major matrix or translation, rotation and scale applied in reverse order
+	const JsonValue* matrix = node.find("matrix");
+	if (matrix && matrix->array.size() == 16) {
+		for (int i = 0; i < 16; i++) {
+			transform[i / 4][i % 4] = (float) matrix->array[i].number;
+		}
+		return;
+	}
+
+	glm_mat4_identity(transform);
+
+	const JsonValue* translation = node.find("translation");
+	if (translation && translation->array.size() == 3) {
+		vec3 offset = {(float) translation->array[0].number, (float) translation->array[1].number, (float) translation->array[2].number};
+		glm_translate(transform, offset);
+	}
+
+	const JsonValue* rotation = node.find("rotation");
+	if (rotation && rotation->array.size() == 4) {
+		versor q;
+		glm_quat_init(q, (float) rotation->array[0].number, (float) rotation->array[1].number,
+			(float) rotation->array[2].number, (float) rotation->array[3].number);
+		glm_quat_rotate(transform, q, transform);
+	}
+
+	const JsonValue* scale = node.find("scale");
+	if (scale && scale->array.size() == 3) {
+		vec3 factors = {(float) scale->array[0].number, (float) scale->array[1].number, (float) scale->array[2].number};
+		glm_scale(transform, factors);
+	}
+}
+
+static bool collect_gltf_instances(const JsonValue& document, std::vector<GltfInstance>& instances) {
+	/*
+	 * Walks the default scene's node trees, every node with a mesh instances it with its world
+	 * transform. Files without scenes use every tree of their node hierarchy
+	 */
+	const JsonValue* nodes = document.find("nodes");
+	const JsonValue* scenes = document.find("scenes");
+	size_t node_count = nodes ? nodes->array.size() : 0;
+
+	std::vector<size_t> roots;
+	if (scenes && !scenes->array.empty()) {
+		size_t scene = (size_t) document.numberOr("scene", 0);
+		if (scene >= scenes->array.size()) {
+			fprintf(stderr, "glTF default scene %zu does not exist\n", scene);
+			return false;
+		}
+
+		const JsonValue* list = scenes->array[scene].find("nodes");
+		for (size_t i = 0; list && i < list->array.size(); i++) {
+			roots.push_back((size_t) list->array[i].number);
+		}
+	} else {
+		std::vector<bool> is_child(node_count, false);
+		for (size_t i = 0; i < node_count; i++) {
+			const JsonValue* children = nodes->array[i].find("children");
+			for (size_t c = 0; children && c < children->array.size(); c++) {
+				if ((size_t) children->array[c].number < node_count) {
+					is_child[(size_t) children->array[c].number] = true;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < node_count; i++) {
+			if (!is_child[i]) {
+				roots.push_back(i);
+			}
+		}
+	}
+
+	struct PendingNode {
+		size_t node;
+		mat4 parent;
+	};
+
+	// Depth first in document order, a node is visited once so a malformed cycle cannot loop
+	std::vector<PendingNode> stack(roots.size());
+	for (size_t i = 0; i < roots.size(); i++) {
+		stack[roots.size() - 1 - i].node = roots[i];
+		glm_mat4_identity(stack[roots.size() - 1 - i].parent);
+	}
+
+	std::vector<bool> visited(node_count, false);
+
+	while (!stack.empty()) {
+		PendingNode pending = stack.back();
+		stack.pop_back();
+
+		if (pending.node >= node_count || visited[pending.node]) {
+			fprintf(stderr, "glTF node hierarchy is invalid\n");
+			return false;
+		}
+		visited[pending.node] = true;
+
+		const JsonValue& node = nodes->array[pending.node];
+		mat4 local, world;
+		node_transform(node, local);
+		glm_mat4_mul(pending.parent, local, world);
+
+		const JsonValue* mesh = node.find("mesh");
+		if (mesh && mesh->type == JsonValue::Type::Number) {
+			GltfInstance& instance = instances.emplace_back();
+			instance.mesh = (size_t) mesh->number;
+			glm_mat4_copy(world, instance.transform);
+		}
+
+		const JsonValue* children = node.find("children");
+		for (size_t c = children ? children->array.size() : 0; c > 0; c--) {
+			PendingNode& child = stack.emplace_back();
+			child.node = (size_t) children->array[c - 1].number;
+			glm_mat4_copy(world, child.parent);
+		}
+	}
+
+	return true;
+}
+
+static bool resolve_gltf_mesh(const JsonValue& document, const std::vector<GltfBuffer>& buffers, size_t m, std::vector<GltfPrimitive>& primitives) {
+	const JsonValue* list = document.find("meshes")->array[m].find("primitives");
+	bool ok = true;
+
+	for (size_t p = 0; ok && list && p < list->array.size(); p++) {
+		const JsonValue& description = list->array[p];
+
+		if (description.numberOr("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+			fprintf(stderr, "Skipping glTF primitive %zu of mesh %zu, only triangle lists are supported\n", p, m);
+			continue;
+		}
+
+		const JsonValue* attributes = description.find("attributes");
+		GltfPrimitive primitive;
+
+		// POSITION accessors carry their bounds, an inverted box is filled in from the mesh later
+		primitive.submesh = mesh_file_submesh{0, 0, {FLT_MAX, 0.0f, 0.0f}, {-FLT_MAX, 0.0f, 0.0f}};
+		const JsonValue* position_index = attributes ? attributes->find("POSITION") : nullptr;
+		const JsonValue* accessors = document.find("accessors");
+
+		if (position_index && accessors && (size_t) position_index->number < accessors->array.size()) {
+			const JsonValue* low = accessors->array[(size_t) position_index->number].find("min");
+			const JsonValue* high = accessors->array[(size_t) position_index->number].find("max");
+
+			if (low && high && low->array.size() == 3 && high->array.size() == 3) {
+				for (int axis = 0; axis < 3; axis++) {
+					primitive.submesh.bounds_min[axis] = (float) low->array[axis].number;
+					primitive.submesh.bounds_max[axis] = (float) high->array[axis].number;
+				}
+			}
+		}
+
+		ok = attributes && resolve_accessor(document, buffers, attributes->find("POSITION"), primitive.position);
+		if (ok && primitive.position.components != 3) {
+			fprintf(stderr, "glTF positions must be VEC3\n");
+			ok = false;
+		}
+
+		if (ok && attributes->find("COLOR_0")) {
+			primitive.has_color = true;
+			ok = resolve_accessor(document, buffers, attributes->find("COLOR_0"), primitive.color)
+				&& primitive.color.components >= 3 && primitive.color.count == primitive.position.count;
+		}
+
+		if (ok && description.find("indices")) {
+			primitive.has_indices = true;
+			ok = resolve_accessor(document, buffers, description.find("indices"), primitive.indices)
+				&& primitive.indices.components == 1 && primitive.indices.component_type != GLTF_FLOAT;
+		}
+
+		if (ok) {
+			primitives.push_back(primitive);
+		}
+	}
+
+	return ok;
+}
+
+static bool run_gltf_job(const GltfJob& job, VK::MeshData& mesh) {
+	const GltfAccessor* accessor = job.accessor;
+
+	switch (job.stream) {
+	case GltfStream::Position:
+		for (uint32_t i = 0; i < job.count; i++) {
+			const uint8_t* element = accessor->data + (size_t) (job.first + i) * accessor->stride;
+			float* pos = mesh.vertices[job.destination + i].pos;
+
+			if (accessor->component_type == GLTF_FLOAT) {
+				memcpy(pos, element, sizeof(vec3));
+			} else {
+				for (uint32_t c = 0; c < 3; c++) {
+					pos[c] = read_component(*accessor, element, c);
+				}
+			}
+
+			glm_mat4_mulv3(job.transform, pos, 1.0f, pos);
+		}
+		return true;
+
+	case GltfStream::Color:
+		for (uint32_t i = 0; i < job.count; i++) {
+			const uint8_t* element = accessor->data + (size_t) (job.first + i) * accessor->stride;
+			float* color = mesh.vertices[job.destination + i].color;
+
+			for (uint32_t c = 0; c < 3; c++) {
+				color[c] = read_component(*accessor, element, c);
+			}
+		}
+		return true;
+
+	case GltfStream::Indices:
+		for (uint32_t i = 0; i < job.count; i++) {
+			uint32_t index = read_index(*accessor, accessor->data + (size_t) (job.first + i) * accessor->stride);
+			if (index >= job.vertex_count) {
+				return false;
+			}
+			mesh.indices[job.destination + i + winding_offset(job, i)] = job.vertex_base + index;
+		}
+		return true;
+
+	case GltfStream::SequentialIndices:
+		for (uint32_t i = 0; i < job.count; i++) {
+			mesh.indices[job.destination + i + winding_offset(job, i)] = job.vertex_base + job.first + i;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static void push_jobs(std::vector<GltfJob>& jobs, GltfJob job, uint32_t total) {
+	for (uint32_t first = 0; first < total; first += GLTF_JOB_ELEMENTS) {
+		job.count = std::min<uint32_t>(GLTF_JOB_ELEMENTS, total - first);
+		jobs.push_back(job);
+
+		job.first += job.count;
+		job.destination += job.count;
+	}
+}
+
+bool import_gltf(const void* data, size_t size, const char* base_dir, VK::MeshData& mesh, Core::ThreadPool& pool) {
+	const uint8_t* bytes = (const uint8_t*) data;
+	const char* json = (const char*) data;
+	size_t json_size = size;
+	const uint8_t* bin = nullptr;
+	size_t bin_size = 0;
+
+	// ----- GLB container: header then JSON and BIN chunks -----
+	uint32_t magic = 0;
+	if (size >= 12) {
+		memcpy(&magic, bytes, sizeof(magic));
+	}
+
+	if (magic == GLB_MAGIC) {
+		uint32_t header[3];
+		memcpy(header, bytes, sizeof(header));
+
+		if (header[1] != 2 || header[2] > size) {
+			fprintf(stderr, "Unsupported or truncated GLB\n");
+			return false;
+		}
+
+		json = nullptr;
+		for (size_t offset = 12; offset + 8 <= header[2];) {
+			uint32_t chunk[2];
+			memcpy(chunk, bytes + offset, sizeof(chunk));
+
+			if (offset + 8 + chunk[0] > header[2]) {
+				fprintf(stderr, "GLB chunk out of bounds\n");
+				return false;
+			}
+
+			if (chunk[1] == GLB_CHUNK_JSON && json == nullptr) {
+				json = (const char*) bytes + offset + 8;
+				json_size = chunk[0];
+			} else if (chunk[1] == GLB_CHUNK_BIN && bin == nullptr) {
+				bin = bytes + offset + 8;
+				bin_size = chunk[0];
+			}
+
+			offset += 8 + ((chunk[0] + 3) & ~3u);
+		}
+
+		if (json == nullptr) {
+			fprintf(stderr, "GLB has no JSON chunk\n");
+			return false;
+		}
+	}
+
+	JsonValue document;
+	if (!parse_json(json, json_size, document)) {
+		return false;
+	}
+
+	std::vector<GltfBuffer> buffers;
+	bool ok = load_gltf_buffers(document, bin, bin_size, base_dir, buffers);
+
+	// ----- Resolve the primitives of every mesh instance and lay them out one after the other -----
+	std::vector<GltfInstance> instances;
+	ok = ok && collect_gltf_instances(document, instances);
+
+	// A mesh is resolved once however many nodes use it
+	const JsonValue* meshes = document.find("meshes");
+	std::vector<std::vector<GltfPrimitive>> mesh_primitives(meshes ? meshes->array.size() : 0);
+	std::vector<bool> resolved(mesh_primitives.size(), false);
+	std::vector<GltfPrimitive> primitives;
+
+	for (size_t i = 0; ok && i < instances.size(); i++) {
+		size_t m = instances[i].mesh;
+		if (m >= mesh_primitives.size()) {
+			fprintf(stderr, "glTF node references a missing mesh %zu\n", m);
+			ok = false;
+			break;
+		}
+
+		if (!resolved[m]) {
+			resolved[m] = true;
+			ok = resolve_gltf_mesh(document, buffers, m, mesh_primitives[m]);
+		}
+
+		for (size_t p = 0; ok && p < mesh_primitives[m].size(); p++) {
+			GltfPrimitive& primitive = primitives.emplace_back(mesh_primitives[m][p]);
+			glm_mat4_copy(instances[i].transform, primitive.transform);
+
+			// The accessor bounds are in the mesh's space
+			mesh_file_submesh& submesh = primitive.submesh;
+			if (submesh.bounds_min[0] <= submesh.bounds_max[0]) {
+				vec3 box[2], world_box[2];
+				glm_vec3_copy(submesh.bounds_min, box[0]);
+				glm_vec3_copy(submesh.bounds_max, box[1]);
+				glm_aabb_transform(box, primitive.transform, world_box);
+				glm_vec3_copy(world_box[0], submesh.bounds_min);
+				glm_vec3_copy(world_box[1], submesh.bounds_max);
+			}
+		}
+	}
+
+	if (!ok) {
+		fprintf(stderr, "Invalid glTF mesh\n");
+	}
+
+	std::vector<GltfJob> jobs;
+	std::vector<mesh_file_submesh> submeshes;
+	std::vector<VertexRange> uncolored;
+	size_t vertex_count = 0;
+	size_t index_count = 0;
+
+	for (GltfPrimitive& primitive : primitives) {
+		if (!ok) {
+			break;
+		}
+
+		uint32_t primitive_indices = primitive.has_indices ? primitive.indices.count : primitive.position.count;
+		if (vertex_count + primitive.position.count > UINT32_MAX) {
+			fprintf(stderr, "glTF has too many vertices\n");
+			ok = false;
+			break;
+		}
+
+		// A mirroring transform turns the triangles inside out unless their winding is reversed
+		bool flip_winding = glm_mat4_det(primitive.transform) < 0.0f && primitive_indices % 3 == 0;
+
+		GltfJob job = {GltfStream::Position, &primitive.position, 0, 0, vertex_count, (uint32_t) vertex_count, primitive.position.count,
+			primitive.transform, false};
+		push_jobs(jobs, job, primitive.position.count);
+
+		if (primitive.has_color) {
+			job.stream = GltfStream::Color;
+			job.accessor = &primitive.color;
+			push_jobs(jobs, job, primitive.position.count);
+		} else {
+			uncolored.push_back(VertexRange{vertex_count, primitive.position.count});
+		}
+
+		job.stream = primitive.has_indices ? GltfStream::Indices : GltfStream::SequentialIndices;
+		job.accessor = &primitive.indices;
+		job.destination = index_count;
+		job.flip_winding = flip_winding;
+		push_jobs(jobs, job, primitive_indices);
+
+		mesh_file_submesh submesh = primitive.submesh;
+		submesh.first_index = (uint32_t) index_count;
+		submesh.index_count = primitive_indices;
+		submeshes.push_back(submesh);
+
+		vertex_count += primitive.position.count;
+		index_count += primitive_indices;
+	}
+
+	// ----- Convert every accessor range into its slot -----
+	if (ok) {
+		mesh.vertices.assign(vertex_count, VK::Vertex{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}});
+		mesh.indices.resize(index_count);
+		mesh.submeshes = std::move(submeshes);
+
+		std::atomic<bool> jobs_ok{true};
+		pool.parallelFor((uint32_t) jobs.size(), [&](uint32_t i, uint32_t worker) {
+			if (!run_gltf_job(jobs[i], mesh)) {
+				jobs_ok = false;
+			}
+		});
+
+		if (!jobs_ok) {
+			fprintf(stderr, "glTF index references a missing vertex\n");
+			ok = false;
+		}
+	}
+
+	for (GltfBuffer& buffer : buffers) {
+		release_file_view(&buffer.view);
+	}
+
+	if (ok) {
+		finalize_mesh(mesh, uncolored, pool);
+	}
+	return ok;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////  Files  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+mesh_file_data describe_mesh(const VK::MeshData& mesh) {
+	mesh_file_data data;
+	memset(&data, 0, sizeof(data));
+
+	data.vertex_layout = MESH_VERTEX_LAYOUT_POS3_COLOR3;
+	data.vertex_stride = sizeof(VK::Vertex);
+	data.vertex_count = (uint32_t) mesh.vertices.size();
+	data.index_count = (uint32_t) mesh.indices.size();
+	data.submesh_count = (uint32_t) mesh.submeshes.size();
+	data.vertices = mesh.vertices.data();
+	data.indices = mesh.indices.data();
+	data.submeshes = mesh.submeshes.data();
+	glm_vec3_copy((float*) mesh.bounds_min, data.bounds_min);
+	glm_vec3_copy((float*) mesh.bounds_max, data.bounds_max);
+
+	return data;
+}
+
+bool write_mesh_file(const char* path, const VK::MeshData& mesh, uint32_t flags) {
+	mesh_file_data data = describe_mesh(mesh);
+	data.flags = flags;
+	return mesh_file_write(path, &data);
+}
+
+
+bool import_mesh_data(const char* path, const void* data, size_t size, VK::MeshData& mesh, Core::ThreadPool& pool) {
+	const char* extension = strrchr(path, '.');
+	bool is_obj = extension && SDL_strcasecmp(extension, ".obj") == 0;
+	bool is_gltf = extension && (SDL_strcasecmp(extension, ".gltf") == 0 || SDL_strcasecmp(extension, ".glb") == 0);
+
+	if (!is_obj && !is_gltf) {
+		fprintf(stderr, "Unknown mesh format %s\n", path);
+		return false;
+	}
+
+	bool ok;
+	if (is_obj) {
+		ok = import_obj((const char*) data, size, mesh, pool);
+	} else {
+		// External buffers are relative to the .gltf
+		const char* slash = strrchr(path, '/');
+		const char* backslash = strrchr(path, '\\');
+		if (backslash > slash) {
+			slash = backslash;
+		}
+		std::string base_dir = slash ? std::string(path, slash + 1) : std::string();
+
+		ok = import_gltf(data, size, base_dir.c_str(), mesh, pool);
+	}
+
+	if (ok) {
+		printf(" Imported %s (%zu vertices, %zu triangles)\n", path, mesh.vertices.size(), mesh.indices.size() / 3);
+	} else {
+		fprintf(stderr, "Failed to import %s\n", path);
+	}
+	return ok;
+}
+
+bool import_mesh(const char* path, VK::MeshData& mesh, Core::ThreadPool& pool) {
+	file_view view;
+	if (!map_file_view(path, FILE_VIEW_HINT_SEQUENTIAL | FILE_VIEW_HINT_WILLNEED, &view)) {
+		return false;
+	}
+
+	bool ok = import_mesh_data(path, view.data, view.size, mesh, pool);
+
+	release_file_view(&view);
+	return ok;
+}
+
+}
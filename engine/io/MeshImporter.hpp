@@ -0,0 +1,43 @@
+#pragma once
+
+#include "engine/core/ThreadPool.hpp"
+#include "engine/graphics/VkCommon.hpp"
+
+namespace IO {
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////  Mesh importer  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Turns OBJ and glTF 2.0 (.gltf with external or embedded buffers, and .glb) files into a single
+ * engine mesh.
+ *
+ * OBJ text is cut into line ranges parsed on every worker, the ranges are then stitched together
+ * with a prefix sum. glTF files are flattened from the default scene's node hierarchy: each node
+ * with a mesh adds that mesh's primitives with the node's world transform baked into the positions,
+ * a mesh used by several nodes is added once per node and meshes no node uses are left out. The
+ * offsets of every primitive are known from the accessor counts up front, so each accessor (split
+ * into fixed size ranges) is converted straight into its final slot in parallel.
+ *
+ * Vertices without a colour get one from their position in the bounding box. OBJ files become a
+ * single submesh, glTF primitives one submesh per instance.
+ */
+
+bool import_mesh(const char* path, VK::MeshData& mesh, Core::ThreadPool& pool = Core::ThreadPool::shared());
+
+// Same from a file already read, path picks the format and resolves external buffer uris
+bool import_mesh_data(const char* path, const void* data, size_t size, VK::MeshData& mesh,
+    Core::ThreadPool& pool = Core::ThreadPool::shared());
+
+bool import_obj(const char* text, size_t size, VK::MeshData& mesh, Core::ThreadPool& pool);
+
+// base_dir resolves external buffer uris, data is either JSON or a GLB container
+bool import_gltf(const void* data, size_t size, const char* base_dir, VK::MeshData& mesh, Core::ThreadPool& pool);
+
+// Runtime binary (meshfile.h) of an imported mesh, the description points into the mesh
+mesh_file_data describe_mesh(const VK::MeshData& mesh);
+// flags are MESH_FILE_FLAG_*
+bool write_mesh_file(const char* path, const VK::MeshData& mesh, uint32_t flags = 0);
+
+}
@@ -0,0 +1,79 @@
+#ifndef STEVE_LIB_ARCHIVE_H
+#define STEVE_LIB_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "io.h"
+
+/*
+ * Packed asset archive
+ *
+ * Layout (little endian):
+ *   archive_header
+ *   archive_entry[entry_count]        sorted by name hash
+ *   uint32_t buckets[bucket_count+1]  first entry of each range of hashes sharing their top bits
+ *   names                             entry names, not null terminated
+ *   blobs                             each one starting on an ARCHIVE_BLOB_ALIGNMENT boundary
+ *
+ * The whole archive is mapped once, a lookup hashes the name, jumps to its bucket and scans the
+ * handful of entries in it - no per-asset syscall.
+ */
+
+#define ARCHIVE_MAGIC 0x4B415056u   // "VPAK"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOB_ALIGNMENT 4096
+
+struct archive_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t bucket_bits;
+	uint64_t entries_offset;
+	uint64_t buckets_offset;
+	uint64_t names_offset;
+	uint64_t names_size;
+	uint64_t data_offset;
+	uint64_t total_size;
+};
+
+struct archive_entry {
+	uint64_t hash;
+	uint64_t offset;    // from the start of the archive
+	uint64_t size;
+	uint32_t name_offset;
+	uint32_t name_length;
+};
+
+struct archive_blob {
+	const void *data;
+	size_t size;
+};
+
+struct archive {
+	struct file_view view;
+	const struct archive_header *header;
+	const struct archive_entry *entries;
+	const uint32_t *buckets;
+	const char *names;
+};
+
+uint64_t archive_hash_name(const char *name);
+
+// Reader
+bool archive_open(const char *filename, struct archive *archive);
+void archive_close(struct archive *archive);
+bool archive_find(const struct archive *archive, const char *name, struct archive_blob *blob);
+bool archive_find_hash(const struct archive *archive, uint64_t hash, struct archive_blob *blob);
+
+// Writer
+struct archive_builder;
+
+struct archive_builder *archive_builder_create(void);
+void archive_builder_destroy(struct archive_builder *builder);
+bool archive_builder_add_memory(struct archive_builder *builder, const char *name, const void *data, size_t size);
+bool archive_builder_add_file(struct archive_builder *builder, const char *name, const char *filename);
+bool archive_builder_write(struct archive_builder *builder, const char *filename);
+
+#endif
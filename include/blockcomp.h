@@ -0,0 +1,61 @@
+#ifndef STEVE_LIB_BLOCKCOMP_H
+#define STEVE_LIB_BLOCKCOMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Block compressed assets
+ *
+ * Payloads are cut into fixed size blocks compressed independently with an LZ4 block format
+ * compatible codec, so any block can be decompressed on any thread straight into its slot of the
+ * destination buffer.
+ *
+ * Layout (little endian):
+ *   compressed_header
+ *   compressed_block[block_count]
+ *   block data
+ *
+ * A block whose compressed size equals its raw size is stored uncompressed.
+ */
+
+#define COMPRESSED_MAGIC 0x5A4C4256u    // "VBLZ"
+#define COMPRESSED_VERSION 1
+#define COMPRESSED_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+struct compressed_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t block_size;
+	uint32_t block_count;
+	uint64_t raw_size;
+};
+
+struct compressed_block {
+	uint64_t offset;    // from the start of the asset
+	uint32_t compressed_size;
+	uint32_t raw_size;
+};
+
+struct compressed_asset {
+	const struct compressed_header *header;
+	const struct compressed_block *blocks;
+	const uint8_t *base;
+	size_t size;
+};
+
+// Raw LZ block codec
+size_t lz_compress_bound(size_t size);
+size_t lz_compress_block(const void *src, size_t src_size, void *dst, size_t dst_capacity);
+bool lz_decompress_block(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+// Asset container
+bool compressed_asset_is(const void *data, size_t size);
+bool compressed_asset_parse(const void *data, size_t size, struct compressed_asset *asset);
+bool compressed_asset_decompress_block(const struct compressed_asset *asset, uint32_t block, void *dst);
+
+// Returns a malloc'd container, NULL on failure
+void *compressed_asset_create(const void *data, size_t size, uint32_t block_size, size_t *out_size);
+
+#endif
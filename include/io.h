@@ -2,8 +2,34 @@
 #define STEVE_LIB_IO_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 char *read_entire_binary_file(const char *filename, size_t *size);
 
+/*
+ * Read-only view of a whole file mapped into memory.
+ *
+ * The data pointer is page aligned (so it is always suitably aligned for SPIR-V words) and stays
+ * valid until release_file_view() is called. An empty file maps to data == NULL, size == 0.
+ */
+struct file_view {
+	const void *data;
+	size_t size;
+
+	// Platform handles - private to io.c
+	void *mapping;
+	size_t mapping_size;
+};
+
+// Access pattern hints given to the kernel when the file is mapped
+enum file_view_hint {
+	FILE_VIEW_HINT_NONE = 0,
+	FILE_VIEW_HINT_SEQUENTIAL = 1 << 0,   // the view will be read front to back (MADV_SEQUENTIAL)
+	FILE_VIEW_HINT_WILLNEED = 1 << 1,     // start paging the file in now (MADV_WILLNEED)
+};
+
+bool map_file_view(const char *filename, int hints, struct file_view *view);
+void release_file_view(struct file_view *view);
+
 #endif
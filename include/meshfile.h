@@ -0,0 +1,101 @@
+#ifndef STEVE_LIB_MESHFILE_H
+#define STEVE_LIB_MESHFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "io.h"
+
+/*
+ * Runtime mesh binary
+ *
+ * Layout (little endian):
+ *   mesh_file_header
+ *   mesh_file_submesh[submesh_count]
+ *   vertices    vertex_count * vertex_stride bytes, in the exact layout the pipeline binds
+ *   indices     uint32_t[index_count]
+ *
+ * Every section starts on a MESH_FILE_ALIGNMENT boundary. Nothing is parsed at load time: the file
+ * is mapped, the header is checked and the section pointers are fixed up from their offsets, the
+ * vertex and index bytes can be copied straight into a staging buffer.
+ *
+ * With MESH_FILE_FLAG_COMPRESSED the vertex and index sections each hold a block compressed asset
+ * (blockcomp.h) of those bytes instead, running up to the next section. They are decompressed
+ * across the workers straight into staging memory.
+ */
+
+#define MESH_FILE_MAGIC 0x48534D56u     // "VMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGNMENT 64
+
+// Header flags
+#define MESH_FILE_FLAG_COMPRESSED 0x1u
+
+// Vertex layouts, a file is only usable by a pipeline built for its layout
+enum mesh_vertex_layout {
+	MESH_VERTEX_LAYOUT_POS3_COLOR3 = 1,     // float position[3], float color[3]
+};
+
+struct mesh_file_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertex_layout;
+	uint32_t vertex_stride;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t submesh_count;
+	uint32_t flags;
+	float bounds_min[3];
+	float bounds_max[3];
+	uint64_t submeshes_offset;
+	uint64_t vertices_offset;
+	uint64_t indices_offset;
+	uint64_t total_size;
+};
+
+struct mesh_file_submesh {
+	uint32_t first_index;
+	uint32_t index_count;
+	float bounds_min[3];
+	float bounds_max[3];
+};
+
+// Loaded file, every pointer points into the mapping
+struct mesh_file {
+	struct file_view view;
+	const struct mesh_file_header *header;
+	const struct mesh_file_submesh *submeshes;
+	const void *vertices;
+	const uint32_t *indices;
+	size_t vertices_size;       // stored bytes, the containers when compressed
+	size_t indices_size;
+};
+
+// What the writer serialises
+struct mesh_file_data {
+	uint32_t flags;
+	uint32_t vertex_layout;
+	uint32_t vertex_stride;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t submesh_count;
+	const void *vertices;
+	const uint32_t *indices;
+	const struct mesh_file_submesh *submeshes;
+	float bounds_min[3];
+	float bounds_max[3];
+};
+
+// Reader, parse works on any memory (e.g. an archive blob) and leaves view empty. Every index is
+// checked against vertex_count, except compressed ones: check those once decompressed
+bool mesh_file_open(const char *filename, struct mesh_file *mesh);
+bool mesh_file_parse(const void *data, size_t size, struct mesh_file *mesh);
+bool mesh_file_check_indices(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count);
+void mesh_file_close(struct mesh_file *mesh);
+
+// Writer, serialize returns a malloc'd buffer
+void *mesh_file_serialize(const struct mesh_file_data *data, size_t *out_size);
+bool mesh_file_write(const char *filename, const struct mesh_file_data *data);
+
+#endif
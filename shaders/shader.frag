@@ -1,9 +1,21 @@
 #version 450
 
+// @permutation VERTEX_COLOR
+// @permutation DEPTH_ONLY
+// @exclusive VERTEX_COLOR DEPTH_ONLY
+
+#ifdef VERTEX_COLOR
 layout(location = 0) in vec3 fragColor;
+#endif
 
+#ifndef DEPTH_ONLY
 layout(location = 0) out vec4 outColor;
+#endif
 
 void main() {
+#if defined(VERTEX_COLOR)
     outColor = vec4(fragColor, 1.0);
+#elif !defined(DEPTH_ONLY)
+    outColor = vec4(1.0);
+#endif
 }
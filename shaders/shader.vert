@@ -1,17 +1,23 @@
 #version 450
 
+// @permutation VERTEX_COLOR
+
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
-layout(location = 0) in vec2 position_in;
+layout(location = 0) in vec3 position_in;
 layout(location = 1) in vec3 color_in;
 
+#ifdef VERTEX_COLOR
 layout(location = 0) out vec3 frag_color;
+#endif
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position_in, 0.0, 1.0);
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position_in, 1.0);
+#ifdef VERTEX_COLOR
     frag_color = color_in;
+#endif
 }
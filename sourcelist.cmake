@@ -1,7 +1,13 @@
 set(source_list
 src/main.cpp
 src/io.c
+src/archive.c
+src/blockcomp.c
+src/meshfile.c
 )
 set(header_list
 include/io.h
+include/archive.h
+include/blockcomp.h
+include/meshfile.h
 )
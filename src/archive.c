@@ -0,0 +1,387 @@
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t archive_hash_name(const char *name) {
+	// FNV-1a, 64 bit
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (const unsigned char *c = (const unsigned char *) name; *c; c++) {
+		hash ^= *c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// offset + length <= size, without the sum overflowing
+static bool range_fits(uint64_t offset, uint64_t length, uint64_t size) {
+	return offset <= size && length <= size - offset;
+}
+
+static uint32_t bucket_of(uint64_t hash, uint32_t bucket_bits) {
+	return bucket_bits == 0 ? 0 : (uint32_t) (hash >> (64 - bucket_bits));
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////  Reader  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool archive_open(const char *filename, struct archive *archive) {
+	memset(archive, 0, sizeof(*archive));
+
+	if (!map_file_view(filename, FILE_VIEW_HINT_NONE, &archive->view)) {
+		return false;
+	}
+
+	const char *base = (const char *) archive->view.data;
+	size_t size = archive->view.size;
+
+	if (size < sizeof(struct archive_header)) {
+		fprintf(stderr, "Archive %s is truncated\n", filename);
+		archive_close(archive);
+		return false;
+	}
+
+	const struct archive_header *header = (const struct archive_header *) base;
+
+	if (header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION) {
+		fprintf(stderr, "Archive %s has a bad magic or an unsupported version\n", filename);
+		archive_close(archive);
+		return false;
+	}
+
+	if (header->bucket_bits > 31) {
+		fprintf(stderr, "Archive %s has an invalid table of contents\n", filename);
+		archive_close(archive);
+		return false;
+	}
+
+	uint64_t bucket_count = 1ull << header->bucket_bits;
+	uint64_t entries_size = (uint64_t) header->entry_count * sizeof(struct archive_entry);
+	uint64_t buckets_size = (bucket_count + 1) * sizeof(uint32_t);
+
+	if (header->total_size != size || !range_fits(header->entries_offset, entries_size, size)
+			|| !range_fits(header->buckets_offset, buckets_size, size) || !range_fits(header->names_offset, header->names_size, size)
+			|| header->entries_offset % 8 != 0 || header->buckets_offset % 4 != 0) {
+		fprintf(stderr, "Archive %s has an invalid table of contents\n", filename);
+		archive_close(archive);
+		return false;
+	}
+
+	archive->header = header;
+	archive->entries = (const struct archive_entry *) (base + header->entries_offset);
+	archive->buckets = (const uint32_t *) (base + header->buckets_offset);
+	archive->names = base + header->names_offset;
+
+	// Lookups walk buckets[b] to buckets[b + 1], every bucket has to be a range of the entries
+	bool buckets_valid = archive->buckets[0] == 0 && archive->buckets[bucket_count] == header->entry_count;
+	for (uint64_t i = 0; i < bucket_count && buckets_valid; i++) {
+		buckets_valid = archive->buckets[i] <= archive->buckets[i + 1];
+	}
+
+	if (!buckets_valid) {
+		fprintf(stderr, "Archive %s has an invalid bucket table\n", filename);
+		archive_close(archive);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header->entry_count; i++) {
+		const struct archive_entry *entry = &archive->entries[i];
+		if (!range_fits(entry->offset, entry->size, size) || !range_fits(entry->name_offset, entry->name_length, header->names_size)) {
+			fprintf(stderr, "Archive %s has an entry out of bounds\n", filename);
+			archive_close(archive);
+			return false;
+		}
+	}
+
+	printf(" Opened archive %s (%u entries)\n", filename, header->entry_count);
+	return true;
+}
+
+void archive_close(struct archive *archive) {
+	release_file_view(&archive->view);
+	memset(archive, 0, sizeof(*archive));
+}
+
+static const struct archive_entry *archive_lookup(const struct archive *archive, uint64_t hash, const char *name) {
+	if (archive->header == NULL) {
+		return NULL;
+	}
+
+	uint32_t bucket = bucket_of(hash, archive->header->bucket_bits);
+	size_t name_length = name ? strlen(name) : 0;
+
+	for (uint32_t i = archive->buckets[bucket]; i < archive->buckets[bucket + 1]; i++) {
+		const struct archive_entry *entry = &archive->entries[i];
+
+		if (entry->hash != hash) {
+			continue;
+		}
+
+		// Guard against hash collisions when the name is known
+		if (name != NULL && (entry->name_length != name_length
+				|| memcmp(archive->names + entry->name_offset, name, name_length) != 0)) {
+			continue;
+		}
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+static bool archive_entry_blob(const struct archive *archive, const struct archive_entry *entry, struct archive_blob *blob) {
+	if (entry == NULL) {
+		blob->data = NULL;
+		blob->size = 0;
+		return false;
+	}
+
+	blob->data = (const char *) archive->view.data + entry->offset;
+	blob->size = (size_t) entry->size;
+	return true;
+}
+
+bool archive_find(const struct archive *archive, const char *name, struct archive_blob *blob) {
+	return archive_entry_blob(archive, archive_lookup(archive, archive_hash_name(name), name), blob);
+}
+
+bool archive_find_hash(const struct archive *archive, uint64_t hash, struct archive_blob *blob) {
+	return archive_entry_blob(archive, archive_lookup(archive, hash, NULL), blob);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////  Writer  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+struct archive_builder_entry {
+	char *name;
+	uint64_t hash;
+	const void *data;
+	size_t size;
+	void *owned_data;
+	struct file_view view;
+};
+
+struct archive_builder {
+	struct archive_builder_entry *entries;
+	uint32_t entry_count;
+	uint32_t entry_capacity;
+};
+
+struct archive_builder *archive_builder_create(void) {
+	return calloc(1, sizeof(struct archive_builder));
+}
+
+void archive_builder_destroy(struct archive_builder *builder) {
+	if (builder == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < builder->entry_count; i++) {
+		free(builder->entries[i].name);
+		free(builder->entries[i].owned_data);
+		release_file_view(&builder->entries[i].view);
+	}
+
+	free(builder->entries);
+	free(builder);
+}
+
+static struct archive_builder_entry *archive_builder_push(struct archive_builder *builder, const char *name) {
+	uint64_t hash = archive_hash_name(name);
+
+	for (uint32_t i = 0; i < builder->entry_count; i++) {
+		if (strcmp(builder->entries[i].name, name) == 0) {
+			fprintf(stderr, "Duplicate archive entry %s\n", name);
+			return NULL;
+		}
+		if (builder->entries[i].hash == hash) {
+			fprintf(stderr, "Warning: %s and %s share a name hash, lookups by hash will be ambiguous\n", name, builder->entries[i].name);
+		}
+	}
+
+	if (builder->entry_count == builder->entry_capacity) {
+		uint32_t capacity = builder->entry_capacity ? builder->entry_capacity * 2 : 64;
+		struct archive_builder_entry *entries = realloc(builder->entries, capacity * sizeof(*entries));
+
+		if (entries == NULL) {
+			fprintf(stderr, "Failed to allocate memory for archive entries\n");
+			return NULL;
+		}
+
+		builder->entries = entries;
+		builder->entry_capacity = capacity;
+	}
+
+	struct archive_builder_entry *entry = &builder->entries[builder->entry_count++];
+	memset(entry, 0, sizeof(*entry));
+	entry->name = strdup(name);
+	entry->hash = hash;
+	return entry;
+}
+
+bool archive_builder_add_memory(struct archive_builder *builder, const char *name, const void *data, size_t size) {
+	struct archive_builder_entry *entry = archive_builder_push(builder, name);
+	if (entry == NULL) {
+		return false;
+	}
+
+	if (size > 0) {
+		entry->owned_data = malloc(size);
+		if (entry->owned_data == NULL) {
+			fprintf(stderr, "Failed to allocate memory for archive entry %s\n", name);
+			builder->entry_count--;
+			free(entry->name);
+			return false;
+		}
+		memcpy(entry->owned_data, data, size);
+	}
+
+	entry->data = entry->owned_data;
+	entry->size = size;
+	return true;
+}
+
+bool archive_builder_add_file(struct archive_builder *builder, const char *name, const char *filename) {
+	struct file_view view;
+	if (!map_file_view(filename, FILE_VIEW_HINT_SEQUENTIAL, &view)) {
+		return false;
+	}
+
+	struct archive_builder_entry *entry = archive_builder_push(builder, name);
+	if (entry == NULL) {
+		release_file_view(&view);
+		return false;
+	}
+
+	// Keep the file mapped until the archive is written
+	entry->view = view;
+	entry->data = view.data;
+	entry->size = view.size;
+	return true;
+}
+
+static int compare_entries(const void *a, const void *b) {
+	uint64_t hash_a = ((const struct archive_builder_entry *) a)->hash;
+	uint64_t hash_b = ((const struct archive_builder_entry *) b)->hash;
+	return hash_a < hash_b ? -1 : (hash_a > hash_b ? 1 : 0);
+}
+
+static bool write_padding(FILE *file, uint64_t *position, uint64_t alignment) {
+	static const char zeros[ARCHIVE_BLOB_ALIGNMENT] = {0};
+	uint64_t padding = align_up(*position, alignment) - *position;
+
+	if (padding > 0 && fwrite(zeros, 1, (size_t) padding, file) != padding) {
+		return false;
+	}
+
+	*position += padding;
+	return true;
+}
+
+bool archive_builder_write(struct archive_builder *builder, const char *filename) {
+	uint32_t count = builder->entry_count;
+	qsort(builder->entries, count, sizeof(struct archive_builder_entry), compare_entries);
+
+	// Roughly one entry per bucket
+	uint32_t bucket_bits = 0;
+	while ((1u << bucket_bits) < count) {
+		bucket_bits++;
+	}
+	uint32_t bucket_count = 1u << bucket_bits;
+
+	struct archive_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.entry_count = count;
+	header.bucket_bits = bucket_bits;
+	header.entries_offset = sizeof(struct archive_header);
+	header.buckets_offset = header.entries_offset + (uint64_t) count * sizeof(struct archive_entry);
+	header.names_offset = header.buckets_offset + (uint64_t) (bucket_count + 1) * sizeof(uint32_t);
+
+	struct archive_entry *entries = calloc(count ? count : 1, sizeof(struct archive_entry));
+	uint32_t *buckets = calloc(bucket_count + 1, sizeof(uint32_t));
+
+	if (entries == NULL || buckets == NULL) {
+		fprintf(stderr, "Failed to allocate memory for the archive table of contents\n");
+		free(entries);
+		free(buckets);
+		return false;
+	}
+
+	uint64_t names_size = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		entries[i].hash = builder->entries[i].hash;
+		entries[i].size = builder->entries[i].size;
+		entries[i].name_offset = (uint32_t) names_size;
+		entries[i].name_length = (uint32_t) strlen(builder->entries[i].name);
+		names_size += entries[i].name_length;
+	}
+	header.names_size = names_size;
+	header.data_offset = align_up(header.names_offset + names_size, ARCHIVE_BLOB_ALIGNMENT);
+
+	uint64_t offset = header.data_offset;
+	for (uint32_t i = 0; i < count; i++) {
+		entries[i].offset = offset;
+		offset = align_up(offset + entries[i].size, ARCHIVE_BLOB_ALIGNMENT);
+	}
+	header.total_size = count ? entries[count - 1].offset + entries[count - 1].size : header.names_offset + names_size;
+
+	// Entries are sorted, so every bucket is a contiguous range
+	uint32_t entry = 0;
+	for (uint32_t bucket = 0; bucket < bucket_count; bucket++) {
+		buckets[bucket] = entry;
+		while (entry < count && bucket_of(entries[entry].hash, bucket_bits) == bucket) {
+			entry++;
+		}
+	}
+	buckets[bucket_count] = count;
+
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open file %s\n", filename);
+		free(entries);
+		free(buckets);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(entries, sizeof(struct archive_entry), count, file) == count
+		&& fwrite(buckets, sizeof(uint32_t), bucket_count + 1, file) == bucket_count + 1;
+
+	for (uint32_t i = 0; ok && i < count; i++) {
+		ok = fwrite(builder->entries[i].name, 1, entries[i].name_length, file) == entries[i].name_length;
+	}
+
+	uint64_t position = header.names_offset + names_size;
+	for (uint32_t i = 0; ok && i < count; i++) {
+		ok = write_padding(file, &position, ARCHIVE_BLOB_ALIGNMENT)
+			&& fwrite(builder->entries[i].data, 1, builder->entries[i].size, file) == builder->entries[i].size;
+		position += builder->entries[i].size;
+	}
+
+	if (fclose(file) != 0) {
+		ok = false;
+	}
+
+	if (!ok) {
+		fprintf(stderr, "Failed to write archive %s\n", filename);
+	} else {
+		printf("Wrote archive %s (%u entries, %llu bytes)\n", filename, count, (unsigned long long) header.total_size);
+	}
+
+	free(entries);
+	free(buckets);
+	return ok;
+}
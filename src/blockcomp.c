@@ -0,0 +1,321 @@
+#include "blockcomp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5      // the format requires the block to end with literals
+#define LZ_MFLIMIT 12           // no match may start closer than this to the end
+
+// Overflow safe, offset and length come from the file
+static bool range_fits(uint64_t offset, uint64_t length, uint64_t size) {
+	return offset <= size && length <= size - offset;
+}
+
+static uint32_t read32(const uint8_t *p) {
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t lz_hash(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t *lz_write_length(uint8_t *op, size_t length) {
+	while (length >= 255) {
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (uint8_t) length;
+	return op;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////  Codec  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+size_t lz_compress_bound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+size_t lz_compress_block(const void *src, size_t src_size, void *dst, size_t dst_capacity) {
+	if (dst_capacity < lz_compress_bound(src_size)) {
+		return 0;
+	}
+
+	const uint8_t *in = (const uint8_t *) src;
+	uint8_t *op = (uint8_t *) dst;
+
+	size_t anchor = 0;
+	size_t ip = 0;
+
+	if (src_size > LZ_MFLIMIT) {
+		// Greedy matcher, the table holds the last position of every hashed 4 byte sequence
+		int32_t *table = malloc(sizeof(int32_t) << LZ_HASH_BITS);
+		if (table == NULL) {
+			return 0;
+		}
+		memset(table, 0xff, sizeof(int32_t) << LZ_HASH_BITS);
+
+		size_t match_limit = src_size - LZ_MFLIMIT;
+		size_t extend_limit = src_size - LZ_LAST_LITERALS;
+
+		while (ip < match_limit) {
+			uint32_t sequence = read32(in + ip);
+			uint32_t h = lz_hash(sequence);
+			int32_t ref = table[h];
+			table[h] = (int32_t) ip;
+
+			if (ref < 0 || ip - (size_t) ref > LZ_MAX_OFFSET || read32(in + ref) != sequence) {
+				ip++;
+				continue;
+			}
+
+			size_t match_length = LZ_MIN_MATCH;
+			while (ip + match_length < extend_limit && in[ref + match_length] == in[ip + match_length]) {
+				match_length++;
+			}
+
+			size_t literal_length = ip - anchor;
+			uint8_t *token = op++;
+			*token = (uint8_t) ((literal_length >= 15 ? 15 : literal_length) << 4);
+			if (literal_length >= 15) {
+				op = lz_write_length(op, literal_length - 15);
+			}
+			memcpy(op, in + anchor, literal_length);
+			op += literal_length;
+
+			uint16_t offset = (uint16_t) (ip - (size_t) ref);
+			*op++ = (uint8_t) (offset & 0xff);
+			*op++ = (uint8_t) (offset >> 8);
+
+			size_t extra = match_length - LZ_MIN_MATCH;
+			*token |= (uint8_t) (extra >= 15 ? 15 : extra);
+			if (extra >= 15) {
+				op = lz_write_length(op, extra - 15);
+			}
+
+			ip += match_length;
+			anchor = ip;
+		}
+
+		free(table);
+	}
+
+	// Last literals
+	size_t literal_length = src_size - anchor;
+	*op++ = (uint8_t) ((literal_length >= 15 ? 15 : literal_length) << 4);
+	if (literal_length >= 15) {
+		op = lz_write_length(op, literal_length - 15);
+	}
+	memcpy(op, in + anchor, literal_length);
+	op += literal_length;
+
+	return (size_t) (op - (uint8_t *) dst);
+}
+
+bool lz_decompress_block(const void *src, size_t src_size, void *dst, size_t dst_size) {
+	const uint8_t *ip = (const uint8_t *) src;
+	const uint8_t *iend = ip + src_size;
+	uint8_t *op = (uint8_t *) dst;
+	uint8_t *oend = op + dst_size;
+
+	while (ip < iend) {
+		uint8_t token = *ip++;
+
+		size_t literal_length = token >> 4;
+		if (literal_length == 15) {
+			uint8_t byte;
+			do {
+				if (ip >= iend) {
+					return false;
+				}
+				byte = *ip++;
+				literal_length += byte;
+			} while (byte == 255);
+		}
+
+		if (literal_length > (size_t) (iend - ip) || literal_length > (size_t) (oend - op)) {
+			return false;
+		}
+		memcpy(op, ip, literal_length);
+		ip += literal_length;
+		op += literal_length;
+
+		// The last sequence has no match
+		if (ip >= iend) {
+			break;
+		}
+
+		if (iend - ip < 2) {
+			return false;
+		}
+		size_t offset = (size_t) ip[0] | ((size_t) ip[1] << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > (size_t) (op - (uint8_t *) dst)) {
+			return false;
+		}
+
+		size_t match_length = token & 15;
+		if (match_length == 15) {
+			uint8_t byte;
+			do {
+				if (ip >= iend) {
+					return false;
+				}
+				byte = *ip++;
+				match_length += byte;
+			} while (byte == 255);
+		}
+		match_length += LZ_MIN_MATCH;
+
+		if (match_length > (size_t) (oend - op)) {
+			return false;
+		}
+
+		const uint8_t *match = op - offset;
+		if (offset >= match_length) {
+			memcpy(op, match, match_length);
+			op += match_length;
+		} else {
+			// Overlapping copy repeats the pattern
+			for (size_t i = 0; i < match_length; i++) {
+				*op++ = match[i];
+			}
+		}
+	}
+
+	return op == oend;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////  Container  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool compressed_asset_is(const void *data, size_t size) {
+	return size >= sizeof(struct compressed_header)
+		&& ((const struct compressed_header *) data)->magic == COMPRESSED_MAGIC;
+}
+
+bool compressed_asset_parse(const void *data, size_t size, struct compressed_asset *asset) {
+	memset(asset, 0, sizeof(*asset));
+
+	if (!compressed_asset_is(data, size)) {
+		fprintf(stderr, "Not a compressed asset\n");
+		return false;
+	}
+
+	const struct compressed_header *header = (const struct compressed_header *) data;
+	uint64_t table_end = sizeof(struct compressed_header) + (uint64_t) header->block_count * sizeof(struct compressed_block);
+
+	// Rounded up without adding to raw_size, which could wrap
+	uint64_t block_count = header->block_size == 0 ? 0
+		: header->raw_size / header->block_size + (header->raw_size % header->block_size != 0);
+
+	if (header->version != COMPRESSED_VERSION || header->block_size == 0 || table_end > size
+			|| block_count != header->block_count) {
+		fprintf(stderr, "Compressed asset has an invalid header\n");
+		return false;
+	}
+
+	const struct compressed_block *blocks = (const struct compressed_block *) ((const uint8_t *) data + sizeof(struct compressed_header));
+
+	for (uint32_t i = 0; i < header->block_count; i++) {
+		uint64_t expected_raw = header->raw_size - (uint64_t) i * header->block_size;
+		if (expected_raw > header->block_size) {
+			expected_raw = header->block_size;
+		}
+
+		if (!range_fits(blocks[i].offset, blocks[i].compressed_size, size) || blocks[i].raw_size != expected_raw
+				|| blocks[i].compressed_size > blocks[i].raw_size) {
+			fprintf(stderr, "Compressed asset block %u is invalid\n", i);
+			return false;
+		}
+	}
+
+	asset->header = header;
+	asset->blocks = blocks;
+	asset->base = (const uint8_t *) data;
+	asset->size = size;
+	return true;
+}
+
+bool compressed_asset_decompress_block(const struct compressed_asset *asset, uint32_t block, void *dst) {
+	const struct compressed_block *info = &asset->blocks[block];
+	uint8_t *out = (uint8_t *) dst + (size_t) block * asset->header->block_size;
+
+	if (info->compressed_size == info->raw_size) {
+		memcpy(out, asset->base + info->offset, info->raw_size);
+		return true;
+	}
+
+	return lz_decompress_block(asset->base + info->offset, info->compressed_size, out, info->raw_size);
+}
+
+void *compressed_asset_create(const void *data, size_t size, uint32_t block_size, size_t *out_size) {
+	if (block_size == 0) {
+		block_size = COMPRESSED_DEFAULT_BLOCK_SIZE;
+	}
+
+	uint32_t block_count = (uint32_t) ((size + block_size - 1) / block_size);
+	size_t table_size = sizeof(struct compressed_header) + block_count * sizeof(struct compressed_block);
+
+	// Worst case every block is stored raw
+	size_t capacity = table_size + size;
+	uint8_t *out = malloc(capacity);
+	uint8_t *scratch = malloc(lz_compress_bound(block_size));
+
+	if (out == NULL || scratch == NULL) {
+		fprintf(stderr, "Failed to allocate memory for compression\n");
+		free(out);
+		free(scratch);
+		return NULL;
+	}
+
+	struct compressed_header *header = (struct compressed_header *) out;
+	header->magic = COMPRESSED_MAGIC;
+	header->version = COMPRESSED_VERSION;
+	header->block_size = block_size;
+	header->block_count = block_count;
+	header->raw_size = size;
+
+	struct compressed_block *blocks = (struct compressed_block *) (out + sizeof(struct compressed_header));
+	size_t offset = table_size;
+
+	for (uint32_t i = 0; i < block_count; i++) {
+		const uint8_t *raw = (const uint8_t *) data + (size_t) i * block_size;
+		size_t raw_size = size - (size_t) i * block_size;
+		if (raw_size > block_size) {
+			raw_size = block_size;
+		}
+
+		size_t compressed_size = lz_compress_block(raw, raw_size, scratch, lz_compress_bound(block_size));
+
+		blocks[i].offset = offset;
+		blocks[i].raw_size = (uint32_t) raw_size;
+
+		if (compressed_size == 0 || compressed_size >= raw_size) {
+			memcpy(out + offset, raw, raw_size);
+			blocks[i].compressed_size = (uint32_t) raw_size;
+		} else {
+			memcpy(out + offset, scratch, compressed_size);
+			blocks[i].compressed_size = (uint32_t) compressed_size;
+		}
+
+		offset += blocks[i].compressed_size;
+	}
+
+	free(scratch);
+
+	*out_size = offset;
+	return out;
+}
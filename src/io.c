@@ -3,6 +3,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
 
 char *read_entire_binary_file(const char *filename, size_t *size) {
 	printf(" Reading file %s\n", filename);
@@ -46,4 +57,122 @@ char *read_entire_binary_file(const char *filename, size_t *size) {
 
 	*size = bytes_read;
 	return buffer;
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+
+bool map_file_view(const char *filename, int hints, struct file_view *view) {
+	memset(view, 0, sizeof(*view));
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		(hints & FILE_VIEW_HINT_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Failed to open file %s\n", filename);
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		fprintf(stderr, "Failed to get size of file %s\n", filename);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Nothing to map, an empty view is still a valid view
+	if (file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+
+	if (mapping == NULL) {
+		fprintf(stderr, "Failed to create file mapping for %s\n", filename);
+		return false;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (data == NULL) {
+		fprintf(stderr, "Failed to map file %s\n", filename);
+		return false;
+	}
+
+	view->data = data;
+	view->size = (size_t) file_size.QuadPart;
+	view->mapping = data;
+	view->mapping_size = view->size;
+	return true;
+}
+
+void release_file_view(struct file_view *view) {
+	if (view->mapping != NULL) {
+		UnmapViewOfFile(view->mapping);
+	}
+
+	memset(view, 0, sizeof(*view));
+}
+
+#else
+
+bool map_file_view(const char *filename, int hints, struct file_view *view) {
+	memset(view, 0, sizeof(*view));
+
+	int fd = open(filename, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open file %s\n", filename);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "Failed to stat file %s\n", filename);
+		close(fd);
+		return false;
+	}
+
+	// Nothing to map, an empty view is still a valid view
+	if (st.st_size == 0) {
+		close(fd);
+		return true;
+	}
+
+	size_t size = (size_t) st.st_size;
+	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping keeps its own reference to the file
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Failed to map file %s\n", filename);
+		return false;
+	}
+
+	if (hints & FILE_VIEW_HINT_SEQUENTIAL) {
+		madvise(data, size, MADV_SEQUENTIAL);
+	}
+
+	if (hints & FILE_VIEW_HINT_WILLNEED) {
+		madvise(data, size, MADV_WILLNEED);
+	}
+
+	view->data = data;
+	view->size = size;
+	view->mapping = data;
+	view->mapping_size = size;
+	return true;
+}
+
+void release_file_view(struct file_view *view) {
+	if (view->mapping != NULL) {
+		munmap(view->mapping, view->mapping_size);
+	}
+
+	memset(view, 0, sizeof(*view));
+}
+
+#endif
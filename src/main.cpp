@@ -1,7 +1,8 @@
 #include "engine/graphics/VkManager.hpp"
+#include "engine/io/AsyncLoader.hpp"
 
 
-int main(void) {
+int main(int argc, char** argv) {
 	printf("Hello, Vulkan!\n");
 
 	// Initialise SDL
@@ -10,9 +11,17 @@ int main(void) {
         return 1;
     }
 
+	// Start the I/O workers first, shader overrides are read while the device is created
+	IO::Init();
+
 	VK::Init();
 	printf("Vulkan initialized\n");
 
+	// Optional model to show instead of the default quad, swapped in once read
+	if (argc > 1 && !VK::VkManager::instance().loadMesh(argv[1])) {
+		fprintf(stderr, "Could not load %s, keeping the default mesh\n", argv[1]);
+	}
+
 	VK::VkManager::instance().showWindow();
 	
 	// ----- Main loop -----
@@ -30,8 +39,17 @@ int main(void) {
 					running = false;
 				}
 			}
+			else if (event.type == SDL_EVENT_DROP_FILE) {
+				// Dropped models replace the current one, the previous ones stay cached while memory allows
+				if (!VK::VkManager::instance().loadMesh(event.drop.data)) {
+					fprintf(stderr, "Could not load %s\n", event.drop.data);
+				}
+			}
         }
 
+		// Hand finished file reads to their owners
+		IO::AsyncLoader::instance().drainCompletions();
+
 		VK::VkManager::instance().drawFrame();
     }
 
@@ -40,6 +58,8 @@ int main(void) {
 	VK::Quit();
 	printf("Vulkan cleaned up\n");
 
+	IO::Quit();
+
 	// Cleanup SDL
 	printf("Cleaning up SDL\n");
     SDL_Quit();
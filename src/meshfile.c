@@ -0,0 +1,238 @@
+#include "meshfile.h"
+#include "blockcomp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// offset + length <= size, without the sum overflowing
+static bool range_fits(uint64_t offset, uint64_t length, uint64_t size) {
+	return offset <= size && length <= size - offset;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////  Reader  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool mesh_file_parse(const void *data, size_t size, struct mesh_file *mesh) {
+	memset(mesh, 0, sizeof(*mesh));
+
+	if (size < sizeof(struct mesh_file_header)) {
+		fprintf(stderr, "Mesh file is truncated\n");
+		return false;
+	}
+
+	const struct mesh_file_header *header = (const struct mesh_file_header *) data;
+
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION) {
+		fprintf(stderr, "Mesh file has a bad magic or an unsupported version\n");
+		return false;
+	}
+
+	uint64_t vertices_size = (uint64_t) header->vertex_count * header->vertex_stride;
+	uint64_t indices_size = (uint64_t) header->index_count * sizeof(uint32_t);
+	bool compressed = (header->flags & MESH_FILE_FLAG_COMPRESSED) != 0;
+
+	// Compressed sections run up to the next one
+	if (compressed) {
+		if (header->indices_offset < header->vertices_offset || header->indices_offset > size) {
+			fprintf(stderr, "Mesh file has invalid sections\n");
+			return false;
+		}
+		vertices_size = header->indices_offset - header->vertices_offset;
+		indices_size = size - header->indices_offset;
+	}
+
+	uint64_t submeshes_size = (uint64_t) header->submesh_count * sizeof(struct mesh_file_submesh);
+
+	if (header->total_size != size || !range_fits(header->submeshes_offset, submeshes_size, size)
+			|| !range_fits(header->vertices_offset, vertices_size, size) || !range_fits(header->indices_offset, indices_size, size)
+			|| header->submeshes_offset % MESH_FILE_ALIGNMENT != 0 || header->vertices_offset % MESH_FILE_ALIGNMENT != 0
+			|| header->indices_offset % MESH_FILE_ALIGNMENT != 0) {
+		fprintf(stderr, "Mesh file has invalid sections\n");
+		return false;
+	}
+
+	const uint8_t *base = (const uint8_t *) data;
+
+	mesh->header = header;
+	mesh->submeshes = (const struct mesh_file_submesh *) (base + header->submeshes_offset);
+	mesh->vertices = base + header->vertices_offset;
+	mesh->indices = (const uint32_t *) (base + header->indices_offset);
+	mesh->vertices_size = (size_t) vertices_size;
+	mesh->indices_size = (size_t) indices_size;
+
+	// The containers have to decompress to exactly the sections the header describes
+	if (compressed) {
+		struct compressed_asset vertices, indices;
+		if (!compressed_asset_parse(mesh->vertices, mesh->vertices_size, &vertices)
+				|| vertices.header->raw_size != (uint64_t) header->vertex_count * header->vertex_stride
+				|| !compressed_asset_parse(mesh->indices, mesh->indices_size, &indices)
+				|| indices.header->raw_size != (uint64_t) header->index_count * sizeof(uint32_t)) {
+			fprintf(stderr, "Mesh file has invalid compressed sections\n");
+			memset(mesh, 0, sizeof(*mesh));
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->submesh_count; i++) {
+		if ((uint64_t) mesh->submeshes[i].first_index + mesh->submeshes[i].index_count > header->index_count) {
+			fprintf(stderr, "Mesh file submesh %u is out of bounds\n", i);
+			memset(mesh, 0, sizeof(*mesh));
+			return false;
+		}
+	}
+
+	// Compressed indices are only readable once decompressed, the loader checks them then
+	if (!compressed && !mesh_file_check_indices(mesh->indices, header->index_count, header->vertex_count)) {
+		memset(mesh, 0, sizeof(*mesh));
+		return false;
+	}
+
+	return true;
+}
+
+bool mesh_file_check_indices(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count) {
+	for (uint32_t i = 0; i < index_count; i++) {
+		if (indices[i] >= vertex_count) {
+			fprintf(stderr, "Mesh file index %u references vertex %u of %u\n", i, indices[i], vertex_count);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool mesh_file_open(const char *filename, struct mesh_file *mesh) {
+	struct file_view view;
+	if (!map_file_view(filename, FILE_VIEW_HINT_SEQUENTIAL | FILE_VIEW_HINT_WILLNEED, &view)) {
+		memset(mesh, 0, sizeof(*mesh));
+		return false;
+	}
+
+	if (!mesh_file_parse(view.data, view.size, mesh)) {
+		fprintf(stderr, "Failed to load mesh %s\n", filename);
+		release_file_view(&view);
+		return false;
+	}
+
+	mesh->view = view;
+	return true;
+}
+
+void mesh_file_close(struct mesh_file *mesh) {
+	release_file_view(&mesh->view);
+	memset(mesh, 0, sizeof(*mesh));
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////  Writer  ///////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+void *mesh_file_serialize(const struct mesh_file_data *data, size_t *out_size) {
+	struct mesh_file_header header;
+	memset(&header, 0, sizeof(header));
+
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.flags = data->flags;
+	header.vertex_layout = data->vertex_layout;
+	header.vertex_stride = data->vertex_stride;
+	header.vertex_count = data->vertex_count;
+	header.index_count = data->index_count;
+	header.submesh_count = data->submesh_count;
+	memcpy(header.bounds_min, data->bounds_min, sizeof(header.bounds_min));
+	memcpy(header.bounds_max, data->bounds_max, sizeof(header.bounds_max));
+
+	const void *vertices = data->vertices;
+	const void *indices = data->indices;
+	uint64_t vertices_size = (uint64_t) data->vertex_count * data->vertex_stride;
+	uint64_t indices_size = (uint64_t) data->index_count * sizeof(uint32_t);
+
+	// Each section becomes a container of its own, the reader decompresses them into separate buffers
+	void *compressed_vertices = NULL;
+	void *compressed_indices = NULL;
+	if (data->flags & MESH_FILE_FLAG_COMPRESSED) {
+		size_t compressed_vertices_size, compressed_indices_size;
+		compressed_vertices = compressed_asset_create(data->vertices, (size_t) vertices_size, COMPRESSED_DEFAULT_BLOCK_SIZE, &compressed_vertices_size);
+		compressed_indices = compressed_asset_create(data->indices, (size_t) indices_size, COMPRESSED_DEFAULT_BLOCK_SIZE, &compressed_indices_size);
+
+		if (compressed_vertices == NULL || compressed_indices == NULL) {
+			fprintf(stderr, "Failed to compress the mesh file\n");
+			free(compressed_vertices);
+			free(compressed_indices);
+			return NULL;
+		}
+
+		vertices = compressed_vertices;
+		indices = compressed_indices;
+		vertices_size = compressed_vertices_size;
+		indices_size = compressed_indices_size;
+	}
+
+	header.submeshes_offset = align_up(sizeof(header), MESH_FILE_ALIGNMENT);
+	header.vertices_offset = align_up(header.submeshes_offset + (uint64_t) data->submesh_count * sizeof(struct mesh_file_submesh), MESH_FILE_ALIGNMENT);
+	header.indices_offset = align_up(header.vertices_offset + vertices_size, MESH_FILE_ALIGNMENT);
+	header.total_size = header.indices_offset + indices_size;
+
+	// Padding stays zeroed so identical meshes give identical files
+	uint8_t *out = calloc(1, (size_t) header.total_size);
+	if (out == NULL) {
+		fprintf(stderr, "Failed to allocate memory for the mesh file\n");
+		free(compressed_vertices);
+		free(compressed_indices);
+		return NULL;
+	}
+
+	memcpy(out, &header, sizeof(header));
+	if (data->submesh_count > 0) {
+		memcpy(out + header.submeshes_offset, data->submeshes, data->submesh_count * sizeof(struct mesh_file_submesh));
+	}
+	if (vertices_size > 0) {
+		memcpy(out + header.vertices_offset, vertices, (size_t) vertices_size);
+	}
+	if (indices_size > 0) {
+		memcpy(out + header.indices_offset, indices, (size_t) indices_size);
+	}
+
+	free(compressed_vertices);
+	free(compressed_indices);
+
+	*out_size = (size_t) header.total_size;
+	return out;
+}
+
+bool mesh_file_write(const char *filename, const struct mesh_file_data *data) {
+	size_t size;
+	void *serialized = mesh_file_serialize(data, &size);
+	if (serialized == NULL) {
+		return false;
+	}
+
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open file %s\n", filename);
+		free(serialized);
+		return false;
+	}
+
+	bool ok = fwrite(serialized, 1, size, file) == size;
+	if (fclose(file) != 0) {
+		ok = false;
+	}
+
+	if (!ok) {
+		fprintf(stderr, "Failed to write mesh %s\n", filename);
+	}
+
+	free(serialized);
+	return ok;
+}
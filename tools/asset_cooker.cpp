@@ -0,0 +1,419 @@
+#include "engine/core/ThreadPool.hpp"
+#include "engine/io/MeshImporter.hpp"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+	#include <SDL3/SDL.h>
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+
+	#include "io.h"
+	#include "archive.h"
+	#include "blockcomp.h"
+}
+
+/*
+ * Offline asset cooker
+ *
+ * usage: asset_cooker -i <source dir> -o <output dir> [-p <archive.pak>] [-j <jobs>] [--glslc <path>] [--force]
+ *
+ * Walks the source directory and turns every asset it knows into its engine-ready form:
+ *   .vert .frag .comp   SPIR-V (through glslc)
+ *   .obj .gltf .glb     runtime mesh files (meshfile.h), vertices already in the engine layout and
+ *                       block compressed
+ *   .bmp                RGBA8 texels, block compressed
+ *
+ * Jobs run in parallel. An input is skipped when its content hash and the version of the cooker
+ * for its kind match what the cache recorded last time and the output still exists.
+ */
+
+namespace fs = std::filesystem;
+
+#define COOK_CACHE_FILE ".cook_cache"
+
+// Bump when the output of a kind of asset changes, everything of that kind gets re-cooked
+#define SHADER_COOKER_VERSION 1
+#define MESH_COOKER_VERSION 4
+#define IMAGE_COOKER_VERSION 1
+
+#define COOKED_TEXTURE_MAGIC 0x58455456u  // "VTEX"
+
+enum class AssetKind {
+	Shader,
+	Mesh,
+	Image,
+};
+
+struct CookJob {
+	AssetKind kind;
+	fs::path source;
+	std::string name;       // relative to the source dir, forward slashes
+	std::string output;     // relative to the output dir
+	uint64_t hash = 0;
+	uint32_t version = 0;
+	bool skipped = false;
+	bool ok = false;
+};
+
+struct CacheEntry {
+	uint64_t hash;
+	uint32_t version;
+};
+
+struct CookerOptions {
+	fs::path source_dir;
+	fs::path output_dir;
+	const char* archive_path = nullptr;
+	const char* glslc = "glslc";
+	uint32_t jobs = 0;
+	bool force = false;
+};
+
+struct CookedTextureHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;    // VkFormat
+	uint32_t reserved;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////  Helpers  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static uint64_t hash_bytes(const void* data, size_t size) {
+	// FNV-1a, 64 bit, 8 bytes at a time
+	const uint8_t* bytes = (const uint8_t*) data;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash ^= word;
+		hash *= 0x100000001b3ull;
+	}
+	for (; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static bool write_file(const fs::path& path, const void* data, size_t size) {
+	std::error_code error;
+	fs::create_directories(path.parent_path(), error);
+
+	FILE* file = fopen(path.string().c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open file %s\n", path.string().c_str());
+		return false;
+	}
+
+	bool ok = size == 0 || fwrite(data, 1, size, file) == size;
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok) {
+		fprintf(stderr, "Failed to write file %s\n", path.string().c_str());
+	}
+	return ok;
+}
+
+static bool write_compressed(const fs::path& path, const void* data, size_t size) {
+	size_t compressed_size;
+	void* compressed = compressed_asset_create(data, size, COMPRESSED_DEFAULT_BLOCK_SIZE, &compressed_size);
+	if (compressed == NULL) {
+		return false;
+	}
+
+	bool ok = write_file(path, compressed, compressed_size);
+	free(compressed);
+	return ok;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////  Cookers  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static bool cook_shader(const CookerOptions& options, const CookJob& job) {
+	fs::path output = options.output_dir / job.output;
+
+	std::error_code error;
+	fs::create_directories(output.parent_path(), error);
+
+	std::string command = std::string("\"") + options.glslc + "\" \"" + job.source.string() + "\" -o \"" + output.string() + "\"";
+	if (system(command.c_str()) != 0) {
+		fprintf(stderr, "Failed to compile shader %s\n", job.name.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+static bool cook_mesh(const CookerOptions& options, const CookJob& job) {
+	/*
+	 * Vertex and index streams are block compressed, the engine decompresses them across its
+	 * workers straight into staging memory. Jobs already run in parallel, so each import stays on
+	 * its own thread.
+	 */
+	Core::ThreadPool serial(1);
+	VK::MeshData mesh;
+
+	if (!IO::import_mesh(job.source.string().c_str(), mesh, serial)) {
+		fprintf(stderr, "Failed to import mesh %s\n", job.name.c_str());
+		return false;
+	}
+
+	fs::path output = options.output_dir / job.output;
+	std::error_code error;
+	fs::create_directories(output.parent_path(), error);
+
+	return IO::write_mesh_file(output.string().c_str(), mesh, MESH_FILE_FLAG_COMPRESSED);
+}
+
+static bool cook_image(const CookerOptions& options, const CookJob& job) {
+	SDL_Surface* surface = SDL_LoadBMP(job.source.string().c_str());
+	if (surface == NULL) {
+		fprintf(stderr, "Failed to load image %s: %s\n", job.name.c_str(), SDL_GetError());
+		return false;
+	}
+
+	// Byte order R, G, B, A which is VK_FORMAT_R8G8B8A8_SRGB
+	SDL_Surface* converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_ABGR8888);
+	SDL_DestroySurface(surface);
+
+	if (converted == NULL) {
+		fprintf(stderr, "Failed to convert image %s: %s\n", job.name.c_str(), SDL_GetError());
+		return false;
+	}
+
+	uint32_t width = (uint32_t) converted->w;
+	uint32_t height = (uint32_t) converted->h;
+	CookedTextureHeader header = {COOKED_TEXTURE_MAGIC, IMAGE_COOKER_VERSION, width, height, 43 /* VK_FORMAT_R8G8B8A8_SRGB */, 0};
+
+	std::vector<uint8_t> payload(sizeof(header) + (size_t) width * height * 4);
+	memcpy(payload.data(), &header, sizeof(header));
+
+	// Tightly pack the rows, the surface pitch may be padded
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(payload.data() + sizeof(header) + (size_t) y * width * 4,
+			(const uint8_t*) converted->pixels + (size_t) y * converted->pitch, (size_t) width * 4);
+	}
+
+	SDL_DestroySurface(converted);
+
+	return write_compressed(options.output_dir / job.output, payload.data(), payload.size());
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////  Cache  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static std::unordered_map<std::string, CacheEntry> load_cache(const fs::path& path) {
+	std::unordered_map<std::string, CacheEntry> cache;
+
+	FILE* file = fopen(path.string().c_str(), "r");
+	if (!file) {
+		return cache;
+	}
+
+	char name[4096];
+	unsigned long long hash;
+	unsigned int version;
+
+	while (fscanf(file, "%llx %u %4095[^\n]\n", &hash, &version, name) == 3) {
+		cache[name] = CacheEntry{(uint64_t) hash, version};
+	}
+
+	fclose(file);
+	return cache;
+}
+
+static void save_cache(const fs::path& path, const std::unordered_map<std::string, CacheEntry>& cache) {
+	FILE* file = fopen(path.string().c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "Failed to write cook cache %s\n", path.string().c_str());
+		return;
+	}
+
+	for (const auto& [name, entry] : cache) {
+		fprintf(file, "%016llx %u %s\n", (unsigned long long) entry.hash, entry.version, name.c_str());
+	}
+
+	fclose(file);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////  Main  /////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////
+
+
+static bool make_job(const fs::path& source, const fs::path& source_dir, CookJob& job) {
+	std::string extension = source.extension().string();
+
+	job.source = source;
+	job.name = fs::relative(source, source_dir).generic_string();
+
+	if (extension == ".vert" || extension == ".frag" || extension == ".comp") {
+		job.kind = AssetKind::Shader;
+		job.version = SHADER_COOKER_VERSION;
+		job.output = job.name + ".spv";
+	} else if (extension == ".obj" || extension == ".gltf" || extension == ".glb") {
+		job.kind = AssetKind::Mesh;
+		job.version = MESH_COOKER_VERSION;
+		job.output = job.name + ".mesh";
+	} else if (extension == ".bmp") {
+		job.kind = AssetKind::Image;
+		job.version = IMAGE_COOKER_VERSION;
+		job.output = job.name + ".tex";
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static void print_usage() {
+	fprintf(stderr, "usage: asset_cooker -i <source dir> -o <output dir> [-p <archive.pak>] [-j <jobs>] [--glslc <path>] [--force]\n");
+}
+
+int main(int argc, char** argv) {
+	CookerOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			options.source_dir = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			options.output_dir = argv[++i];
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			options.archive_path = argv[++i];
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			options.jobs = (uint32_t) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--glslc") == 0 && i + 1 < argc) {
+			options.glslc = argv[++i];
+		} else if (strcmp(argv[i], "--force") == 0) {
+			options.force = true;
+		} else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (options.source_dir.empty() || options.output_dir.empty() || !fs::is_directory(options.source_dir)) {
+		print_usage();
+		return 1;
+	}
+
+	std::error_code error;
+	fs::create_directories(options.output_dir, error);
+
+	// ----- Collect the jobs -----
+	std::vector<CookJob> jobs;
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(options.source_dir)) {
+		CookJob job;
+		if (entry.is_regular_file() && make_job(entry.path(), options.source_dir, job)) {
+			jobs.push_back(job);
+		}
+	}
+
+	fs::path cache_path = options.output_dir / COOK_CACHE_FILE;
+	std::unordered_map<std::string, CacheEntry> cache = load_cache(cache_path);
+
+	// ----- Cook -----
+	Core::ThreadPool pool(options.jobs);
+	printf("Cooking %zu assets on %u threads\n", jobs.size(), pool.threadCount());
+
+	uint64_t start = SDL_GetTicksNS();
+
+	pool.parallelFor((uint32_t) jobs.size(), [&](uint32_t index, uint32_t worker) {
+		CookJob& job = jobs[index];
+
+		file_view view;
+		if (!map_file_view(job.source.string().c_str(), FILE_VIEW_HINT_SEQUENTIAL, &view)) {
+			return;
+		}
+
+		job.hash = hash_bytes(view.data, view.size);
+
+		// The cache map is only read while cooking, updates happen afterwards
+		auto cached = cache.find(job.name);
+		if (!options.force && cached != cache.end() && cached->second.hash == job.hash
+				&& cached->second.version == job.version && fs::exists(options.output_dir / job.output)) {
+			job.skipped = true;
+			job.ok = true;
+			release_file_view(&view);
+			return;
+		}
+
+		switch (job.kind) {
+		case AssetKind::Shader:
+			job.ok = cook_shader(options, job);
+			break;
+		case AssetKind::Mesh:
+			job.ok = cook_mesh(options, job);
+			break;
+		case AssetKind::Image:
+			job.ok = cook_image(options, job);
+			break;
+		}
+
+		release_file_view(&view);
+
+		if (job.ok) {
+			printf(" Cooked %s -> %s\n", job.name.c_str(), job.output.c_str());
+		}
+	});
+
+	uint32_t cooked = 0, skipped = 0, failed = 0;
+	for (const CookJob& job : jobs) {
+		if (!job.ok) {
+			failed++;
+			cache.erase(job.name);
+		} else {
+			job.skipped ? skipped++ : cooked++;
+			cache[job.name] = CacheEntry{job.hash, job.version};
+		}
+	}
+
+	save_cache(cache_path, cache);
+
+	printf("Cooked %u, up to date %u, failed %u in %.2f s\n", cooked, skipped, failed,
+		SDL_NS_TO_SECONDS((double) (SDL_GetTicksNS() - start)));
+
+	if (failed > 0) {
+		return 1;
+	}
+
+	// ----- Pack -----
+	if (options.archive_path != nullptr) {
+		archive_builder* builder = archive_builder_create();
+		bool ok = true;
+
+		for (const CookJob& job : jobs) {
+			ok = ok && archive_builder_add_file(builder, job.output.c_str(), (options.output_dir / job.output).string().c_str());
+		}
+
+		ok = ok && archive_builder_write(builder, options.archive_path);
+		archive_builder_destroy(builder);
+
+		if (!ok) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
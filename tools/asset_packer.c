@@ -0,0 +1,83 @@
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Packs loose files into a single archive
+ *
+ * usage: asset_packer -o <output.pak> [-r <root>] <files...>
+ *
+ * Entries are named after their path, relative to <root> when it is a prefix of it.
+ */
+
+static void print_usage(void) {
+	fprintf(stderr, "usage: asset_packer -o <output.pak> [-r <root>] <files...>\n");
+}
+
+static const char *entry_name(const char *path, const char *root) {
+	size_t root_length = root ? strlen(root) : 0;
+
+	if (root_length > 0 && strncmp(path, root, root_length) == 0) {
+		path += root_length;
+		while (*path == '/' || *path == '\\') {
+			path++;
+		}
+	}
+
+	return path;
+}
+
+int main(int argc, char **argv) {
+	const char *output = NULL;
+	const char *root = NULL;
+
+	struct archive_builder *builder = archive_builder_create();
+	int file_count = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		} else if (argv[i][0] == '-') {
+			print_usage();
+			archive_builder_destroy(builder);
+			return 1;
+		} else {
+			const char *name = entry_name(argv[i], root);
+
+			// Archive names always use forward slashes
+			char *normalized = strdup(name);
+			for (char *c = normalized; *c; c++) {
+				if (*c == '\\') {
+					*c = '/';
+				}
+			}
+
+			bool added = archive_builder_add_file(builder, normalized, argv[i]);
+			if (added) {
+				printf(" Packing %s\n", normalized);
+			}
+			free(normalized);
+
+			if (!added) {
+				archive_builder_destroy(builder);
+				return 1;
+			}
+			file_count++;
+		}
+	}
+
+	if (output == NULL || file_count == 0) {
+		print_usage();
+		archive_builder_destroy(builder);
+		return 1;
+	}
+
+	bool ok = archive_builder_write(builder, output);
+	archive_builder_destroy(builder);
+
+	return ok ? 0 : 1;
+}